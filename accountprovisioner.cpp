@@ -0,0 +1,379 @@
+#include "accountprovisioner.h"
+#include <QDebug>
+#include <QFile>
+#include <QProcess>
+#include <QRegularExpression>
+#include <QTimer>
+#include <QUuid>
+
+#ifdef Q_OS_UNIX
+#include <unistd.h>
+#endif
+
+namespace {
+
+// sudo с неверным паролем сразу отвечает «Sorry, try again»
+const int AuthTimeoutMs = 30 * 1000;
+// sysadminctl создаёт домашнюю папку и связку ключей, на старых дисках
+// это заметно дольше секунды
+const int DefaultAccountTimeoutMs = 2 * 60 * 1000;
+
+void setError(QString *error, const QString &message)
+{
+    if (error) {
+        *error = message;
+    }
+}
+
+// Команды уходят в оболочку текстом: каждое значение в одинарных кавычках
+QByteArray shellQuote(const QString &value)
+{
+    QString quoted = value;
+    quoted.replace("'", "'\\''");
+    return "'" + quoted.toUtf8() + "'";
+}
+
+} // namespace
+
+QString AccountResult::statusText() const
+{
+    switch (status) {
+        case Created:
+            return "создан";
+        case Exists:
+            return "уже существует";
+        case Failed:
+            return "ошибка";
+        case NotRun:
+            break;
+    }
+    return "не выполнено";
+}
+
+AccountProvisioner::AccountProvisioner(QObject *parent)
+    : QObject(parent), process(nullptr), timer(new QTimer(this)),
+      accountTimeoutMs(DefaultAccountTimeoutMs), useSudo(true), ready(false)
+{
+#ifdef Q_OS_UNIX
+    useSudo = geteuid() != 0;
+#endif
+    timer->setSingleShot(true);
+    connect(timer, &QTimer::timeout, this, [this]() {
+        finishSession(ready ? "Превышено время ожидания" : "Нет ответа sudo");
+    });
+}
+
+AccountProvisioner::~AccountProvisioner()
+{
+    if (process) {
+        process->disconnect(this);
+        process->kill();
+        process->waitForFinished(1000);
+    }
+}
+
+void AccountProvisioner::provision(const QList<AccountSpec> &newAccounts, const QString &sudoPassword)
+{
+    cancel();
+    accounts = newAccounts;
+    accountResults.clear();
+    for (const AccountSpec &account : accounts) {
+        AccountResult result;
+        result.name = account.name;
+        accountResults << result;
+    }
+    if (accounts.isEmpty()) {
+        emit finished(true);
+        return;
+    }
+
+    marker = QUuid::createUuid().toByteArray(QUuid::Id128);
+    pending.clear();
+    currentOutput.clear();
+    ready = false;
+
+    // Сообщения sudo и sysadminctl идут вперемешку с маркерами, поэтому
+    // каналы объединены
+    process = new QProcess(this);
+    process->setProcessChannelMode(QProcess::MergedChannels);
+
+    if (useSudo) {
+        connect(process, &QProcess::started, this, [this, sudoPassword]() {
+            process->write(sudoPassword.toUtf8() + "\n");
+        });
+    }
+    connect(process, &QProcess::readyReadStandardOutput, this, &AccountProvisioner::handleOutput);
+    connect(process, &QProcess::finished, this, [this]() {
+        handleOutput();
+        finishSession(ready ? "Сессия завершилась раньше времени"
+                            : "Не удалось получить права администратора");
+    });
+    connect(process, &QProcess::errorOccurred, this, [this](QProcess::ProcessError error) {
+        if (error == QProcess::FailedToStart) {
+            finishSession("Не удалось запустить sudo: " + process->errorString());
+        }
+    });
+
+    // -k: пароль спрашивается всегда, даже если права ещё не истекли, иначе
+    // строка пароля попала бы в оболочку. Оболочка сообщает о готовности и
+    // пропускает всё до строки начала сценария — на случай, если sudo
+    // настроен без пароля и строку пароля не прочитал
+    const QByteArray bootstrap = "echo " + marker + " ready; "
+                                 "while IFS= read -r line; do [ \"$line\" = \"" + marker + " begin\" ] && break; done; "
+                                 "exec /bin/sh -s";
+    timer->start(AuthTimeoutMs);
+    const QStringList sudo = QStringList() << "-S" << "-k" << "-p" << "" << "/bin/sh" << "-c"
+                                           << QString::fromUtf8(bootstrap);
+    if (useSudo && !authenticateAs.isEmpty()) {
+        // Внешний sudo от root пароля не спрашивает, внутренний выполняется
+        // от имени пользователя и требует его пароль
+        process->start("sudo", QStringList() << "-u" << authenticateAs << "--" << "sudo" << sudo);
+    } else if (useSudo) {
+        process->start("sudo", sudo);
+    } else {
+        process->start("/bin/sh", QStringList() << "-c" << QString::fromUtf8(bootstrap));
+    }
+}
+
+void AccountProvisioner::cancel()
+{
+    finishSession("Отменено");
+}
+
+void AccountProvisioner::handleOutput()
+{
+    if (!process) {
+        return;
+    }
+
+    pending.append(process->readAllStandardOutput());
+    qsizetype start = 0;
+    qsizetype end = 0;
+    while (process && (end = pending.indexOf('\n', start)) >= 0) {
+        handleLine(pending.mid(start, end - start));
+        start = end + 1;
+    }
+    pending.remove(0, start);
+}
+
+void AccountProvisioner::handleLine(const QByteArray &line)
+{
+    if (!ready) {
+        if (line == marker + " ready") {
+            ready = true;
+            emit authenticated();
+            writeScript();
+            timer->start(accountTimeoutMs);
+        } else if (line.contains("Sorry, try again") || line.contains("incorrect password")) {
+            finishSession("Неверный пароль администратора");
+        }
+        return;
+    }
+
+    if (!line.startsWith(marker + " ")) {
+        currentOutput += QString::fromUtf8(line) + "\n";
+        return;
+    }
+
+    // <маркер> <номер записи> <exists | код выхода>
+    const QList<QByteArray> parts = line.split(' ');
+    bool ok = false;
+    const int index = parts.value(1).toInt(&ok);
+    if (!ok || index < 0 || index >= accountResults.size()) {
+        qWarning() << "Unexpected provisioning marker:" << line;
+        return;
+    }
+
+    AccountResult &result = accountResults[index];
+    const QByteArray status = parts.value(2);
+    const QString output = currentOutput.trimmed();
+    currentOutput.clear();
+    if (status == "exists" || output.contains("already exists")) {
+        result.status = AccountResult::Exists;
+        result.message = "Пользователь уже существует";
+    } else if (status == "0") {
+        result.status = AccountResult::Created;
+        result.message = output;
+    } else {
+        result.status = AccountResult::Failed;
+        result.message = output.isEmpty() ? QString("Код выхода %1").arg(QString::fromUtf8(status)) : output;
+    }
+
+    timer->start(accountTimeoutMs);
+    emit accountFinished(result);
+}
+
+QByteArray AccountProvisioner::script() const
+{
+    QByteArray text = marker + " begin\n";
+    // Ошибки sysadminctl и dscl относятся к записи до её маркера
+    text += "exec 2>&1\n";
+    for (int i = 0; i < accounts.size(); ++i) {
+        const AccountSpec &account = accounts.at(i);
+        const QByteArray name = shellQuote(account.name);
+        const QByteArray done = "echo " + marker + " " + QByteArray::number(i);
+
+        text += "if /usr/bin/id -u " + name + " >/dev/null 2>&1; then " + done + " exists; else\n";
+        text += "/usr/sbin/sysadminctl -addUser " + name + " -password " + shellQuote(account.password);
+        if (account.role == AccountSpec::Admin) {
+            text += " -admin";
+        }
+        text += "\ncode=$?\n";
+        if (account.role == AccountSpec::Service) {
+            text += "[ $code -eq 0 ] && { /usr/bin/dscl . -create /Users/" + name + " IsHidden 1 || code=$?; }\n";
+        }
+        text += done + " $code\nfi\n";
+    }
+    text += "exit 0\n";
+    return text;
+}
+
+void AccountProvisioner::writeScript()
+{
+    process->write(script());
+    process->closeWriteChannel();
+}
+
+void AccountProvisioner::finishSession(const QString &reason)
+{
+    if (!process) {
+        return;
+    }
+
+    timer->stop();
+    process->disconnect(this);
+    if (process->state() != QProcess::NotRunning) {
+        process->kill();
+    }
+    process->deleteLater();
+    process = nullptr;
+
+    bool success = true;
+    for (AccountResult &result : accountResults) {
+        if (result.status == AccountResult::NotRun) {
+            result.message = reason;
+        }
+        if (result.status != AccountResult::Created && result.status != AccountResult::Exists) {
+            success = false;
+        }
+    }
+    emit finished(success);
+}
+
+bool AccountProvisioner::resolvePassword(AccountSpec *account, QString *error)
+{
+    const QString &source = account->passwordSource;
+    if (source == "ask") {
+        return true;
+    }
+
+    if (source.startsWith("env:")) {
+        account->password = qEnvironmentVariable(source.mid(4).toUtf8().constData());
+    } else if (source.startsWith("file:")) {
+        QFile file(source.mid(5));
+        if (!file.open(QIODevice::ReadOnly)) {
+            setError(error, QString("%1: %2").arg(account->name, file.errorString()));
+            return false;
+        }
+        account->password = QString::fromUtf8(file.readLine()).remove('\n').remove('\r');
+    } else if (source.startsWith("pass:")) {
+        account->password = source.mid(5);
+    } else {
+        setError(error, QString("%1: неизвестный источник пароля \"%2\"").arg(account->name, source));
+        return false;
+    }
+
+    if (account->password.isEmpty()) {
+        setError(error, QString("%1: пустой пароль из %2").arg(account->name, source));
+        return false;
+    }
+    if (account->password.contains('\n')) {
+        setError(error, QString("%1: пароль содержит перевод строки").arg(account->name));
+        return false;
+    }
+    return true;
+}
+
+bool AccountProvisioner::readAccountList(const QString &path, QList<AccountSpec> *accounts, QString *error)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        setError(error, file.errorString());
+        return false;
+    }
+
+    // Короткое имя macOS: латиница в нижнем регистре, цифры, _ . -
+    static const QRegularExpression validName("^[a-z_][a-z0-9_.-]{0,31}$");
+    static const QRegularExpression separator("\\s+");
+
+    accounts->clear();
+    int lineNumber = 0;
+    while (!file.atEnd()) {
+        ++lineNumber;
+        QString line = QString::fromUtf8(file.readLine());
+        if (line.trimmed().startsWith('#')) {
+            continue;
+        }
+        line = line.trimmed();
+        if (line.isEmpty()) {
+            continue;
+        }
+
+        // Пароль после pass: может содержать пробелы
+        const QStringList fields = line.split(separator);
+        if (fields.size() < 3) {
+            setError(error, QString("Строка %1: нужны имя, роль и источник пароля").arg(lineNumber));
+            return false;
+        }
+
+        AccountSpec account;
+        account.name = fields.at(0);
+        if (!validName.match(account.name).hasMatch()) {
+            setError(error, QString("Строка %1: недопустимое имя \"%2\"").arg(lineNumber).arg(account.name));
+            return false;
+        }
+        for (const AccountSpec &existing : *accounts) {
+            if (existing.name == account.name) {
+                setError(error, QString("Строка %1: %2 указан дважды").arg(lineNumber).arg(account.name));
+                return false;
+            }
+        }
+
+        const QString role = fields.at(1);
+        if (role == "admin") {
+            account.role = AccountSpec::Admin;
+        } else if (role == "standard") {
+            account.role = AccountSpec::Standard;
+        } else if (role == "service") {
+            account.role = AccountSpec::Service;
+        } else {
+            setError(error, QString("Строка %1: неизвестная роль \"%2\"").arg(lineNumber).arg(role));
+            return false;
+        }
+
+        account.passwordSource = line.section(separator, 2);
+        if (!resolvePassword(&account, error)) {
+            return false;
+        }
+        *accounts << account;
+    }
+
+    if (accounts->isEmpty()) {
+        setError(error, "Список учётных записей пуст");
+        return false;
+    }
+    return true;
+}
+
+QString AccountProvisioner::reportText(const QList<AccountResult> &results)
+{
+    QString report = QString("=== Учётные записи: %1 ===\n").arg(results.size());
+    for (const AccountResult &result : results) {
+        report += QString("%1\t%2").arg(result.name, result.statusText());
+        if (!result.message.isEmpty() && result.status != AccountResult::Created) {
+            report += " (" + result.message + ")";
+        }
+        report += "\n";
+    }
+    return report;
+}
@@ -0,0 +1,112 @@
+#ifndef ACCOUNTPROVISIONER_H
+#define ACCOUNTPROVISIONER_H
+
+#include <QByteArray>
+#include <QList>
+#include <QObject>
+#include <QString>
+
+class QProcess;
+class QTimer;
+
+// Учётная запись для создания на машине
+struct AccountSpec {
+    enum Role {
+        Standard,
+        Admin,
+        // Обычная учётная запись, скрытая из окна входа
+        Service
+    };
+
+    QString name;
+    Role role = Standard;
+    // Откуда взять пароль: env:<переменная>, file:<путь>, pass:<пароль> или ask
+    QString passwordSource;
+    QString password;
+
+    bool needsPrompt() const { return passwordSource == "ask"; }
+};
+
+struct AccountResult {
+    enum Status {
+        Created,
+        Exists,
+        Failed,
+        // Сессия прервана до этой записи
+        NotRun
+    };
+
+    QString name;
+    Status status = NotRun;
+    // Вывод sysadminctl или причина ошибки
+    QString message;
+
+    QString statusText() const;
+};
+
+// Создаёт несколько учётных записей через одну привилегированную сессию:
+// sudo спрашивает пароль один раз и запускает оболочку, в которую подряд
+// пишутся команды для всех записей. После каждой записи оболочка печатает
+// маркер с её номером и кодом выхода, по нему вывод делится между записями.
+class AccountProvisioner : public QObject
+{
+    Q_OBJECT
+public:
+    explicit AccountProvisioner(QObject *parent = nullptr);
+    ~AccountProvisioner() override;
+
+    // Без sudo, если процесс уже работает от root (резидентный агент).
+    // По умолчанию определяется по эффективному uid
+    void setUseSudo(bool use) { useSudo = use; }
+    bool usesSudo() const { return useSudo; }
+
+    // Процесс от root, запрос от другого пользователя: sudo запускается от
+    // его имени и проверяет его пароль и права так же, как при обычном
+    // запуске. Пустое имя — без подмены пользователя
+    void setAuthenticateAs(const QString &userName) { authenticateAs = userName; }
+
+    // Сколько ждать очередную запись, мс
+    void setAccountTimeout(int milliseconds) { accountTimeoutMs = qMax(1, milliseconds); }
+
+    void provision(const QList<AccountSpec> &accounts, const QString &sudoPassword);
+    void cancel();
+    bool isRunning() const { return process != nullptr; }
+
+    QList<AccountResult> results() const { return accountResults; }
+
+    // Список из файла: «имя роль источник-пароля» на строку, # — комментарий.
+    // Роли: admin, standard, service. Пароли из env: и file: читаются сразу,
+    // ask остаётся незаполненным для запроса у оператора
+    static bool readAccountList(const QString &path, QList<AccountSpec> *accounts, QString *error = nullptr);
+    static bool resolvePassword(AccountSpec *account, QString *error = nullptr);
+
+    static QString reportText(const QList<AccountResult> &results);
+
+signals:
+    void authenticated();
+    void accountFinished(const AccountResult &result);
+    void finished(bool success);
+
+private:
+    void handleOutput();
+    void handleLine(const QByteArray &line);
+    void writeScript();
+    void finishSession(const QString &reason);
+
+    QByteArray script() const;
+
+    QList<AccountSpec> accounts;
+    QList<AccountResult> accountResults;
+    QProcess *process;
+    QTimer *timer;
+    int accountTimeoutMs;
+    bool useSudo;
+    QString authenticateAs;
+    // Случайная строка в маркерах: вывод sysadminctl не может её подделать
+    QByteArray marker;
+    QByteArray pending;
+    QString currentOutput;
+    bool ready;
+};
+
+#endif // ACCOUNTPROVISIONER_H
@@ -0,0 +1,223 @@
+#include "agentclient.h"
+#include <QCoreApplication>
+#include <QDebug>
+#include <QDeadlineTimer>
+#include <QLocalSocket>
+
+#ifdef Q_OS_UNIX
+#include <unistd.h>
+#endif
+
+namespace {
+
+// Агент — root или тот же пользователь. Сокет по пути может создать любой
+// процесс, а клиент отдаёт агенту пароль sudo
+bool trustedPeer(QLocalSocket *socket)
+{
+#ifdef Q_OS_UNIX
+    uint uid = 0;
+    if (!AgentProtocol::peerUid(socket->socketDescriptor(), &uid)) {
+        return false;
+    }
+    return uid == 0 || uid == uint(geteuid());
+#else
+    Q_UNUSED(socket);
+    return true;
+#endif
+}
+
+} // namespace
+
+AgentClient::AgentClient(QObject *parent)
+    : QObject(parent), socket(new QLocalSocket(this)), peerTrusted(false), nextRequestId(1),
+      diagnosticsRequest(0), provisionRequest(0), lastProgress(0)
+{
+    hello.version = 0;
+    connect(socket, &QLocalSocket::readyRead, this, &AgentClient::readFrames);
+    connect(socket, &QLocalSocket::disconnected, this, [this]() {
+        hello.version = 0;
+        peerTrusted = false;
+        buffer.clear();
+        failPending("Агент отключился");
+    });
+}
+
+bool AgentClient::connectToAgent(const QString &socketName, int timeoutMs)
+{
+    const QDeadlineTimer deadline(timeoutMs);
+    socket->connectToServer(socketName);
+    if (!socket->waitForConnected(timeoutMs)) {
+        return false;
+    }
+    // До приветствия: ничего не отправляем чужому процессу
+    peerTrusted = trustedPeer(socket);
+    if (!peerTrusted) {
+        qWarning() << "Agent socket is served by another user:" << socketName;
+        socket->abort();
+        return false;
+    }
+
+    // Агент отвечает сразу: ждём приветствие синхронно, чтобы вызывающий
+    // знал, кому отдавать работу
+    hello.version = 0;
+    AgentProtocol::HelloInfo request;
+    request.pid = QCoreApplication::applicationPid();
+    send(AgentProtocol::Hello, AgentProtocol::encodeHello(request));
+    while (hello.version == 0 && socket->state() == QLocalSocket::ConnectedState) {
+        if (!socket->waitForReadyRead(int(deadline.remainingTime()))) {
+            break;
+        }
+    }
+
+    if (hello.version != AgentProtocol::Version) {
+        qDebug() << "Agent handshake failed:" << socketName;
+        socket->abort();
+        hello.version = 0;
+        return false;
+    }
+    return true;
+}
+
+bool AgentClient::isConnected() const
+{
+    return peerTrusted && hello.version != 0 && socket->state() == QLocalSocket::ConnectedState;
+}
+
+void AgentClient::runDiagnostics(const AgentProtocol::DiagnosticRequest &request)
+{
+    lastProgress = 0;
+    diagnosticsRequest = send(AgentProtocol::RunDiagnostics, AgentProtocol::encodeDiagnosticRequest(request));
+}
+
+void AgentClient::provisionAccounts(const QList<AccountSpec> &accounts, const QString &sudoPassword)
+{
+    if (!isConnected()) {
+        // Пароль уходит только проверенному агенту
+        emit failed("Агент не подключён");
+        return;
+    }
+    AgentProtocol::ProvisionRequest request;
+    request.accounts = accounts;
+    request.sudoPassword = sudoPassword;
+    provisionRequest = send(AgentProtocol::ProvisionAccounts, AgentProtocol::encodeProvisionRequest(request));
+}
+
+void AgentClient::cancelDiagnostics()
+{
+    if (diagnosticsRequest == 0) {
+        return;
+    }
+    AgentProtocol::Frame frame;
+    frame.opcode = AgentProtocol::Cancel;
+    frame.requestId = diagnosticsRequest;
+    socket->write(AgentProtocol::encode(frame));
+}
+
+quint32 AgentClient::send(quint8 opcode, const QByteArray &payload)
+{
+    AgentProtocol::Frame frame;
+    frame.opcode = opcode;
+    frame.requestId = nextRequestId++;
+    frame.payload = payload;
+    socket->write(AgentProtocol::encode(frame));
+    return frame.requestId;
+}
+
+void AgentClient::readFrames()
+{
+    buffer.append(socket->readAll());
+
+    AgentProtocol::Frame frame;
+    QString error;
+    while (AgentProtocol::decode(&buffer, &frame, &error)) {
+        handleFrame(frame);
+    }
+    if (!error.isEmpty()) {
+        socket->abort();
+        failPending(error);
+    }
+}
+
+void AgentClient::handleFrame(const AgentProtocol::Frame &frame)
+{
+    switch (frame.opcode) {
+        case AgentProtocol::Welcome:
+            if (!AgentProtocol::decodeHello(frame.payload, &hello)) {
+                hello.version = 0;
+            }
+            return;
+        case AgentProtocol::Progress: {
+            QString message;
+            AgentProtocol::decodeString(frame.payload, &message);
+            emit progressUpdated(lastProgress, message);
+            return;
+        }
+        case AgentProtocol::ProbeFinished: {
+            QString description;
+            bool success = false;
+            if (AgentProtocol::decodeProbeFinished(frame.payload, &description, &success, &lastProgress)) {
+                emit probeFinished(description, success, lastProgress);
+            }
+            return;
+        }
+        case AgentProtocol::DiagnosticsFinished: {
+            if (frame.requestId != diagnosticsRequest) {
+                return;
+            }
+            diagnosticsRequest = 0;
+            bool success = false;
+            DiagnosticResults results;
+            if (!AgentProtocol::decodeDiagnosticsFinished(frame.payload, &success, &results)) {
+                emit failed("Повреждённый отчёт агента");
+                return;
+            }
+            emit diagnosticsFinished(success, results);
+            return;
+        }
+        case AgentProtocol::AccountFinished: {
+            AccountResult result;
+            if (AgentProtocol::decodeAccountResult(frame.payload, &result)) {
+                emit accountFinished(result);
+            }
+            return;
+        }
+        case AgentProtocol::ProvisionFinished: {
+            if (frame.requestId != provisionRequest) {
+                return;
+            }
+            provisionRequest = 0;
+            bool success = false;
+            QList<AccountResult> results;
+            if (!AgentProtocol::decodeProvisionFinished(frame.payload, &success, &results)) {
+                emit failed("Повреждённый ответ агента");
+                return;
+            }
+            emit provisioningFinished(success, results);
+            return;
+        }
+        case AgentProtocol::Error: {
+            QString message;
+            AgentProtocol::decodeString(frame.payload, &message);
+            if (frame.requestId == diagnosticsRequest) {
+                diagnosticsRequest = 0;
+            } else if (frame.requestId == provisionRequest) {
+                provisionRequest = 0;
+            }
+            emit failed(message);
+            return;
+        }
+        default:
+            qDebug() << "Unknown agent opcode:" << frame.opcode;
+            return;
+    }
+}
+
+void AgentClient::failPending(const QString &message)
+{
+    if (diagnosticsRequest == 0 && provisionRequest == 0) {
+        return;
+    }
+    diagnosticsRequest = 0;
+    provisionRequest = 0;
+    emit failed(message);
+}
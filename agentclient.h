@@ -0,0 +1,58 @@
+#ifndef AGENTCLIENT_H
+#define AGENTCLIENT_H
+
+#include <QByteArray>
+#include <QObject>
+#include "agentprotocol.h"
+
+class QLocalSocket;
+
+// Клиент резидентного агента. Сигналы повторяют сигналы DiagnosticManager
+// и AccountProvisioner, поэтому окно и консольный режим подключают их так
+// же, как при локальном запуске. Одновременно — один запрос каждого вида.
+class AgentClient : public QObject
+{
+    Q_OBJECT
+public:
+    explicit AgentClient(QObject *parent = nullptr);
+
+    // Подключается и обменивается версиями протокола. false — агент не
+    // запущен, несовместим или сокет обслуживает процесс другого
+    // пользователя: вызывающий выполняет работу сам
+    bool connectToAgent(const QString &socketName = AgentProtocol::defaultSocketName(), int timeoutMs = 1000);
+    bool isConnected() const;
+    // Агент работает от root: пароль sudo для учётных записей не нужен
+    bool agentPrivileged() const { return hello.privileged; }
+
+    void runDiagnostics(const AgentProtocol::DiagnosticRequest &request);
+    void provisionAccounts(const QList<AccountSpec> &accounts, const QString &sudoPassword = QString());
+    void cancelDiagnostics();
+
+signals:
+    void progressUpdated(int progress, const QString &message);
+    void probeFinished(const QString &description, bool success, int progress);
+    void diagnosticsFinished(bool success, const DiagnosticResults &results);
+    void accountFinished(const AccountResult &result);
+    void provisioningFinished(bool success, const QList<AccountResult> &results);
+    // Ошибка агента или связи; незавершённые запросы считаются проваленными
+    void failed(const QString &message);
+
+private:
+    quint32 send(quint8 opcode, const QByteArray &payload);
+    void readFrames();
+    void handleFrame(const AgentProtocol::Frame &frame);
+    void failPending(const QString &message);
+
+    QLocalSocket *socket;
+    // Сервер сокета — root или этот же пользователь (проверено до приветствия)
+    bool peerTrusted;
+    QByteArray buffer;
+    AgentProtocol::HelloInfo hello;
+    quint32 nextRequestId;
+    // 0 — запроса нет
+    quint32 diagnosticsRequest;
+    quint32 provisionRequest;
+    int lastProgress;
+};
+
+#endif // AGENTCLIENT_H
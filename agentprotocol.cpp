@@ -0,0 +1,310 @@
+#include "agentprotocol.h"
+#include "resultserializer.h"
+#include <QDataStream>
+#include <QIODevice>
+#include <QtEndian>
+
+#ifdef Q_OS_UNIX
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+#endif
+
+namespace AgentProtocol {
+
+namespace {
+
+// Код операции и номер запроса
+const int FrameHeaderSize = 1 + 4;
+
+void writeUtf8(QDataStream &out, const QString &text)
+{
+    out << text.toUtf8();
+}
+
+QString readUtf8(QDataStream &in)
+{
+    QByteArray data;
+    in >> data;
+    return QString::fromUtf8(data);
+}
+
+bool readBool(QDataStream &in)
+{
+    quint8 value = 0;
+    in >> value;
+    return value != 0;
+}
+
+// Данные операции разобраны целиком и без лишних байтов
+bool finished(const QDataStream &in)
+{
+    return in.status() == QDataStream::Ok && in.atEnd();
+}
+
+void writeAccountResult(QDataStream &out, const AccountResult &result)
+{
+    writeUtf8(out, result.name);
+    out << quint8(result.status);
+    writeUtf8(out, result.message);
+}
+
+void readAccountResult(QDataStream &in, AccountResult *result)
+{
+    quint8 status = 0;
+    result->name = readUtf8(in);
+    in >> status;
+    result->message = readUtf8(in);
+    result->status = status <= AccountResult::NotRun ? AccountResult::Status(status) : AccountResult::Failed;
+}
+
+} // namespace
+
+QByteArray encode(const Frame &frame)
+{
+    QByteArray data;
+    data.reserve(4 + FrameHeaderSize + frame.payload.size());
+    QDataStream out(&data, QIODevice::WriteOnly);
+    out << quint32(FrameHeaderSize + frame.payload.size()) << frame.opcode << frame.requestId;
+    out.writeRawData(frame.payload.constData(), frame.payload.size());
+    return data;
+}
+
+bool decode(QByteArray *buffer, Frame *frame, QString *error)
+{
+    if (error) {
+        error->clear();
+    }
+    if (buffer->size() < 4) {
+        return false;
+    }
+
+    const quint32 length = qFromBigEndian<quint32>(buffer->constData());
+    if (length < quint32(FrameHeaderSize) || length > MaxFrameSize) {
+        if (error) {
+            *error = QString("Неверная длина кадра: %1").arg(length);
+        }
+        return false;
+    }
+    if (quint32(buffer->size() - 4) < length) {
+        return false;
+    }
+
+    const char *data = buffer->constData() + 4;
+    frame->opcode = quint8(data[0]);
+    frame->requestId = qFromBigEndian<quint32>(data + 1);
+    frame->payload = QByteArray(data + FrameHeaderSize, length - FrameHeaderSize);
+    buffer->remove(0, 4 + length);
+    return true;
+}
+
+QByteArray encodeHello(const HelloInfo &hello)
+{
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_6_0);
+    out << hello.version << hello.pid << quint8(hello.privileged);
+    return payload;
+}
+
+bool decodeHello(const QByteArray &payload, HelloInfo *hello)
+{
+    QDataStream in(payload);
+    in.setVersion(QDataStream::Qt_6_0);
+    in >> hello->version >> hello->pid;
+    hello->privileged = readBool(in);
+    return finished(in);
+}
+
+bool DiagnosticRequest::operator==(const DiagnosticRequest &other) const
+{
+    return profile == other.profile && refresh == other.refresh && deepDisk == other.deepDisk
+           && incremental == other.incremental && forwardOutput == other.forwardOutput;
+}
+
+QByteArray encodeDiagnosticRequest(const DiagnosticRequest &request)
+{
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_6_0);
+    writeUtf8(out, request.profile);
+    out << quint8(request.refresh) << quint8(request.deepDisk) << quint8(request.incremental)
+        << quint8(request.forwardOutput);
+    return payload;
+}
+
+bool decodeDiagnosticRequest(const QByteArray &payload, DiagnosticRequest *request)
+{
+    QDataStream in(payload);
+    in.setVersion(QDataStream::Qt_6_0);
+    request->profile = readUtf8(in);
+    request->refresh = readBool(in);
+    request->deepDisk = readBool(in);
+    request->incremental = readBool(in);
+    request->forwardOutput = readBool(in);
+    return finished(in);
+}
+
+QByteArray encodeProvisionRequest(const ProvisionRequest &request)
+{
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_6_0);
+    writeUtf8(out, request.sudoPassword);
+    out << quint32(request.accounts.size());
+    for (const AccountSpec &account : request.accounts) {
+        writeUtf8(out, account.name);
+        out << quint8(account.role);
+        writeUtf8(out, account.password);
+    }
+    return payload;
+}
+
+bool decodeProvisionRequest(const QByteArray &payload, ProvisionRequest *request)
+{
+    QDataStream in(payload);
+    in.setVersion(QDataStream::Qt_6_0);
+    request->sudoPassword = readUtf8(in);
+
+    quint32 count = 0;
+    in >> count;
+    request->accounts.clear();
+    for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+        AccountSpec account;
+        quint8 role = 0;
+        account.name = readUtf8(in);
+        in >> role;
+        account.password = readUtf8(in);
+        if (role > AccountSpec::Service) {
+            return false;
+        }
+        account.role = AccountSpec::Role(role);
+        request->accounts << account;
+    }
+    return finished(in);
+}
+
+QByteArray encodeString(const QString &text)
+{
+    return text.toUtf8();
+}
+
+bool decodeString(const QByteArray &payload, QString *text)
+{
+    *text = QString::fromUtf8(payload);
+    return true;
+}
+
+QByteArray encodeProbeFinished(const QString &description, bool success, int progress)
+{
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_6_0);
+    writeUtf8(out, description);
+    out << quint8(success) << qint32(progress);
+    return payload;
+}
+
+bool decodeProbeFinished(const QByteArray &payload, QString *description, bool *success, int *progress)
+{
+    QDataStream in(payload);
+    in.setVersion(QDataStream::Qt_6_0);
+    qint32 value = 0;
+    *description = readUtf8(in);
+    *success = readBool(in);
+    in >> value;
+    *progress = value;
+    return finished(in);
+}
+
+QByteArray encodeDiagnosticsFinished(bool success, const DiagnosticResults &results)
+{
+    return QByteArray(1, char(success)) + ResultSerializer::toBinary(results);
+}
+
+bool decodeDiagnosticsFinished(const QByteArray &payload, bool *success, DiagnosticResults *results)
+{
+    if (payload.isEmpty()) {
+        return false;
+    }
+    *success = payload.at(0) != 0;
+    return ResultSerializer::fromBinary(payload.mid(1), results);
+}
+
+QByteArray encodeAccountResult(const AccountResult &result)
+{
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_6_0);
+    writeAccountResult(out, result);
+    return payload;
+}
+
+bool decodeAccountResult(const QByteArray &payload, AccountResult *result)
+{
+    QDataStream in(payload);
+    in.setVersion(QDataStream::Qt_6_0);
+    readAccountResult(in, result);
+    return finished(in);
+}
+
+QByteArray encodeProvisionFinished(bool success, const QList<AccountResult> &results)
+{
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_6_0);
+    out << quint8(success) << quint32(results.size());
+    for (const AccountResult &result : results) {
+        writeAccountResult(out, result);
+    }
+    return payload;
+}
+
+bool decodeProvisionFinished(const QByteArray &payload, bool *success, QList<AccountResult> *results)
+{
+    QDataStream in(payload);
+    in.setVersion(QDataStream::Qt_6_0);
+    *success = readBool(in);
+
+    quint32 count = 0;
+    in >> count;
+    results->clear();
+    for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+        AccountResult result;
+        readAccountResult(in, &result);
+        *results << result;
+    }
+    return finished(in);
+}
+
+QString defaultSocketName()
+{
+    return "/var/run/mac_diagnostic_agent.sock";
+}
+
+bool peerUid(qintptr descriptor, uint *uid)
+{
+#if defined(Q_OS_LINUX)
+    struct ucred credentials = {};
+    socklen_t length = sizeof(credentials);
+    if (getsockopt(int(descriptor), SOL_SOCKET, SO_PEERCRED, &credentials, &length) != 0) {
+        return false;
+    }
+    *uid = credentials.uid;
+    return true;
+#elif defined(Q_OS_UNIX)
+    uid_t peer = 0;
+    gid_t gid = 0;
+    if (getpeereid(int(descriptor), &peer, &gid) != 0) {
+        return false;
+    }
+    *uid = peer;
+    return true;
+#else
+    Q_UNUSED(descriptor);
+    Q_UNUSED(uid);
+    return false;
+#endif
+}
+
+} // namespace AgentProtocol
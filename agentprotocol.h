@@ -0,0 +1,101 @@
+#ifndef AGENTPROTOCOL_H
+#define AGENTPROTOCOL_H
+
+#include <QByteArray>
+#include <QList>
+#include <QString>
+#include "accountprovisioner.h"
+#include "diagnosticresults.h"
+
+// Протокол резидентного агента поверх локального сокета.
+//
+// Кадр: длина (quint32, big-endian, без учёта самого поля), код операции
+// (quint8), номер запроса (quint32), затем данные операции в QDataStream
+// (Qt_6_0). Ответы и события несут номер запроса, к которому относятся.
+// Итоги диагностики передаются двоичной записью ResultSerializer.
+namespace AgentProtocol {
+
+const quint16 Version = 1;
+// Записи с таймингами и журналом укладываются с большим запасом
+const quint32 MaxFrameSize = 16 * 1024 * 1024;
+
+enum Opcode : quint8 {
+    // Клиент → агент
+    Hello = 1,             // версия протокола
+    RunDiagnostics = 2,    // DiagnosticRequest
+    ProvisionAccounts = 3, // ProvisionRequest
+    Cancel = 4,            // номер отменяемого запроса в поле requestId
+
+    // Агент → клиент
+    Welcome = 64,          // версия, pid агента, работает ли от root
+    Progress = 65,         // строка журнала
+    ProbeFinished = 66,    // описание, успех, процент
+    DiagnosticsFinished = 67, // успех, запись ResultSerializer
+    AccountFinished = 68,  // AccountResult
+    ProvisionFinished = 69, // успех, список AccountResult
+    Error = 70             // текст ошибки; запрос завершён
+};
+
+struct Frame {
+    quint8 opcode = 0;
+    quint32 requestId = 0;
+    QByteArray payload;
+};
+
+QByteArray encode(const Frame &frame);
+// Снимает с начала буфера один целый кадр. false — кадр ещё не пришёл
+// целиком или, если error не пуст, поток повреждён
+bool decode(QByteArray *buffer, Frame *frame, QString *error);
+
+struct HelloInfo {
+    quint16 version = Version;
+    qint64 pid = 0;
+    bool privileged = false;
+};
+
+struct DiagnosticRequest {
+    // Пустой — профиль агента по умолчанию
+    QString profile;
+    bool refresh = false;
+    bool deepDisk = false;
+    bool incremental = false;
+    bool forwardOutput = false;
+
+    bool operator==(const DiagnosticRequest &other) const;
+};
+
+struct ProvisionRequest {
+    QList<AccountSpec> accounts;
+    // Не нужен, только если и агент, и клиент работают от root
+    QString sudoPassword;
+};
+
+QByteArray encodeHello(const HelloInfo &hello);
+bool decodeHello(const QByteArray &payload, HelloInfo *hello);
+QByteArray encodeDiagnosticRequest(const DiagnosticRequest &request);
+bool decodeDiagnosticRequest(const QByteArray &payload, DiagnosticRequest *request);
+QByteArray encodeProvisionRequest(const ProvisionRequest &request);
+bool decodeProvisionRequest(const QByteArray &payload, ProvisionRequest *request);
+
+QByteArray encodeString(const QString &text);
+bool decodeString(const QByteArray &payload, QString *text);
+QByteArray encodeProbeFinished(const QString &description, bool success, int progress);
+bool decodeProbeFinished(const QByteArray &payload, QString *description, bool *success, int *progress);
+QByteArray encodeDiagnosticsFinished(bool success, const DiagnosticResults &results);
+bool decodeDiagnosticsFinished(const QByteArray &payload, bool *success, DiagnosticResults *results);
+QByteArray encodeAccountResult(const AccountResult &result);
+bool decodeAccountResult(const QByteArray &payload, AccountResult *result);
+QByteArray encodeProvisionFinished(bool success, const QList<AccountResult> &results);
+bool decodeProvisionFinished(const QByteArray &payload, bool *success, QList<AccountResult> *results);
+
+// Сокет по умолчанию: абсолютный путь в каталоге, куда пишет только root.
+// Агент от root (launchd) и клиенты любых пользователей находят один и тот
+// же сокет, и подменить его обычный пользователь не может. Агенту без root
+// путь задаётся через --agent-socket
+QString defaultSocketName();
+// uid процесса на другом конце локального сокета
+bool peerUid(qintptr descriptor, uint *uid);
+
+} // namespace AgentProtocol
+
+#endif // AGENTPROTOCOL_H
@@ -0,0 +1,229 @@
+// Сводные запросы по отчётам парка: загрузка отчётов в колоночное
+// хранилище и фильтры/агрегаты по нему
+#include "reportquery.h"
+#include "reportstore.h"
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDirIterator>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QTextStream>
+
+namespace {
+
+enum ExitCode {
+    ExitClean = 0,
+    ExitInputError = 2,
+    ExitOutputError = 3,
+    ExitUsage = 64
+};
+
+// В каталогах берутся только отчёты: JSON, двоичные записи (--format binary)
+// и история запусков. Файлы, названные явно, загружаются с любым именем
+const QStringList ReportFilePatterns = QStringList() << "*.json" << "*.bin" << "*.mdr";
+
+QStringList inputFiles(const QStringList &paths)
+{
+    QStringList files;
+    for (const QString &path : paths) {
+        if (!QFileInfo(path).isDir()) {
+            files << path;
+            continue;
+        }
+        QDirIterator it(path, ReportFilePatterns, QDir::Files, QDirIterator::Subdirectories);
+        while (it.hasNext()) {
+            files << it.next();
+        }
+    }
+    files.sort();
+    return files;
+}
+
+int ingest(const QString &storePath, const QStringList &paths, bool verbose)
+{
+    ReportStoreBuilder builder;
+    QString error;
+    if (QFileInfo::exists(storePath)) {
+        ReportStore existing;
+        if (!existing.open(storePath, &error)) {
+            QTextStream(stderr) << "Не удалось открыть хранилище: " << error << Qt::endl;
+            return ExitInputError;
+        }
+        builder.load(existing);
+    }
+
+    const qint64 before = builder.rowCount();
+    int failed = 0;
+    int skipped = 0;
+    for (const QString &file : inputFiles(paths)) {
+        int fileSkipped = 0;
+        const qint64 added = builder.ingestFile(file, &error, &fileSkipped);
+        skipped += fileSkipped;
+        if (added < 0) {
+            QTextStream(stderr) << "Пропущен " << error << Qt::endl;
+            ++failed;
+        } else if (verbose) {
+            QTextStream(stderr) << file << ": " << added;
+            if (fileSkipped > 0) {
+                QTextStream(stderr) << ", пропущено записей: " << fileSkipped;
+            }
+            QTextStream(stderr) << Qt::endl;
+        }
+    }
+
+    if (!builder.write(storePath, &error)) {
+        QTextStream(stderr) << "Не удалось записать хранилище: " << error << Qt::endl;
+        return ExitOutputError;
+    }
+    QTextStream(stdout) << "Добавлено отчётов: " << builder.rowCount() - before
+                        << ", всего: " << builder.rowCount();
+    if (skipped > 0) {
+        QTextStream(stdout) << ", пропущено нечитаемых записей: " << skipped;
+    }
+    QTextStream(stdout) << Qt::endl;
+    return failed ? ExitInputError : ExitClean;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Сводные запросы по отчётам диагностики парка");
+    parser.addHelpOption();
+    parser.addPositionalArgument("files", "Для --ingest: отчёты или каталоги с ними.", "[files...]");
+
+    QCommandLineOption storeOption(QStringList() << "s" << "store", "Файл хранилища.", "file", "fleet.mdcs");
+    QCommandLineOption ingestOption("ingest",
+                                    "Добавить отчёты (--format binary или json, история запусков) в хранилище.");
+    QCommandLineOption whereOption(QStringList() << "w" << "where",
+                                   "Условие, например maxCapacity<80 или findMyMacEnabled; условия объединяются через И.",
+                                   "condition");
+    QCommandLineOption latestOption("latest", "Учитывать только последний отчёт каждой машины.");
+    QCommandLineOption groupByOption("group-by", "Группировать по столбцу, например machineModel.", "column");
+    QCommandLineOption statsOption("stats", "Минимум, медиана, среднее и максимум столбца.", "column");
+    QCommandLineOption columnsOption("columns", "Столбцы списка через запятую.", "list");
+    QCommandLineOption limitOption("limit", "Сколько строк списка выводить.", "count", "100");
+    QCommandLineOption schemaOption("schema", "Показать столбцы хранилища.");
+    QCommandLineOption formatOption(QStringList() << "f" << "format", "Формат вывода: text или json.", "format", "text");
+    QCommandLineOption verboseOption(QStringList() << "v" << "verbose", "Выводить время запроса в stderr.");
+    parser.addOption(storeOption);
+    parser.addOption(ingestOption);
+    parser.addOption(whereOption);
+    parser.addOption(latestOption);
+    parser.addOption(groupByOption);
+    parser.addOption(statsOption);
+    parser.addOption(columnsOption);
+    parser.addOption(limitOption);
+    parser.addOption(schemaOption);
+    parser.addOption(formatOption);
+    parser.addOption(verboseOption);
+
+    if (!parser.parse(app.arguments())) {
+        QTextStream(stderr) << parser.errorText() << Qt::endl;
+        return ExitUsage;
+    }
+    if (parser.isSet("help")) {
+        QTextStream(stdout) << parser.helpText();
+        return ExitClean;
+    }
+
+    const QString storePath = parser.value(storeOption);
+    const bool verbose = parser.isSet(verboseOption);
+    if (parser.isSet(ingestOption)) {
+        if (parser.positionalArguments().isEmpty()) {
+            QTextStream(stderr) << "Для --ingest нужны файлы отчётов" << Qt::endl;
+            return ExitUsage;
+        }
+        return ingest(storePath, parser.positionalArguments(), verbose);
+    }
+
+    const QString format = parser.value(formatOption);
+    if (format != "text" && format != "json") {
+        QTextStream(stderr) << "Неизвестный формат: " << format << Qt::endl;
+        return ExitUsage;
+    }
+    bool limitOk = false;
+    const qint64 limit = parser.value(limitOption).toLongLong(&limitOk);
+    if (!limitOk || limit < 0) {
+        QTextStream(stderr) << "Неверное значение --limit: " << parser.value(limitOption) << Qt::endl;
+        return ExitUsage;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    ReportStore store;
+    QString error;
+    if (!store.open(storePath, &error)) {
+        QTextStream(stderr) << "Не удалось открыть хранилище " << storePath << ": " << error << Qt::endl;
+        return ExitInputError;
+    }
+    const qint64 openUs = timer.nsecsElapsed() / 1000;
+
+    QTextStream out(stdout);
+    if (parser.isSet(schemaOption)) {
+        static const char *typeNames[] = {"", "int32", "int64", "bool", "string"};
+        for (const ReportStore::Column &column : store.columns()) {
+            out << column.name << "\t" << typeNames[column.type];
+            if (column.type == ReportStore::StringColumn) {
+                out << "\t" << column.dictionary.size() << " значений";
+            }
+            out << Qt::endl;
+        }
+        out << "Строк: " << store.rowCount() << Qt::endl;
+        return ExitClean;
+    }
+
+    ReportQuery query(store);
+    query.setLatestOnly(parser.isSet(latestOption));
+    for (const QString &text : parser.values(whereOption)) {
+        ReportFilter filter;
+        if (!ReportFilter::parse(text, &filter, &error) || !query.addFilter(filter, &error)) {
+            QTextStream(stderr) << error << Qt::endl;
+            return ExitUsage;
+        }
+    }
+
+    timer.restart();
+    const QByteArray mask = query.select();
+    const qint64 selectUs = timer.nsecsElapsed() / 1000;
+
+    QByteArray report;
+    if (parser.isSet(groupByOption) || parser.isSet(statsOption)) {
+        QList<ReportGroupStats> stats;
+        const QString groupBy = parser.value(groupByOption);
+        const QString valueColumn = parser.value(statsOption);
+        if (!query.aggregate(mask, groupBy, valueColumn, &stats, &error)) {
+            QTextStream(stderr) << error << Qt::endl;
+            return ExitUsage;
+        }
+        report = format == "json" ? ReportQuery::statsJson(groupBy, valueColumn, stats)
+                                  : ReportQuery::statsText(groupBy, valueColumn, stats).toUtf8();
+    } else {
+        const QStringList columns = parser.isSet(columnsOption)
+                                        ? parser.value(columnsOption).split(',', Qt::SkipEmptyParts)
+                                        : ReportQuery::defaultColumns();
+        for (const QString &name : columns) {
+            if (!store.column(name)) {
+                QTextStream(stderr) << "Нет столбца " << name << Qt::endl;
+                return ExitUsage;
+            }
+        }
+        report = format == "json" ? query.rowsJson(mask, columns, limit)
+                                  : query.rowsText(mask, columns, limit).toUtf8();
+    }
+    const qint64 totalUs = openUs + timer.nsecsElapsed() / 1000;
+
+    QFile output;
+    if (!output.open(stdout, QIODevice::WriteOnly) || output.write(report) != report.size() || !output.flush()) {
+        QTextStream(stderr) << "Не удалось записать результат: " << output.errorString() << Qt::endl;
+        return ExitOutputError;
+    }
+    if (verbose) {
+        QTextStream(stderr) << "Открытие " << openUs << " мкс, отбор " << selectUs << " мкс, всего "
+                            << totalUs << " мкс на " << store.rowCount() << " строк" << Qt::endl;
+    }
+    return ExitClean;
+}
@@ -0,0 +1,68 @@
+#include "batteryregistry.h"
+#include <QDebug>
+#include <QFile>
+
+#ifdef Q_OS_MACOS
+#include <CoreFoundation/CoreFoundation.h>
+#include <IOKit/IOKitLib.h>
+#endif
+
+QSharedPointer<BatteryRegistry> BatteryRegistry::system()
+{
+    const QString fakePath = qEnvironmentVariable("MAC_DIAGNOSTIC_BATTERY_PLIST");
+    if (!fakePath.isEmpty()) {
+        return QSharedPointer<BatteryRegistry>(new FakeBatteryRegistry(fakePath));
+    }
+    return QSharedPointer<BatteryRegistry>(new IOKitBatteryRegistry);
+}
+
+bool IOKitBatteryRegistry::readProperties(QByteArray *plist) const
+{
+#ifdef Q_OS_MACOS
+    plist->clear();
+    io_service_t battery = IOServiceGetMatchingService(MACH_PORT_NULL,
+                                                       IOServiceNameMatching("AppleSmartBattery"));
+    if (!battery) {
+        // Реестр доступен, но батареи нет
+        return true;
+    }
+
+    CFMutableDictionaryRef properties = nullptr;
+    const kern_return_t status = IORegistryEntryCreateCFProperties(battery, &properties,
+                                                                   kCFAllocatorDefault, 0);
+    IOObjectRelease(battery);
+    if (status != KERN_SUCCESS || !properties) {
+        qDebug() << "Cannot read AppleSmartBattery properties:" << status;
+        return false;
+    }
+
+    CFDataRef data = CFPropertyListCreateData(kCFAllocatorDefault, properties,
+                                              kCFPropertyListXMLFormat_v1_0, 0, nullptr);
+    CFRelease(properties);
+    if (!data) {
+        return false;
+    }
+    *plist = QByteArray::fromCFData(data);
+    CFRelease(data);
+    return true;
+#else
+    Q_UNUSED(plist);
+    return false;
+#endif
+}
+
+FakeBatteryRegistry::FakeBatteryRegistry(const QString &plistPath)
+    : path(plistPath)
+{
+}
+
+bool FakeBatteryRegistry::readProperties(QByteArray *plist) const
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "Cannot read battery registry file:" << path;
+        return false;
+    }
+    *plist = file.readAll();
+    return true;
+}
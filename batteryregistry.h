@@ -0,0 +1,44 @@
+#ifndef BATTERYREGISTRY_H
+#define BATTERYREGISTRY_H
+
+#include <QByteArray>
+#include <QSharedPointer>
+#include <QString>
+
+// Свойства AppleSmartBattery из IORegistry в виде XML plist — в том же
+// формате, что печатает `ioreg -rn AppleSmartBattery -a`, поэтому данные
+// из реестра и из ioreg разбирает один разборщик.
+class BatteryRegistry
+{
+public:
+    virtual ~BatteryRegistry() = default;
+
+    // false, если реестр недоступен и нужно запустить ioreg. Пустой plist
+    // означает, что батареи нет (настольный Mac)
+    virtual bool readProperties(QByteArray *plist) const = 0;
+
+    // IOKit на macOS. Переменная окружения MAC_DIAGNOSTIC_BATTERY_PLIST
+    // подменяет реестр файлом — для проверки на машинах без батареи и Linux
+    static QSharedPointer<BatteryRegistry> system();
+};
+
+// Прямое чтение IORegistry; вне macOS всегда недоступно
+class IOKitBatteryRegistry : public BatteryRegistry
+{
+public:
+    bool readProperties(QByteArray *plist) const override;
+};
+
+// Свойства из файла с выводом ioreg или сохранённым plist
+class FakeBatteryRegistry : public BatteryRegistry
+{
+public:
+    explicit FakeBatteryRegistry(const QString &plistPath);
+
+    bool readProperties(QByteArray *plist) const override;
+
+private:
+    QString path;
+};
+
+#endif // BATTERYREGISTRY_H
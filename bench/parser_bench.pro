@@ -0,0 +1,12 @@
+# Микробенчмарки разборщиков вывода проверок и DiagnosticResults::toString
+QT       = core
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+TARGET = parser_bench
+
+include(../diagnostic_core.pri)
+
+SOURCES += \
+    parserbench.cpp
@@ -0,0 +1,369 @@
+// Микробенчмарки разборщиков: время на байт, число выделений памяти и пик
+// резидентной памяти на маленьких, типичных и патологических входных данных.
+//
+// Выделения считаются через operator new; буферы QString/QByteArray Qt
+// выделяет через malloc, поэтому они видны только в пике памяти.
+
+#include "builtinprobes.h"
+#include "diagnosticresults.h"
+#include "patternmatcher.h"
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QList>
+#include <QTextStream>
+#include <atomic>
+#include <cstdlib>
+#include <functional>
+#include <new>
+
+#ifdef Q_OS_UNIX
+#include <sys/resource.h>
+#endif
+
+namespace {
+
+std::atomic<quint64> allocationCount{0};
+
+} // namespace
+
+void *operator new(std::size_t size)
+{
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    if (void *pointer = std::malloc(size ? size : 1)) {
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void *pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete[](void *pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void *pointer, std::size_t) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete[](void *pointer, std::size_t) noexcept
+{
+    std::free(pointer);
+}
+
+namespace {
+
+// Размер порции, которой вывод приходит из канала
+const int PipeChunkSize = 64 * 1024;
+
+struct BenchResult {
+    QString name;
+    qsizetype bytes = 0;
+    int iterations = 0;
+    double nsPerOp = 0;
+    double allocationsPerOp = 0;
+    qint64 peakRssKb = 0;
+};
+
+qint64 peakRssKb()
+{
+#ifdef Q_OS_UNIX
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+#ifdef Q_OS_MACOS
+        return usage.ru_maxrss / 1024; // на macOS в байтах
+#else
+        return usage.ru_maxrss;
+#endif
+    }
+#endif
+    return 0;
+}
+
+BenchResult measure(const QString &name, qsizetype bytes, qint64 minTimeMs, const std::function<void()> &operation)
+{
+    // Прогрев и подбор числа итераций
+    operation();
+    int iterations = 1;
+    qint64 elapsedNs = 0;
+    quint64 allocations = 0;
+
+    for (;;) {
+        const quint64 allocationsBefore = allocationCount.load();
+        QElapsedTimer timer;
+        timer.start();
+        for (int i = 0; i < iterations; ++i) {
+            operation();
+        }
+        elapsedNs = timer.nsecsElapsed();
+        allocations = allocationCount.load() - allocationsBefore;
+
+        if (elapsedNs >= minTimeMs * 1000000 || iterations >= (1 << 24)) {
+            break;
+        }
+        iterations *= 2;
+    }
+
+    BenchResult result;
+    result.name = name;
+    result.bytes = bytes;
+    result.iterations = iterations;
+    result.nsPerOp = double(elapsedNs) / iterations;
+    result.allocationsPerOp = double(allocations) / iterations;
+    result.peakRssKb = peakRssKb();
+    return result;
+}
+
+void feedParser(const Probe &probe, const QByteArray &data)
+{
+    const QSharedPointer<ProbeParser> parser = probe.createParser();
+    DiagnosticResults results;
+    for (qsizetype position = 0; position < data.size(); position += PipeChunkSize) {
+        const qsizetype length = qMin<qsizetype>(PipeChunkSize, data.size() - position);
+        parser->consume(QByteArray::fromRawData(data.constData() + position, length), results);
+    }
+    parser->finish(results);
+    probe.finish(true, results);
+}
+
+QByteArray batteryPlist(int padding)
+{
+    QByteArray plist = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+                       "<!DOCTYPE plist PUBLIC \"-//Apple//DTD PLIST 1.0//EN\" "
+                       "\"http://www.apple.com/DTDs/PropertyList-1.0.dtd\">\n"
+                       "<plist version=\"1.0\">\n<array>\n\t<dict>\n"
+                       "\t\t<key>AppleRawMaxCapacity</key>\n\t\t<integer>4427</integer>\n";
+    // Вложенные словари с одноимёнными ключами перед нужными значениями
+    for (int i = 0; i < padding; ++i) {
+        plist += "\t\t<key>BatteryData" + QByteArray::number(i) + "</key>\n\t\t<dict>\n"
+                 "\t\t\t<key>CycleCount</key>\n\t\t\t<integer>" + QByteArray::number(i) + "</integer>\n"
+                 "\t\t\t<key>DesignCapacity</key>\n\t\t\t<integer>5088</integer>\n"
+                 "\t\t\t<key>CellVoltage</key>\n\t\t\t<array>\n\t\t\t\t<integer>3871</integer>\n"
+                 "\t\t\t\t<integer>3872</integer>\n\t\t\t</array>\n\t\t</dict>\n";
+    }
+    plist += "\t\t<key>CycleCount</key>\n\t\t<integer>412</integer>\n"
+             "\t\t<key>DesignCapacity</key>\n\t\t<integer>5088</integer>\n"
+             "\t\t<key>MaxCapacity</key>\n\t\t<integer>100</integer>\n"
+             "\t\t<key>PermanentFailureStatus</key>\n\t\t<integer>0</integer>\n"
+             "\t</dict>\n</array>\n</plist>\n";
+    return plist;
+}
+
+QByteArray diskOutput(int checkLines, int errorEvery)
+{
+    QByteArray output = "Started file system verification on disk3s1s1 (Macintosh HD)\n"
+                        "Verifying file system\n";
+    for (int i = 0; i < checkLines; ++i) {
+        output += "Checking the fsroot tree of snapshot " + QByteArray::number(i) + "\n";
+        if (errorEvery > 0 && i % errorEvery == 0) {
+            output += "error: inode_val: object (oid 0x" + QByteArray::number(i, 16) + "): Error: invalid flags\n";
+        }
+    }
+    output += "The volume /dev/rdisk3s1s1 appears to be OK\n"
+              "Finished file system verification on disk3s1s1 (Macintosh HD)\n";
+    return output;
+}
+
+QByteArray diskInfoPlist()
+{
+    return "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+           "<!DOCTYPE plist PUBLIC \"-//Apple//DTD PLIST 1.0//EN\" "
+           "\"http://www.apple.com/DTDs/PropertyList-1.0.dtd\">\n"
+           "<plist version=\"1.0\">\n<dict>\n"
+           "\t<key>APFSContainerReference</key>\n\t<string>disk3</string>\n"
+           "\t<key>APFSPhysicalStores</key>\n\t<array>\n\t\t<dict>\n"
+           "\t\t\t<key>APFSPhysicalStore</key>\n\t\t\t<string>disk0s2</string>\n"
+           "\t\t</dict>\n\t</array>\n"
+           "\t<key>DeviceIdentifier</key>\n\t<string>disk3s1s1</string>\n"
+           "\t<key>FilesystemType</key>\n\t<string>apfs</string>\n"
+           "\t<key>Internal</key>\n\t<true/>\n"
+           "\t<key>SMARTStatus</key>\n\t<string>Verified</string>\n"
+           "\t<key>VolumeName</key>\n\t<string>Macintosh HD</string>\n"
+           "</dict>\n</plist>\n";
+}
+
+QByteArray appleIdPlist(int accounts, int servicesPerAccount)
+{
+    QByteArray plist = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+                       "<!DOCTYPE plist PUBLIC \"-//Apple//DTD PLIST 1.0//EN\" "
+                       "\"http://www.apple.com/DTDs/PropertyList-1.0.dtd\">\n"
+                       "<plist version=\"1.0\">\n<dict>\n\t<key>Accounts</key>\n\t<array>\n";
+    for (int account = 0; account < accounts; ++account) {
+        plist += "\t\t<dict>\n\t\t\t<key>AccountID</key>\n\t\t\t<string>user" + QByteArray::number(account)
+                 + "@example.com</string>\n\t\t\t<key>LoggedIn</key>\n\t\t\t<true/>\n"
+                   "\t\t\t<key>Services</key>\n\t\t\t<array>\n";
+        for (int service = 0; service < servicesPerAccount; ++service) {
+            const QByteArray name = service == 0 ? QByteArray("FIND_MY_MAC")
+                                                 : "SERVICE_" + QByteArray::number(service);
+            plist += "\t\t\t\t<dict>\n\t\t\t\t\t<key>Enabled</key>\n\t\t\t\t\t<true/>\n"
+                     "\t\t\t\t\t<key>Name</key>\n\t\t\t\t\t<string>" + name + "</string>\n\t\t\t\t</dict>\n";
+        }
+        plist += "\t\t\t</array>\n\t\t</dict>\n";
+    }
+    plist += "\t</array>\n</dict>\n</plist>\n";
+    return plist;
+}
+
+DiagnosticResults reportResults(int extraValues)
+{
+    DiagnosticResults results;
+    results.machineSerial = "C02SAMPLE0001";
+    results.machineModel = "MacBookPro16,1";
+    results.cycleCounts = 412;
+    results.maxCapacity = 76;
+    results.batteryCondition = "Service Recommended";
+    results.hasAppleID = true;
+    results.appleIDEmail = "employee@example.com";
+    results.findMyMacEnabled = true;
+    results.diskCheckPassed = false;
+    results.diskStatus = "error: invalid flags";
+    results.recommendations << "Выйдите из Apple ID перед передачей устройства"
+                            << "Рекомендуется заменить батарею (ёмкость менее 80%)";
+    for (int i = 0; i < extraValues; ++i) {
+        results.values.insert(QString("probe%1.value").arg(i), i);
+    }
+    return results;
+}
+
+void printResult(QTextStream &out, const BenchResult &result)
+{
+    const double nsPerByte = result.bytes > 0 ? result.nsPerOp / result.bytes : 0;
+    out << qSetFieldWidth(34) << Qt::left << result.name
+        << qSetFieldWidth(12) << Qt::right << result.bytes
+        << qSetFieldWidth(10) << result.iterations
+        << qSetFieldWidth(14) << QString::number(result.nsPerOp, 'f', 0)
+        << qSetFieldWidth(10) << QString::number(nsPerByte, 'f', 2)
+        << qSetFieldWidth(12) << QString::number(result.allocationsPerOp, 'f', 1)
+        << qSetFieldWidth(12) << result.peakRssKb
+        << qSetFieldWidth(0) << Qt::endl;
+}
+
+void silentMessageHandler(QtMsgType type, const QMessageLogContext &, const QString &message)
+{
+    if (type != QtDebugMsg && type != QtInfoMsg) {
+        QTextStream(stderr) << message << Qt::endl;
+    }
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    qInstallMessageHandler(silentMessageHandler);
+
+    // Аргументы: [подстрока имени] [минимальное время на тест, мс]
+    const QStringList arguments = app.arguments();
+    const QString filter = arguments.value(1);
+    const qint64 minTimeMs = arguments.value(2, "200").toLongLong();
+
+    BatteryProbe batteryProbe;
+    DiskScreenProbe diskScreenProbe;
+    DiskProbe diskProbe;
+    AppleIDProbe appleIdProbe;
+
+    struct Case {
+        QString name;
+        const Probe *probe;
+        QByteArray data;
+    };
+
+    const QList<Case> parserCases = {
+        {"battery/small", &batteryProbe, batteryPlist(0)},
+        {"battery/typical", &batteryProbe, batteryPlist(2)},
+        {"battery/pathological-4MB", &batteryProbe, batteryPlist(16000)},
+        {"disk-screen/typical", &diskScreenProbe, diskInfoPlist()},
+        {"disk/small", &diskProbe, diskOutput(1, 0)},
+        {"disk/typical", &diskProbe, diskOutput(20, 0)},
+        {"disk/pathological-errors", &diskProbe, diskOutput(100000, 10)},
+        {"appleid/small", &appleIdProbe, appleIdPlist(0, 0)},
+        {"appleid/typical", &appleIdProbe, appleIdPlist(1, 12)},
+        {"appleid/pathological-accounts", &appleIdProbe, appleIdPlist(2000, 20)},
+    };
+
+    QTextStream out(stdout);
+    out << qSetFieldWidth(34) << Qt::left << "benchmark"
+        << qSetFieldWidth(12) << Qt::right << "bytes"
+        << qSetFieldWidth(10) << "iters"
+        << qSetFieldWidth(14) << "ns/op"
+        << qSetFieldWidth(10) << "ns/byte"
+        << qSetFieldWidth(12) << "allocs/op"
+        << qSetFieldWidth(12) << "peakRSS KB"
+        << qSetFieldWidth(0) << Qt::endl;
+
+    for (const Case &benchCase : parserCases) {
+        if (!filter.isEmpty() && !benchCase.name.contains(filter)) {
+            continue;
+        }
+        const Probe *probe = benchCase.probe;
+        const QByteArray data = benchCase.data;
+        printResult(out, measure(benchCase.name, data.size(), minTimeMs,
+                                 [probe, data]() { feedParser(*probe, data); }));
+    }
+
+    // Поиск образцов в строках вывода diskutil: прежние три QString::contains
+    // на строку против одного прохода общего автомата
+    const QByteArray diskText = diskOutput(100000, 10);
+    QList<QByteArrayView> diskLines;
+    for (qsizetype start = 0; start < diskText.size(); ) {
+        qsizetype end = diskText.indexOf('\n', start);
+        if (end < 0) {
+            end = diskText.size();
+        }
+        diskLines << QByteArrayView(diskText).sliced(start, end - start);
+        start = end + 1;
+    }
+    const PatternMatcher diskMatcher(QList<QByteArray>() << "appears to be OK" << "No problems found" << "Error");
+
+    const QList<QPair<QString, std::function<void()>>> matcherCases = {
+        {"matcher/qstring-contains", [&diskLines]() {
+             int hits = 0;
+             for (QByteArrayView line : diskLines) {
+                 const QString text = QString::fromUtf8(line);
+                 hits += text.contains("appears to be OK") || text.contains("No problems found");
+                 hits += text.contains("Error");
+             }
+             volatile int sink = hits;
+             Q_UNUSED(sink);
+         }},
+        {"matcher/pattern-set", [&diskLines, &diskMatcher]() {
+             int hits = 0;
+             for (QByteArrayView line : diskLines) {
+                 hits += diskMatcher.match(line) != 0;
+             }
+             volatile int sink = hits;
+             Q_UNUSED(sink);
+         }},
+    };
+    for (const auto &matcherCase : matcherCases) {
+        if (!filter.isEmpty() && !matcherCase.first.contains(filter)) {
+            continue;
+        }
+        printResult(out, measure(matcherCase.first, diskText.size(), minTimeMs, matcherCase.second));
+    }
+
+    const QList<QPair<QString, DiagnosticResults>> reportCases = {
+        {"toString/typical", reportResults(0)},
+        {"toString/many-values", reportResults(1000)},
+    };
+    for (const auto &reportCase : reportCases) {
+        if (!filter.isEmpty() && !reportCase.first.contains(filter)) {
+            continue;
+        }
+        const DiagnosticResults results = reportCase.second;
+        const qsizetype bytes = results.toString().toUtf8().size();
+        printResult(out, measure(reportCase.first, bytes, minTimeMs,
+                                 [results]() { volatile qsizetype size = results.toString().size(); Q_UNUSED(size); }));
+    }
+
+    return 0;
+}
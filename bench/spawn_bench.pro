@@ -0,0 +1,12 @@
+# Сравнение запуска команд проверок через QProcess и posix_spawn
+QT       = core
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+TARGET = spawn_bench
+
+include(../diagnostic_core.pri)
+
+SOURCES += \
+    spawnbench.cpp
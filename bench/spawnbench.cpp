@@ -0,0 +1,194 @@
+// Запуск команд проверок: QProcess (SystemCommandRunner) против
+// posix_spawn с общим циклом poll (SpawnCommandRunner). Меряются время до
+// запуска процесса, полное время команды, стоимость байта вывода и число
+// сигналов outputReady на команду, в том числе при многих одновременных
+// командах, как в режиме агента.
+
+#include "commandrunner.h"
+#include "spawnrunner.h"
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QList>
+#include <QTextStream>
+#include <QTimer>
+
+namespace {
+
+struct Command {
+    QString program;
+    QStringList arguments;
+};
+
+struct BenchResult {
+    QString name;
+    QString runner;
+    int runs = 0;
+    int failures = 0;
+    double spawnUs = 0;
+    double totalUs = 0;
+    qint64 bytes = 0;
+    double nsPerByte = 0;
+    double chunksPerRun = 0;
+};
+
+// Запускает commands одновременно и ждёт завершения всех
+BenchResult runBatch(const CommandRunner &runner, const QList<Command> &commands)
+{
+    BenchResult result;
+    QEventLoop loop;
+    QElapsedTimer timer;
+    int remaining = commands.size();
+    qint64 spawnNs = 0;
+    qint64 chunks = 0;
+
+    QList<ProbeProcess *> processes;
+    for (int i = 0; i < commands.size(); ++i) {
+        ProbeProcess *process = runner.createProcess(nullptr);
+        QObject::connect(process, &ProbeProcess::started, [&]() { spawnNs += timer.nsecsElapsed(); });
+        QObject::connect(process, &ProbeProcess::outputReady, [&](const QByteArray &chunk) {
+            result.bytes += chunk.size();
+            ++chunks;
+        });
+        const auto done = [&]() {
+            if (--remaining == 0) {
+                loop.quit();
+            }
+        };
+        QObject::connect(process, &ProbeProcess::finished, done);
+        QObject::connect(process, &ProbeProcess::failedToStart, [&, done]() {
+            ++result.failures;
+            done();
+        });
+        processes << process;
+    }
+
+    // Зависшая команда не должна остановить бенчмарк
+    QTimer::singleShot(60000, &loop, &QEventLoop::quit);
+    timer.start();
+    for (int i = 0; i < commands.size(); ++i) {
+        processes.at(i)->start("bench", commands.at(i).program, commands.at(i).arguments);
+    }
+    loop.exec();
+    const qint64 totalNs = timer.nsecsElapsed();
+    qDeleteAll(processes);
+
+    result.runs = commands.size();
+    result.spawnUs = spawnNs / 1000.0 / commands.size();
+    result.totalUs = totalNs / 1000.0;
+    result.nsPerByte = result.bytes > 0 ? double(totalNs) / result.bytes : 0;
+    result.chunksPerRun = double(chunks) / commands.size();
+    return result;
+}
+
+// Среднее по iterations повторам пакета
+BenchResult measure(const QString &name, const QString &runnerName, const CommandRunner &runner,
+                    const QList<Command> &commands, int iterations)
+{
+    runBatch(runner, commands); // прогрев
+
+    BenchResult total;
+    for (int i = 0; i < iterations; ++i) {
+        const BenchResult batch = runBatch(runner, commands);
+        total.failures += batch.failures;
+        total.spawnUs += batch.spawnUs;
+        total.totalUs += batch.totalUs;
+        total.bytes += batch.bytes;
+        total.nsPerByte += batch.nsPerByte;
+        total.chunksPerRun += batch.chunksPerRun;
+    }
+
+    BenchResult result;
+    result.name = name;
+    result.runner = runnerName;
+    result.runs = commands.size() * iterations;
+    result.failures = total.failures;
+    result.spawnUs = total.spawnUs / iterations;
+    result.totalUs = total.totalUs / iterations;
+    result.bytes = total.bytes / iterations;
+    result.nsPerByte = total.nsPerByte / iterations;
+    result.chunksPerRun = total.chunksPerRun / iterations;
+    return result;
+}
+
+void printResult(QTextStream &out, const BenchResult &result)
+{
+    out << qSetFieldWidth(24) << Qt::left << result.name
+        << qSetFieldWidth(10) << result.runner
+        << qSetFieldWidth(8) << Qt::right << result.runs
+        << qSetFieldWidth(12) << QString::number(result.spawnUs, 'f', 1)
+        << qSetFieldWidth(14) << QString::number(result.totalUs, 'f', 1)
+        << qSetFieldWidth(12) << result.bytes
+        << qSetFieldWidth(10) << QString::number(result.nsPerByte, 'f', 2)
+        << qSetFieldWidth(12) << QString::number(result.chunksPerRun, 'f', 1)
+        << qSetFieldWidth(8) << result.failures
+        << qSetFieldWidth(0) << Qt::endl;
+}
+
+void silentMessageHandler(QtMsgType type, const QMessageLogContext &, const QString &message)
+{
+    if (type != QtDebugMsg && type != QtInfoMsg) {
+        QTextStream(stderr) << message << Qt::endl;
+    }
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    qInstallMessageHandler(silentMessageHandler);
+
+    // Аргументы: [подстрока имени] [число повторов]
+    const QStringList arguments = app.arguments();
+    const QString filter = arguments.value(1);
+    const int iterations = qMax(1, arguments.value(2, "20").toInt());
+
+    const Command trueCommand{"true", {}};
+    // 16 МБ вывода порциями по 64 КБ, как у полной проверки тома с ошибками
+    const Command bulkCommand{"dd", {"if=/dev/zero", "bs=65536", "count=256"}};
+    // Много мелких строк: вывод приходит маленькими порциями
+    const Command linesCommand{"sh", {"-c", "i=0; while [ $i -lt 2000 ]; do echo line $i; i=$((i+1)); done"}};
+
+    struct Case {
+        QString name;
+        QList<Command> commands;
+    };
+    const QList<Case> cases = {
+        {"spawn/true", {trueCommand}},
+        {"output/16MB", {bulkCommand}},
+        {"output/2000-lines", {linesCommand}},
+        {"concurrent/32-true", QList<Command>(32, trueCommand)},
+        {"concurrent/32-16MB", QList<Command>(32, bulkCommand)},
+    };
+
+    const SystemCommandRunner qprocessRunner;
+    const SpawnCommandRunner spawnRunner;
+    const QList<QPair<QString, const CommandRunner *>> runners = {
+        {"qprocess", &qprocessRunner},
+        {"spawn", &spawnRunner},
+    };
+
+    QTextStream out(stdout);
+    out << qSetFieldWidth(24) << Qt::left << "benchmark"
+        << qSetFieldWidth(10) << "runner"
+        << qSetFieldWidth(8) << Qt::right << "runs"
+        << qSetFieldWidth(12) << "spawn us"
+        << qSetFieldWidth(14) << "batch us"
+        << qSetFieldWidth(12) << "bytes"
+        << qSetFieldWidth(10) << "ns/byte"
+        << qSetFieldWidth(12) << "chunks/run"
+        << qSetFieldWidth(8) << "failed"
+        << qSetFieldWidth(0) << Qt::endl;
+
+    for (const Case &benchCase : cases) {
+        if (!filter.isEmpty() && !benchCase.name.contains(filter)) {
+            continue;
+        }
+        for (const auto &runner : runners) {
+            printResult(out, measure(benchCase.name, runner.first, *runner.second, benchCase.commands, iterations));
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,431 @@
+#include "builtinprobes.h"
+#include "patternmatcher.h"
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QStorageInfo>
+
+#ifdef Q_OS_MACOS
+#include <sys/attr.h>
+#include <unistd.h>
+#endif
+
+void registerBuiltinProbes(ProbeRegistry &registry)
+{
+    registry.registerProbe(QSharedPointer<Probe>(new BatteryProbe));
+    registry.registerProbe(QSharedPointer<Probe>(new DiskScreenProbe));
+    registry.registerProbe(QSharedPointer<Probe>(new DiskProbe));
+    registry.registerProbe(QSharedPointer<Probe>(new AppleIDProbe));
+}
+
+void requireDeepDiskCheck(ProbeRegistry &registry)
+{
+    registry.registerProbe(QSharedPointer<Probe>(new DiskProbe(true)));
+}
+
+namespace {
+
+// UUID тома из getattrlist: QStorageInfo его не отдаёт, а diskutil ради
+// отпечатка запускать слишком дорого. Пусто вне macOS и при ошибке
+QByteArray volumeUuid(const QString &mountPoint)
+{
+#ifdef Q_OS_MACOS
+    struct attrlist request = {};
+    request.bitmapcount = ATTR_BIT_MAP_COUNT;
+    request.volattr = ATTR_VOL_INFO | ATTR_VOL_UUID;
+
+    struct {
+        u_int32_t length;
+        uuid_t uuid;
+    } __attribute__((aligned(4), packed)) reply = {};
+
+    const QByteArray path = QFile::encodeName(mountPoint);
+    if (getattrlist(path.constData(), &request, &reply, sizeof(reply), 0) != 0) {
+        qDebug() << "Cannot read volume UUID:" << mountPoint;
+        return QByteArray();
+    }
+    return QByteArray(reinterpret_cast<const char *>(reply.uuid), sizeof(reply.uuid)).toHex();
+#else
+    Q_UNUSED(mountPoint);
+    return QByteArray();
+#endif
+}
+
+// Разбор свойств AppleSmartBattery. Берутся только ключи словаря самой
+// батареи: во вложенных словарях вроде BatteryData есть одноимённые ключи.
+// У `ioreg -a` словарь лежит в массиве, у IORegistry — в корне, в обоих
+// случаях это первый уровень словарей.
+class BatteryParser : public PlistProbeParser
+{
+public:
+    explicit BatteryParser(int minCapacity) : minCapacity(minCapacity) {}
+
+protected:
+    void dictStarted(QStringView key) override
+    {
+        Q_UNUSED(key);
+        ++depth;
+    }
+
+    void dictFinished() override
+    {
+        --depth;
+    }
+
+    void scalarValue(QStringView key, QStringView value) override
+    {
+        if (depth != 1) {
+            return;
+        }
+        if (key == u"CycleCount") {
+            cycleCount = value.toInt();
+        } else if (key == u"AppleRawMaxCapacity") {
+            rawMaxCapacity = value.toInt();
+        } else if (key == u"MaxCapacity") {
+            maxCapacity = value.toInt();
+        } else if (key == u"DesignCapacity") {
+            designCapacity = value.toInt();
+        } else if (key == u"PermanentFailureStatus") {
+            permanentFailure = value.toInt() != 0;
+        } else {
+            return;
+        }
+        batteryFound = true;
+    }
+
+    void finishDocument(bool complete, DiagnosticResults &results) override
+    {
+        if (!complete && batteryFound) {
+            qDebug() << "Battery plist is incomplete:" << errorString();
+        }
+        if (!batteryFound) {
+            // Настольный Mac: ioreg ничего не выводит
+            return;
+        }
+
+        results.cycleCounts = cycleCount;
+        // На Apple Silicon MaxCapacity — уже проценты, а ёмкость в мА·ч
+        // лежит в AppleRawMaxCapacity; на Intel MaxCapacity в мА·ч
+        const int fullCapacity = rawMaxCapacity > 0 ? rawMaxCapacity : maxCapacity;
+        if (designCapacity > 0 && fullCapacity > 0) {
+            results.maxCapacity = qMin(100, qRound(fullCapacity * 100.0 / designCapacity));
+        }
+
+        // Те же значения, что показывает system_profiler; порог износа —
+        // тот же, что у рекомендации заменить батарею
+        const bool worn = results.maxCapacity > 0 && results.maxCapacity < minCapacity;
+        results.batteryCondition = (permanentFailure || worn) ? "Service Recommended" : "Normal";
+    }
+
+private:
+    int minCapacity;
+    int depth = 0;
+    bool batteryFound = false;
+    int cycleCount = 0;
+    int rawMaxCapacity = 0;
+    int maxCapacity = 0;
+    int designCapacity = 0;
+    bool permanentFailure = false;
+};
+
+// Разбор `diskutil info -plist /`. SMARTStatus бывает "Verified",
+// "Failing" или "Not Supported" (внешние диски, виртуальные машины)
+class DiskScreenParser : public PlistProbeParser
+{
+protected:
+    void dictStarted(QStringView key) override
+    {
+        Q_UNUSED(key);
+        ++depth;
+    }
+
+    void dictFinished() override
+    {
+        --depth;
+    }
+
+    void scalarValue(QStringView key, QStringView value) override
+    {
+        if (depth != 1) {
+            return;
+        }
+        if (key == u"SMARTStatus") {
+            smartStatus = value.toString();
+        } else if (key == u"APFSContainerReference") {
+            container = value.toString();
+        }
+    }
+
+    void finishDocument(bool complete, DiagnosticResults &results) override
+    {
+        if (!complete) {
+            qDebug() << "diskutil info plist is incomplete:" << errorString();
+            return;
+        }
+
+        const QString where = container.isEmpty() ? QString() : " (" + container + ")";
+        if (smartStatus == "Verified") {
+            results.diskCheckPassed = true;
+            results.diskStatus.clear();
+            results.diskCheckTier = "screen";
+        } else if (smartStatus == "Failing") {
+            results.diskCheckPassed = false;
+            results.diskStatus = "SMART: диск неисправен" + where;
+            results.diskCheckTier = "screen";
+        } else {
+            qDebug() << "SMART status is inconclusive:" << smartStatus;
+        }
+    }
+
+private:
+    int depth = 0;
+    QString smartStatus;
+    QString container;
+};
+
+// Образцы вывода `diskutil verifyVolume`, индексы — позиции в списке
+enum DiskPattern {
+    DiskVolumeOk,
+    DiskNoProblems,
+    DiskError
+};
+
+// Автомат строится один раз на процесс и общий для всех запусков
+const PatternMatcher &diskPatterns()
+{
+    static const PatternMatcher matcher(QList<QByteArray>()
+                                        << "appears to be OK"
+                                        << "No problems found"
+                                        << "Error");
+    return matcher;
+}
+
+class DiskParser : public LineProbeParser
+{
+protected:
+    void parseLineBytes(QByteArrayView line, DiagnosticResults &results) override
+    {
+        Q_UNUSED(results);
+        // Один проход по строке для всех образцов; QString создаётся
+        // только для строк с ошибками, которые попадут в отчёт
+        const quint64 found = diskPatterns().match(line);
+        if (PatternMatcher::contains(found, DiskVolumeOk) || PatternMatcher::contains(found, DiskNoProblems)) {
+            passed = true;
+        }
+        if (PatternMatcher::contains(found, DiskError)) {
+            errors << QString::fromUtf8(line);
+        }
+    }
+
+    void finishLines(DiagnosticResults &results) override
+    {
+        // Неисправность по SMART не отменяется исправной файловой системой
+        const bool smartFailed = results.diskCheckTier == "screen" && !results.diskCheckPassed;
+        if (smartFailed) {
+            errors.prepend(results.diskStatus);
+        }
+
+        results.diskCheckPassed = passed && !smartFailed;
+        results.diskCheckTier = "verify";
+        results.diskStatus.clear();
+        if (!results.diskCheckPassed) {
+            results.diskStatus = errors.join(", ");
+            if (results.diskStatus.isEmpty()) {
+                results.diskStatus = "Неизвестная ошибка";
+            }
+        }
+    }
+
+private:
+    bool passed = false;
+    QStringList errors;
+};
+
+// Разбор `defaults export MobileMeAccounts -` (XML plist). Службы аккаунта
+// лежат словарями с ключами Name и Enabled; порядок ключей не важен, поэтому
+// статус Find My Mac определяется при закрытии словаря.
+class AppleIDParser : public PlistProbeParser
+{
+protected:
+    void dictStarted(QStringView key) override
+    {
+        Q_UNUSED(key);
+        dicts.append(DictState());
+    }
+
+    void dictFinished() override
+    {
+        if (dicts.isEmpty()) {
+            return;
+        }
+        const DictState state = dicts.takeLast();
+        if (state.findMyMac) {
+            findMyMacEnabled = state.enabled;
+        }
+    }
+
+    void scalarValue(QStringView key, QStringView value) override
+    {
+        if (key == u"AccountID" || key == u"AppleID") {
+            accountFound = true;
+            // Берём первый аккаунт
+            if (key == u"AccountID" && email.isEmpty()) {
+                email = value.toString();
+            }
+        }
+
+        if (dicts.isEmpty()) {
+            return;
+        }
+        // Имя службы не сохраняется: достаточно знать, Find My Mac ли это
+        if (key == u"Name") {
+            dicts.last().findMyMac = (value == u"FIND_MY_MAC");
+        } else if (key == u"Enabled") {
+            dicts.last().enabled = (value == u"true" || value == u"1");
+        }
+    }
+
+    void finishDocument(bool complete, DiagnosticResults &results) override
+    {
+        if (!complete) {
+            qDebug() << "Apple ID plist is incomplete:" << errorString();
+        }
+
+        results.hasAppleID = accountFound;
+        if (accountFound) {
+            results.appleIDEmail = email.isEmpty() ? QString("Найден (email скрыт)") : email;
+            results.findMyMacEnabled = findMyMacEnabled;
+        } else {
+            results.appleIDEmail.clear();
+            results.findMyMacEnabled = false;
+        }
+
+        qDebug() << "Has Apple ID:" << results.hasAppleID
+                 << "Find My Mac Enabled:" << results.findMyMacEnabled;
+    }
+
+private:
+    struct DictState {
+        bool findMyMac = false;
+        bool enabled = false;
+    };
+
+    QList<DictState> dicts;
+    bool accountFound = false;
+    bool findMyMacEnabled = false;
+    QString email;
+};
+
+} // namespace
+
+BatteryProbe::BatteryProbe(const QSharedPointer<BatteryRegistry> &registry, int minCapacityPercent)
+    : registry(registry), minCapacity(minCapacityPercent)
+{
+}
+
+bool BatteryProbe::readNative(QByteArray *output) const
+{
+    return registry && registry->readProperties(output);
+}
+
+QSharedPointer<ProbeParser> BatteryProbe::createParser() const
+{
+    return QSharedPointer<ProbeParser>(new BatteryParser(minCapacity));
+}
+
+void BatteryProbe::finish(bool success, DiagnosticResults &results) const
+{
+    Q_UNUSED(success);
+    // Нулевая ёмкость означает, что батареи нет (настольный Mac)
+    if (results.maxCapacity > 0 && results.maxCapacity < minCapacity) {
+        results.recommendations.append(QString("Рекомендуется заменить батарею (ёмкость менее %1%)")
+                                           .arg(minCapacity));
+    }
+}
+
+QSharedPointer<ProbeParser> DiskScreenProbe::createParser() const
+{
+    return QSharedPointer<ProbeParser>(new DiskScreenParser);
+}
+
+QByteArray DiskProbe::fingerprint() const
+{
+    const QStorageInfo root = QStorageInfo::root();
+    const QByteArray uuid = volumeUuid(root.rootPath());
+    if (uuid.isEmpty()) {
+        // Без UUID тот же том не отличить от подменённого
+        return QByteArray();
+    }
+    return uuid + ":" + root.device() + ":" + root.fileSystemType();
+}
+
+bool DiskProbe::shouldRun(const DiagnosticResults &results) const
+{
+    return alwaysVerify || results.diskCheckTier != "screen";
+}
+
+QSharedPointer<ProbeParser> DiskProbe::createParser() const
+{
+    return QSharedPointer<ProbeParser>(new DiskParser);
+}
+
+void DiskProbe::finish(bool success, DiagnosticResults &results) const
+{
+    // Ненулевой код выхода diskutil означает проблему даже при «хорошем» выводе
+    if (!success) {
+        results.diskCheckPassed = false;
+        if (results.diskStatus.isEmpty()) {
+            results.diskStatus = "Неизвестная ошибка";
+        }
+    }
+}
+
+void DiskProbe::abort(DiagnosticResults &results) const
+{
+    results.diskCheckPassed = false;
+    results.diskStatus = "Проверка не завершена";
+    results.diskCheckTier.clear();
+}
+
+QSharedPointer<ProbeParser> AppleIDProbe::createParser() const
+{
+    return QSharedPointer<ProbeParser>(new AppleIDParser);
+}
+
+QString AppleIDProbe::program() const
+{
+    return user.isEmpty() ? QString("defaults") : QString("sudo");
+}
+
+QStringList AppleIDProbe::arguments() const
+{
+    const QStringList defaults = QStringList() << "export" << "MobileMeAccounts" << "-";
+    if (user.isEmpty()) {
+        return defaults;
+    }
+    // -n: от root пароль не нужен, а спросить его здесь некому
+    return QStringList() << "-n" << "-u" << user.name << "-H" << "--" << "defaults" << defaults;
+}
+
+QByteArray AppleIDProbe::fingerprint() const
+{
+    // cfprefsd записывает файл при входе и выходе из аккаунта
+    const QString home = user.isEmpty() ? QDir::homePath() : user.homePath;
+    const QFileInfo plist(home + "/Library/Preferences/MobileMeAccounts.plist");
+    // Имя пользователя в отпечатке: вывод другого пользователя не подходит
+    const QByteArray owner = user.name.toUtf8() + ":";
+    if (!plist.exists()) {
+        return owner + "missing";
+    }
+    return owner + QByteArray::number(plist.lastModified().toMSecsSinceEpoch()) + ":"
+           + QByteArray::number(plist.size());
+}
+
+void AppleIDProbe::finish(bool success, DiagnosticResults &results) const
+{
+    Q_UNUSED(success);
+    if (results.hasAppleID) {
+        results.recommendations.append("Выйдите из Apple ID перед передачей устройства");
+    }
+}
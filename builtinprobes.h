@@ -0,0 +1,108 @@
+#ifndef BUILTINPROBES_H
+#define BUILTINPROBES_H
+
+#include "batteryregistry.h"
+#include "probe.h"
+
+// Свойства AppleSmartBattery читаются из IORegistry напрямую; ioreg
+// запускается, только если реестр недоступен. Отпечатка нет: счётчик
+// поколений IORegistry общий на весь реестр и меняется постоянно, а
+// прямое чтение свойств батареи и так занимает доли миллисекунды, поэтому
+// при повторной проверке батарея читается заново
+class BatteryProbe : public Probe
+{
+public:
+    explicit BatteryProbe(const QSharedPointer<BatteryRegistry> &registry = BatteryRegistry::system(),
+                          int minCapacityPercent = 80);
+
+    QString id() const override { return "battery"; }
+    QString description() const override { return " Проверка состояния батареи..."; }
+    QString program() const override { return "/usr/sbin/ioreg"; }
+    QStringList arguments() const override { return QStringList() << "-rn" << "AppleSmartBattery" << "-a"; }
+    // 2: ioreg вместо system_profiler
+    int version() const override { return 2; }
+    QStringList resultKeys() const override { return QStringList() << "cycleCounts" << "maxCapacity" << "batteryCondition"; }
+    bool readNative(QByteArray *output) const override;
+    QSharedPointer<ProbeParser> createParser() const override;
+    void finish(bool success, DiagnosticResults &results) const override;
+
+private:
+    QSharedPointer<BatteryRegistry> registry;
+    // Ниже этой ёмкости рекомендуется замена батареи
+    int minCapacity;
+};
+
+// Быстрый опрос диска: статус SMART и APFS-контейнер загрузочного тома
+// из `diskutil info -plist /`, меньше секунды. Вердикт ставится, только
+// если SMART однозначен; иначе решает DiskProbe
+class DiskScreenProbe : public Probe
+{
+public:
+    QString id() const override { return "disk-screen"; }
+    QString description() const override { return " Быстрая проверка диска (SMART)..."; }
+    QString program() const override { return "diskutil"; }
+    QStringList arguments() const override { return QStringList() << "info" << "-plist" << "/"; }
+    int timeoutMs() const override { return 10 * 1000; }
+    QStringList resultKeys() const override { return QStringList() << "diskCheckPassed" << "diskStatus" << "diskCheckTier"; }
+    QSharedPointer<ProbeParser> createParser() const override;
+};
+
+// Полная проверка тома. Запускается после DiskScreenProbe и только если
+// быстрый опрос не дал вердикта или полная проверка запрошена явно
+class DiskProbe : public Probe
+{
+public:
+    explicit DiskProbe(bool alwaysVerify = false) : alwaysVerify(alwaysVerify) {}
+
+    QString id() const override { return "disk"; }
+    QString description() const override { return " Проверка состояния дисков..."; }
+    QString program() const override { return "diskutil"; }
+    QStringList arguments() const override { return QStringList() << "verifyVolume" << "/"; }
+    int timeoutMs() const override { return 15 * 60 * 1000; }
+    int cacheTtlSeconds() const override { return 10 * 60; }
+    QByteArray fingerprint() const override;
+    QStringList dependencies() const override { return QStringList() << "disk-screen"; }
+    bool shouldRun(const DiagnosticResults &results) const override;
+    QStringList resultKeys() const override { return QStringList() << "diskCheckPassed" << "diskStatus" << "diskCheckTier"; }
+    QSharedPointer<ProbeParser> createParser() const override;
+    void finish(bool success, DiagnosticResults &results) const override;
+    void abort(DiagnosticResults &results) const override;
+
+private:
+    bool alwaysVerify;
+};
+
+// Пользователь, чьи настройки читают проверки вроде Apple ID. Пустой —
+// пользователь текущего процесса
+struct ProbeUser {
+    QString name;
+    QString homePath;
+
+    bool isEmpty() const { return name.isEmpty(); }
+};
+
+// Аккаунт Apple ID хранится в настройках пользователя. Агент от root читает
+// их через sudo -u от имени пользователя, приславшего запрос
+class AppleIDProbe : public Probe
+{
+public:
+    explicit AppleIDProbe(const ProbeUser &user = ProbeUser()) : user(user) {}
+
+    QString id() const override { return "appleid"; }
+    QString description() const override { return " Проверка статуса Apple ID..."; }
+    QString program() const override;
+    QStringList arguments() const override;
+    QByteArray fingerprint() const override;
+    QStringList resultKeys() const override { return QStringList() << "hasAppleID" << "appleIDEmail" << "findMyMacEnabled"; }
+    QSharedPointer<ProbeParser> createParser() const override;
+    void finish(bool success, DiagnosticResults &results) const override;
+
+private:
+    ProbeUser user;
+};
+
+void registerBuiltinProbes(ProbeRegistry &registry);
+// Заменяет проверку диска на полную проверку тома независимо от SMART
+void requireDeepDiskCheck(ProbeRegistry &registry);
+
+#endif // BUILTINPROBES_H
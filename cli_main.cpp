@@ -0,0 +1,10 @@
+#include "headlessrunner.h"
+#include <QCoreApplication>
+
+int main(int argc, char *argv[])
+{
+    // Каталог кэша общий с оконным приложением
+    QCoreApplication::setApplicationName("mac_diagnostic");
+    QCoreApplication app(argc, argv);
+    return runHeadless(app);
+}
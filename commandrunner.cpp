@@ -0,0 +1,316 @@
+#include "commandrunner.h"
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QProcess>
+#include <QSaveFile>
+#include <QTimer>
+
+#ifdef Q_OS_UNIX
+#include <signal.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+QJsonObject readJsonObject(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QJsonObject();
+    }
+    return QJsonDocument::fromJson(file.readAll()).object();
+}
+
+bool writeJsonObject(const QString &path, const QJsonObject &object)
+{
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    file.write(QJsonDocument(object).toJson());
+    return file.commit();
+}
+
+class QProcessProbeProcess : public ProbeProcess
+{
+public:
+    explicit QProcessProbeProcess(QObject *parent)
+        : ProbeProcess(parent), process(new QProcess(this))
+    {
+#ifdef Q_OS_UNIX
+        // Своя группа процессов, чтобы kill() завершал и потомков команды
+        process->setChildProcessModifier([]() { ::setpgid(0, 0); });
+#endif
+
+        connect(process, &QProcess::started, this, &ProbeProcess::started);
+        connect(process, &QProcess::readyReadStandardOutput, this, [this]() { emitOutput(); });
+        connect(process, &QProcess::readyReadStandardError, this, [this]() { emitErrorOutput(); });
+        connect(process, &QProcess::finished,
+                this, [this](int exitCode, QProcess::ExitStatus exitStatus) {
+                    // Дочитываем то, что осталось в каналах после последнего readyRead
+                    emitOutput();
+                    emitErrorOutput();
+                    emit finished(exitCode, exitStatus == QProcess::NormalExit);
+                });
+        connect(process, &QProcess::errorOccurred,
+                this, [this](QProcess::ProcessError error) {
+                    if (error == QProcess::FailedToStart) {
+                        emit failedToStart(process->errorString());
+                    }
+                });
+    }
+
+    void start(const QString &probeId, const QString &program, const QStringList &arguments) override
+    {
+        Q_UNUSED(probeId);
+        process->start(program, arguments);
+    }
+
+    void kill() override
+    {
+#ifdef Q_OS_UNIX
+        const qint64 pid = process->processId();
+        if (pid > 0) {
+            ::kill(-static_cast<pid_t>(pid), SIGKILL);
+        }
+#endif
+        process->kill();
+    }
+
+private:
+    void emitOutput()
+    {
+        const QByteArray chunk = process->readAllStandardOutput();
+        if (!chunk.isEmpty()) {
+            emit outputReady(chunk);
+        }
+    }
+
+    void emitErrorOutput()
+    {
+        const QByteArray chunk = process->readAllStandardError();
+        if (!chunk.isEmpty()) {
+            emit errorOutputReady(chunk);
+        }
+    }
+
+    QProcess *process;
+};
+
+class ReplayProbeProcess : public ProbeProcess
+{
+public:
+    ReplayProbeProcess(const QString &directory, double delayScale, QObject *parent)
+        : ProbeProcess(parent), directory(directory), delayScale(delayScale),
+          timer(new QTimer(this))
+    {
+        timer->setSingleShot(true);
+        connect(timer, &QTimer::timeout, this, [this]() { step(); });
+    }
+
+    void start(const QString &probeId, const QString &program, const QStringList &arguments) override
+    {
+        Q_UNUSED(program);
+        Q_UNUSED(arguments);
+
+        QFile recorded(directory + "/" + probeId + ".stdout");
+        if (!recorded.open(QIODevice::ReadOnly)) {
+            const QString error = "Нет записи вывода для проверки " + probeId;
+            QTimer::singleShot(0, this, [this, error]() { emit failedToStart(error); });
+            return;
+        }
+        output = recorded.readAll();
+
+        QFile recordedErrors(directory + "/" + probeId + ".stderr");
+        if (recordedErrors.open(QIODevice::ReadOnly)) {
+            errorOutput = recordedErrors.readAll();
+        }
+
+        const QJsonObject meta = readJsonObject(directory + "/" + probeId + ".json");
+        exitCode = meta.value("exitCode").toInt(0);
+        chunkSize = meta.value("chunkSize").toInt(0);
+        chunkDelayMs = meta.value("chunkDelayMs").toInt(0);
+        hang = meta.value("hang").toBool(false);
+        if (chunkSize <= 0) {
+            chunkSize = qMax<qsizetype>(1, output.size());
+        }
+
+        // Записанная команда «запускается» сразу, задержка — это её работа
+        QTimer::singleShot(0, this, [this]() { emit started(); });
+        timer->start(scaled(meta.value("startDelayMs").toInt(0)));
+    }
+
+    void kill() override
+    {
+        if (done) {
+            return;
+        }
+        done = true;
+        timer->stop();
+        // Как у процесса, убитого сигналом: аварийное завершение
+        QTimer::singleShot(0, this, [this]() { emit finished(-1, false); });
+    }
+
+private:
+    int scaled(int delayMs) const
+    {
+        return qMax(0, int(delayMs * delayScale));
+    }
+
+    void step()
+    {
+        if (done) {
+            return;
+        }
+        if (position < output.size()) {
+            const QByteArray chunk = output.mid(position, chunkSize);
+            position += chunk.size();
+            emit outputReady(chunk);
+            timer->start(scaled(chunkDelayMs));
+            return;
+        }
+        if (hang) {
+            return;
+        }
+        done = true;
+        if (!errorOutput.isEmpty()) {
+            emit errorOutputReady(errorOutput);
+        }
+        emit finished(exitCode, true);
+    }
+
+    QString directory;
+    double delayScale;
+    QTimer *timer;
+    QByteArray output;
+    QByteArray errorOutput;
+    qsizetype position = 0;
+    qsizetype chunkSize = 0;
+    int chunkDelayMs = 0;
+    int exitCode = 0;
+    bool hang = false;
+    bool done = false;
+};
+
+class RecordingProbeProcess : public ProbeProcess
+{
+public:
+    RecordingProbeProcess(ProbeProcess *inner, const QString &directory, QObject *parent)
+        : ProbeProcess(parent), inner(inner), directory(directory)
+    {
+        inner->setParent(this);
+        connect(inner, &ProbeProcess::started, this, &ProbeProcess::started);
+        connect(inner, &ProbeProcess::outputReady, this, [this](const QByteArray &chunk) {
+            recorded.append(chunk);
+            emit outputReady(chunk);
+        });
+        connect(inner, &ProbeProcess::errorOutputReady, this, [this](const QByteArray &chunk) {
+            recordedErrors.append(chunk);
+            emit errorOutputReady(chunk);
+        });
+        connect(inner, &ProbeProcess::finished, this, [this](int exitCode, bool normalExit) {
+            save(exitCode);
+            emit finished(exitCode, normalExit);
+        });
+        connect(inner, &ProbeProcess::failedToStart, this, &ProbeProcess::failedToStart);
+    }
+
+    void start(const QString &probeId, const QString &program, const QStringList &arguments) override
+    {
+        recordedProbeId = probeId;
+        inner->start(probeId, program, arguments);
+    }
+
+    void kill() override
+    {
+        inner->kill();
+    }
+
+private:
+    void save(int exitCode)
+    {
+        QSaveFile file(directory + "/" + recordedProbeId + ".stdout");
+        if (!file.open(QIODevice::WriteOnly)) {
+            qWarning() << "Cannot record probe output:" << file.fileName();
+            return;
+        }
+        file.write(recorded);
+        file.commit();
+
+        // Без stderr файла нет: иначе останется запись прошлого запуска
+        const QString errorPath = directory + "/" + recordedProbeId + ".stderr";
+        if (recordedErrors.isEmpty()) {
+            QFile::remove(errorPath);
+        } else {
+            QSaveFile errorFile(errorPath);
+            if (errorFile.open(QIODevice::WriteOnly)) {
+                errorFile.write(recordedErrors);
+                errorFile.commit();
+            } else {
+                qWarning() << "Cannot record probe error output:" << errorPath;
+            }
+        }
+
+        QJsonObject meta;
+        meta["exitCode"] = exitCode;
+        writeJsonObject(directory + "/" + recordedProbeId + ".json", meta);
+    }
+
+    ProbeProcess *inner;
+    QString directory;
+    QString recordedProbeId;
+    QByteArray recorded;
+    QByteArray recordedErrors;
+};
+
+} // namespace
+
+ProbeProcess *SystemCommandRunner::createProcess(QObject *parent) const
+{
+    return new QProcessProbeProcess(parent);
+}
+
+ReplayCommandRunner::ReplayCommandRunner(const QString &fixtureDirectory)
+    : directory(fixtureDirectory), delayScale(1.0)
+{
+}
+
+ProbeProcess *ReplayCommandRunner::createProcess(QObject *parent) const
+{
+    return new ReplayProbeProcess(directory, delayScale, parent);
+}
+
+MachineIdentity ReplayCommandRunner::machineIdentity() const
+{
+    const QJsonObject machine = readJsonObject(directory + "/machine.json");
+    MachineIdentity identity;
+    identity.serialNumber = machine.value("serialNumber").toString("REPLAY");
+    identity.model = machine.value("model").toString("replay");
+    return identity;
+}
+
+RecordingCommandRunner::RecordingCommandRunner(const QSharedPointer<CommandRunner> &inner,
+                                               const QString &fixtureDirectory)
+    : inner(inner), directory(fixtureDirectory)
+{
+    QDir().mkpath(directory);
+
+    const MachineIdentity identity = inner->machineIdentity();
+    QJsonObject machine;
+    machine["serialNumber"] = identity.serialNumber;
+    machine["model"] = identity.model;
+    writeJsonObject(directory + "/machine.json", machine);
+}
+
+ProbeProcess *RecordingCommandRunner::createProcess(QObject *parent) const
+{
+    return new RecordingProbeProcess(inner->createProcess(nullptr), directory, parent);
+}
+
+MachineIdentity RecordingCommandRunner::machineIdentity() const
+{
+    return inner->machineIdentity();
+}
@@ -0,0 +1,106 @@
+#ifndef COMMANDRUNNER_H
+#define COMMANDRUNNER_H
+
+#include <QByteArray>
+#include <QObject>
+#include <QSharedPointer>
+#include <QString>
+#include <QStringList>
+#include "machineidentity.h"
+
+class QProcess;
+class QTimer;
+
+// Один запуск команды проверки. Вывод приходит сигналом outputReady,
+// stderr — сигналом errorOutputReady; после finished (или failedToStart)
+// других сигналов не будет.
+class ProbeProcess : public QObject
+{
+    Q_OBJECT
+public:
+    using QObject::QObject;
+
+    virtual void start(const QString &probeId, const QString &program, const QStringList &arguments) = 0;
+    // Принудительное завершение вместе с дочерними процессами
+    virtual void kill() = 0;
+
+signals:
+    // Процесс запущен; для трассировки времени запуска
+    void started();
+    void outputReady(const QByteArray &chunk);
+    // stderr не разбирается: он нужен для журнала и сообщения об ошибке
+    void errorOutputReady(const QByteArray &chunk);
+    void finished(int exitCode, bool normalExit);
+    void failedToStart(const QString &error);
+};
+
+// Откуда DiagnosticManager берёт вывод команд: настоящие процессы или
+// записанные ранее ответы
+class CommandRunner
+{
+public:
+    virtual ~CommandRunner() = default;
+
+    virtual ProbeProcess *createProcess(QObject *parent) const = 0;
+
+    // false для воспроизведения записей: кэш и чтение IORegistry
+    // напрямую тогда не используются
+    virtual bool isLive() const { return true; }
+    // Можно ли проверкам читать данные внутри процесса (Probe::readNative)
+    // вместо запуска команды
+    virtual bool allowsNativeProbes() const { return isLive(); }
+    virtual MachineIdentity machineIdentity() const { return MachineIdentity::current(); }
+};
+
+// Запуск настоящих команд через QProcess
+class SystemCommandRunner : public CommandRunner
+{
+public:
+    ProbeProcess *createProcess(QObject *parent) const override;
+};
+
+// Воспроизведение записанного вывода из каталога. Для проверки с
+// идентификатором id используются файлы:
+//   id.stdout — стандартный вывод (обязателен),
+//   id.stderr — вывод ошибок (необязателен), отдаётся одной порцией
+//               после стандартного вывода, перед завершением,
+//   id.json   — необязательные параметры: exitCode, startDelayMs,
+//               chunkSize, chunkDelayMs, hang (не завершаться вовсе).
+// machine.json с полями serialNumber и model задаёт идентичность машины.
+class ReplayCommandRunner : public CommandRunner
+{
+public:
+    explicit ReplayCommandRunner(const QString &fixtureDirectory);
+
+    ProbeProcess *createProcess(QObject *parent) const override;
+    bool isLive() const override { return false; }
+    MachineIdentity machineIdentity() const override;
+
+    // Коэффициент для всех задержек: 0 — без задержек
+    void setDelayScale(double scale) { delayScale = scale; }
+
+private:
+    QString directory;
+    double delayScale;
+};
+
+// Записывает вывод вложенного запуска в каталог в формате ReplayCommandRunner.
+// stderr записывается, только если вложенный запуск его отдаёт:
+// SpawnCommandRunner направляет его в /dev/null
+class RecordingCommandRunner : public CommandRunner
+{
+public:
+    RecordingCommandRunner(const QSharedPointer<CommandRunner> &inner, const QString &fixtureDirectory);
+
+    ProbeProcess *createProcess(QObject *parent) const override;
+    bool isLive() const override { return inner->isLive(); }
+    // Записать можно только вывод настоящей команды
+    bool allowsNativeProbes() const override { return false; }
+    MachineIdentity machineIdentity() const override;
+
+private:
+    QSharedPointer<CommandRunner> inner;
+    QString directory;
+};
+
+#endif // COMMANDRUNNER_H
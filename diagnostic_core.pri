@@ -0,0 +1,52 @@
+# Ядро диагностики без зависимости от QtWidgets: используется и оконным
+# приложением, и консольной утилитой
+INCLUDEPATH += $$PWD
+
+include($$PWD/serialization.pri)
+
+# Локальный сокет резидентного агента
+QT += network
+
+SOURCES += \
+    $$PWD/diagnosticmanager.cpp \
+    $$PWD/commandrunner.cpp \
+    $$PWD/spawnrunner.cpp \
+    $$PWD/probe.cpp \
+    $$PWD/probeprofile.cpp \
+    $$PWD/probeparser.cpp \
+    $$PWD/structuredreader.cpp \
+    $$PWD/patternmatcher.cpp \
+    $$PWD/builtinprobes.cpp \
+    $$PWD/batteryregistry.cpp \
+    $$PWD/machineidentity.cpp \
+    $$PWD/proberesultcache.cpp \
+    $$PWD/runhistory.cpp \
+    $$PWD/headlessrunner.cpp \
+    $$PWD/fleetcontroller.cpp \
+    $$PWD/accountprovisioner.cpp \
+    $$PWD/agentprotocol.cpp \
+    $$PWD/agentclient.cpp \
+    $$PWD/diagnosticagent.cpp
+
+HEADERS += \
+    $$PWD/diagnosticmanager.h \
+    $$PWD/commandrunner.h \
+    $$PWD/spawnrunner.h \
+    $$PWD/probe.h \
+    $$PWD/probeprofile.h \
+    $$PWD/probeparser.h \
+    $$PWD/structuredreader.h \
+    $$PWD/patternmatcher.h \
+    $$PWD/builtinprobes.h \
+    $$PWD/batteryregistry.h \
+    $$PWD/machineidentity.h \
+    $$PWD/proberesultcache.h \
+    $$PWD/runhistory.h \
+    $$PWD/headlessrunner.h \
+    $$PWD/fleetcontroller.h \
+    $$PWD/accountprovisioner.h \
+    $$PWD/agentprotocol.h \
+    $$PWD/agentclient.h \
+    $$PWD/diagnosticagent.h
+
+macx: LIBS += -framework IOKit -framework CoreFoundation
@@ -0,0 +1,407 @@
+#include "diagnosticagent.h"
+#include "accountprovisioner.h"
+#include <QCoreApplication>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QTimer>
+
+#ifdef Q_OS_UNIX
+#include <grp.h>
+#include <pwd.h>
+#include <sys/types.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+#ifdef Q_OS_UNIX
+// Группа администраторов macOS: её участники могут подключаться к агенту
+// от root. Учётные записи для них создаются только через их собственный sudo
+const char AdminGroup[] = "admin";
+
+bool isAdmin(uid_t uid)
+{
+    const struct passwd *user = getpwuid(uid);
+    const struct group *admins = getgrnam(AdminGroup);
+    if (!user || !admins) {
+        return false;
+    }
+    if (user->pw_gid == admins->gr_gid) {
+        return true;
+    }
+    for (char **member = admins->gr_mem; member && *member; ++member) {
+        if (qstrcmp(*member, user->pw_name) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+#endif
+
+bool peerUser(uint uid, ProbeUser *user)
+{
+#ifdef Q_OS_UNIX
+    const struct passwd *entry = getpwuid(uid_t(uid));
+    if (!entry) {
+        qWarning() << "Unknown agent peer uid" << uid;
+        return false;
+    }
+    user->name = QString::fromLocal8Bit(entry->pw_name);
+    user->homePath = QString::fromLocal8Bit(entry->pw_dir);
+    return true;
+#else
+    Q_UNUSED(uid);
+    Q_UNUSED(user);
+    return false;
+#endif
+}
+
+bool runningAsRoot()
+{
+#ifdef Q_OS_UNIX
+    return geteuid() == 0;
+#else
+    return false;
+#endif
+}
+
+} // namespace
+
+DiagnosticAgent::DiagnosticAgent(QObject *parent)
+    : QObject(parent), server(new QLocalServer(this)), manager(new DiagnosticManager(this)),
+      provisioner(new AccountProvisioner(this)), profileSet(ProfileSet::builtin()),
+      diagnosticsRunning(false), provisioningRunning(false)
+{
+    connect(server, &QLocalServer::newConnection, this, &DiagnosticAgent::acceptConnections);
+
+    connect(manager, &DiagnosticManager::progressUpdated, this, [this](int, const QString &message) {
+        sendToDiagnosticSubscribers(AgentProtocol::Progress, AgentProtocol::encodeString(message));
+    });
+    connect(manager, &DiagnosticManager::probeFinished,
+            this, [this](const QString &description, bool success, int progress) {
+                sendToDiagnosticSubscribers(AgentProtocol::ProbeFinished,
+                                            AgentProtocol::encodeProbeFinished(description, success, progress));
+            });
+    connect(manager, &DiagnosticManager::diagnosticsFinished,
+            this, [this](bool success, const DiagnosticResults &results) {
+                sendToDiagnosticSubscribers(AgentProtocol::DiagnosticsFinished,
+                                            AgentProtocol::encodeDiagnosticsFinished(success, results));
+                if (!diagnosticJobs.isEmpty()) {
+                    diagnosticJobs.removeFirst();
+                }
+                diagnosticsRunning = false;
+                // Следующий запуск — после возврата из сигнала менеджера
+                QTimer::singleShot(0, this, &DiagnosticAgent::startNextDiagnostics);
+            });
+
+    connect(provisioner, &AccountProvisioner::accountFinished, this, [this](const AccountResult &result) {
+        if (!provisionJobs.isEmpty()) {
+            send(provisionJobs.first().subscriber, AgentProtocol::AccountFinished,
+                 AgentProtocol::encodeAccountResult(result));
+        }
+    });
+    connect(provisioner, &AccountProvisioner::finished, this, [this](bool success) {
+        if (!provisionJobs.isEmpty()) {
+            send(provisionJobs.takeFirst().subscriber, AgentProtocol::ProvisionFinished,
+                 AgentProtocol::encodeProvisionFinished(success, provisioner->results()));
+        }
+        provisioningRunning = false;
+        QTimer::singleShot(0, this, &DiagnosticAgent::startNextProvisioning);
+    });
+}
+
+DiagnosticAgent::~DiagnosticAgent()
+{
+    server->close();
+}
+
+bool DiagnosticAgent::listen(const QString &socketName, QString *error)
+{
+    // Сокет, оставшийся после аварийного завершения, мешает listen()
+    QLocalServer::removeServer(socketName);
+
+    // От root сокет открыт всем, а права проверяются по uid собеседника;
+    // иначе подключиться может только тот же пользователь
+    server->setSocketOptions(runningAsRoot() ? QLocalServer::WorldAccessOption
+                                             : QLocalServer::UserAccessOption);
+    if (!server->listen(socketName)) {
+        if (error) {
+            *error = server->errorString();
+        }
+        return false;
+    }
+    return true;
+}
+
+void DiagnosticAgent::acceptConnections()
+{
+    while (QLocalSocket *socket = server->nextPendingConnection()) {
+        uint uid = 0;
+        if (!authorized(socket, &uid)) {
+            send(Subscriber{socket, 0}, AgentProtocol::Error, AgentProtocol::encodeString("Доступ запрещён"));
+            socket->disconnectFromServer();
+            socket->deleteLater();
+            continue;
+        }
+
+        buffers.insert(socket, QByteArray());
+        peerUids.insert(socket, uid);
+        connect(socket, &QLocalSocket::readyRead, this, [this, socket]() { readFrames(socket); });
+        connect(socket, &QLocalSocket::disconnected, this, [this, socket]() {
+            buffers.remove(socket);
+            peerUids.remove(socket);
+            // Запросы отключившегося клиента больше некому получать
+            QList<quint32> requests;
+            for (const DiagnosticJob &job : diagnosticJobs) {
+                for (const Subscriber &subscriber : job.subscribers) {
+                    if (subscriber.socket == socket) {
+                        requests << subscriber.requestId;
+                    }
+                }
+            }
+            for (const ProvisionJob &job : provisionJobs) {
+                if (job.subscriber.socket == socket) {
+                    requests << job.subscriber.requestId;
+                }
+            }
+            for (quint32 requestId : requests) {
+                cancelRequest(socket, requestId);
+            }
+            socket->deleteLater();
+        });
+    }
+}
+
+bool DiagnosticAgent::authorized(QLocalSocket *socket, uint *uid) const
+{
+#ifdef Q_OS_UNIX
+    uint peer = 0;
+    if (!AgentProtocol::peerUid(socket->socketDescriptor(), &peer)) {
+        qWarning() << "Cannot read agent peer credentials";
+        return false;
+    }
+    *uid = peer;
+    return peer == geteuid() || peer == 0 || (runningAsRoot() && isAdmin(peer));
+#else
+    Q_UNUSED(socket);
+    *uid = 0;
+    return true;
+#endif
+}
+
+void DiagnosticAgent::readFrames(QLocalSocket *socket)
+{
+    auto it = buffers.find(socket);
+    if (it == buffers.end()) {
+        return;
+    }
+    it->append(socket->readAll());
+
+    AgentProtocol::Frame frame;
+    QString error;
+    while (AgentProtocol::decode(&buffers[socket], &frame, &error)) {
+        handleFrame(socket, frame);
+        if (!buffers.contains(socket)) {
+            return;
+        }
+    }
+    if (!error.isEmpty()) {
+        qWarning() << "Agent protocol error:" << error;
+        send(Subscriber{socket, 0}, AgentProtocol::Error, AgentProtocol::encodeString(error));
+        buffers.remove(socket);
+        socket->disconnectFromServer();
+    }
+}
+
+void DiagnosticAgent::handleFrame(QLocalSocket *socket, const AgentProtocol::Frame &frame)
+{
+    const Subscriber subscriber{socket, frame.requestId};
+    switch (frame.opcode) {
+        case AgentProtocol::Hello: {
+            AgentProtocol::HelloInfo hello;
+            if (!AgentProtocol::decodeHello(frame.payload, &hello) || hello.version != AgentProtocol::Version) {
+                send(subscriber, AgentProtocol::Error,
+                     AgentProtocol::encodeString("Несовместимая версия протокола"));
+                return;
+            }
+            AgentProtocol::HelloInfo welcome;
+            welcome.pid = QCoreApplication::applicationPid();
+            welcome.privileged = runningAsRoot();
+            send(subscriber, AgentProtocol::Welcome, AgentProtocol::encodeHello(welcome));
+            return;
+        }
+        case AgentProtocol::RunDiagnostics: {
+            AgentProtocol::DiagnosticRequest request;
+            if (!AgentProtocol::decodeDiagnosticRequest(frame.payload, &request)) {
+                break;
+            }
+            queueDiagnostics(subscriber, request);
+            return;
+        }
+        case AgentProtocol::ProvisionAccounts: {
+            AgentProtocol::ProvisionRequest request;
+            if (!AgentProtocol::decodeProvisionRequest(frame.payload, &request)) {
+                break;
+            }
+            queueProvisioning(subscriber, request);
+            return;
+        }
+        case AgentProtocol::Cancel:
+            cancelRequest(socket, frame.requestId);
+            return;
+        default:
+            send(subscriber, AgentProtocol::Error,
+                 AgentProtocol::encodeString(QString("Неизвестная операция %1").arg(frame.opcode)));
+            return;
+    }
+    send(subscriber, AgentProtocol::Error, AgentProtocol::encodeString("Повреждённый запрос"));
+}
+
+void DiagnosticAgent::queueDiagnostics(const Subscriber &subscriber, const AgentProtocol::DiagnosticRequest &request)
+{
+    if (!request.profile.isEmpty() && !profileSet.contains(request.profile)) {
+        send(subscriber, AgentProtocol::Error,
+             AgentProtocol::encodeString("Неизвестный профиль: " + request.profile));
+        return;
+    }
+
+    // Такой же запрос того же пользователя уже выполняется или ждёт: его
+    // результат подойдёт и этому клиенту
+    const uint uid = peerUids.value(subscriber.socket);
+    for (DiagnosticJob &job : diagnosticJobs) {
+        if (job.request == request && job.peerUid == uid) {
+            job.subscribers << subscriber;
+            return;
+        }
+    }
+
+    DiagnosticJob job;
+    job.request = request;
+    job.peerUid = uid;
+    job.subscribers << subscriber;
+    diagnosticJobs << job;
+    startNextDiagnostics();
+}
+
+void DiagnosticAgent::startNextDiagnostics()
+{
+    if (diagnosticsRunning || diagnosticJobs.isEmpty()) {
+        return;
+    }
+
+    const DiagnosticJob &job = diagnosticJobs.first();
+    const AgentProtocol::DiagnosticRequest &request = job.request;
+    ProbeProfile profile = profileSet.profile(request.profile);
+    if (request.deepDisk && profile.probes.contains("disk")) {
+        profile.deepDisk = true;
+    }
+
+    // Агент от root иначе прочитал бы настройки /var/root, а не клиента
+    ProbeUser user;
+    if (runningAsRoot() && job.peerUid != 0) {
+        peerUser(job.peerUid, &user);
+    }
+
+    diagnosticsRunning = true;
+    manager->setProbeRegistry(profile.createRegistry(user));
+    manager->setForceRefresh(request.refresh);
+    manager->setForwardProbeOutput(request.forwardOutput);
+    if (request.incremental) {
+        manager->rerunChangedProbes();
+    } else {
+        manager->runDiagnostics();
+    }
+}
+
+void DiagnosticAgent::queueProvisioning(const Subscriber &subscriber, const AgentProtocol::ProvisionRequest &request)
+{
+    ProvisionJob job;
+    job.request = request;
+    job.subscriber = subscriber;
+    job.peerUid = peerUids.value(subscriber.socket);
+    provisionJobs << job;
+    startNextProvisioning();
+}
+
+void DiagnosticAgent::startNextProvisioning()
+{
+    if (provisioningRunning || provisionJobs.isEmpty()) {
+        return;
+    }
+
+    const ProvisionJob &job = provisionJobs.first();
+    if (runningAsRoot()) {
+        // Права root агента не передаются клиенту: пароль администратора
+        // не нужен только самому root
+        ProbeUser user;
+        if (job.peerUid != 0 && !peerUser(job.peerUid, &user)) {
+            send(provisionJobs.takeFirst().subscriber, AgentProtocol::Error,
+                 AgentProtocol::encodeString("Неизвестный пользователь"));
+            QTimer::singleShot(0, this, &DiagnosticAgent::startNextProvisioning);
+            return;
+        }
+        provisioner->setUseSudo(job.peerUid != 0);
+        provisioner->setAuthenticateAs(user.name);
+    }
+
+    provisioningRunning = true;
+    provisioner->provision(job.request.accounts, job.request.sudoPassword);
+}
+
+void DiagnosticAgent::cancelRequest(QLocalSocket *socket, quint32 requestId)
+{
+    for (int i = 0; i < diagnosticJobs.size(); ++i) {
+        QList<Subscriber> &subscribers = diagnosticJobs[i].subscribers;
+        const qsizetype removed = subscribers.removeIf([socket, requestId](const Subscriber &subscriber) {
+            return subscriber.socket == socket && subscriber.requestId == requestId;
+        });
+        if (removed == 0) {
+            continue;
+        }
+        if (!subscribers.isEmpty()) {
+            return;
+        }
+        if (i == 0 && diagnosticsRunning) {
+            // Итог отмены уходит в diagnosticsFinished и снимает задачу
+            manager->cancel();
+            return;
+        }
+        diagnosticJobs.removeAt(i);
+        return;
+    }
+
+    for (int i = 0; i < provisionJobs.size(); ++i) {
+        const Subscriber &subscriber = provisionJobs.at(i).subscriber;
+        if (subscriber.socket != socket || subscriber.requestId != requestId) {
+            continue;
+        }
+        if (i == 0 && provisioningRunning) {
+            provisioner->cancel();
+        } else {
+            provisionJobs.removeAt(i);
+        }
+        return;
+    }
+}
+
+void DiagnosticAgent::send(const Subscriber &subscriber, quint8 opcode, const QByteArray &payload)
+{
+    if (!subscriber.socket || subscriber.socket->state() != QLocalSocket::ConnectedState) {
+        return;
+    }
+    AgentProtocol::Frame frame;
+    frame.opcode = opcode;
+    frame.requestId = subscriber.requestId;
+    frame.payload = payload;
+    subscriber.socket->write(AgentProtocol::encode(frame));
+}
+
+void DiagnosticAgent::sendToDiagnosticSubscribers(quint8 opcode, const QByteArray &payload)
+{
+    if (diagnosticJobs.isEmpty()) {
+        return;
+    }
+    for (const Subscriber &subscriber : diagnosticJobs.first().subscribers) {
+        send(subscriber, opcode, payload);
+    }
+}
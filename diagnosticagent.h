@@ -0,0 +1,83 @@
+#ifndef DIAGNOSTICAGENT_H
+#define DIAGNOSTICAGENT_H
+
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QPointer>
+#include "agentprotocol.h"
+#include "diagnosticmanager.h"
+#include "probeprofile.h"
+
+class AccountProvisioner;
+class QLocalServer;
+class QLocalSocket;
+
+// Резидентный агент: один DiagnosticManager с прогретым кэшем проверок,
+// прошлым выводом для повторных проверок и идентификацией машины, профили,
+// загруженные один раз, и создание учётных записей. Агент от root создаёт
+// записи без sudo только по запросу root; запрос другого пользователя
+// проходит через sudo от его имени с его паролем. Запросы приходят через локальный сокет
+// (AgentProtocol). Диагностика и создание записей выполняются по одной;
+// остальные запросы ждут в очереди, а одинаковый запрос диагностики
+// присоединяется к уже идущему.
+class DiagnosticAgent : public QObject
+{
+    Q_OBJECT
+public:
+    explicit DiagnosticAgent(QObject *parent = nullptr);
+    ~DiagnosticAgent() override;
+
+    void setProfiles(const ProfileSet &profiles) { profileSet = profiles; }
+    DiagnosticManager *diagnosticManager() const { return manager; }
+
+    bool listen(const QString &socketName, QString *error = nullptr);
+
+private:
+    struct Subscriber {
+        QPointer<QLocalSocket> socket;
+        quint32 requestId = 0;
+    };
+
+    struct DiagnosticJob {
+        AgentProtocol::DiagnosticRequest request;
+        // Чьи настройки читают проверки пользователя (Apple ID)
+        uint peerUid = 0;
+        QList<Subscriber> subscribers;
+    };
+
+    struct ProvisionJob {
+        AgentProtocol::ProvisionRequest request;
+        Subscriber subscriber;
+        // uid клиента, от имени которого проверяется пароль
+        uint peerUid = 0;
+    };
+
+    void acceptConnections();
+    void readFrames(QLocalSocket *socket);
+    void handleFrame(QLocalSocket *socket, const AgentProtocol::Frame &frame);
+    bool authorized(QLocalSocket *socket, uint *uid) const;
+
+    void queueDiagnostics(const Subscriber &subscriber, const AgentProtocol::DiagnosticRequest &request);
+    void startNextDiagnostics();
+    void queueProvisioning(const Subscriber &subscriber, const AgentProtocol::ProvisionRequest &request);
+    void startNextProvisioning();
+    void cancelRequest(QLocalSocket *socket, quint32 requestId);
+
+    void send(const Subscriber &subscriber, quint8 opcode, const QByteArray &payload);
+    void sendToDiagnosticSubscribers(quint8 opcode, const QByteArray &payload);
+
+    QLocalServer *server;
+    DiagnosticManager *manager;
+    AccountProvisioner *provisioner;
+    ProfileSet profileSet;
+    QHash<QLocalSocket *, QByteArray> buffers;
+    QHash<QLocalSocket *, uint> peerUids;
+    // Первый элемент — выполняющийся запрос
+    QList<DiagnosticJob> diagnosticJobs;
+    QList<ProvisionJob> provisionJobs;
+    bool diagnosticsRunning;
+    bool provisioningRunning;
+};
+
+#endif // DIAGNOSTICAGENT_H
@@ -1,222 +1,478 @@
 #include "diagnosticmanager.h"
+#include "machineidentity.h"
 #include <QDebug>
-#include <QRegularExpression>
-
-DiagnosticManager::DiagnosticManager(QObject *parent) 
-    : QObject(parent), process(new QProcess(this)), currentStep(0), 
-      currentProgress(0), overallSuccess(true)
-{
-    connect(process, &QProcess::readyReadStandardOutput,
-            this, [this]() {
-                QString output = process->readAllStandardOutput();
-                emit progressUpdated(currentProgress, output);
-                
-                switch (currentStep) {
-                    case 0: // Battery
-                        parseBatteryInfo(output);
-                        break;
-                    case 1: // Disk
-                        parseDiskInfo(output);
-                        break;
-                    case 2: // Apple ID
-                        parseAppleIDInfo(output);
-                        break;
-                }
-            });
+#include <QThread>
 
-    connect(process, &QProcess::finished,
-            this, [this](int exitCode, QProcess::ExitStatus exitStatus) {
-                if (exitCode != 0 || exitStatus != QProcess::NormalExit) {
-                    overallSuccess = false;
-                }
-                currentProgress += 25;
-                
-                switch (currentStep) {
-                    case 0:
-                        QTimer::singleShot(0, this, &DiagnosticManager::checkDiskHealth);
-                        break;
-                    case 1:
-                        QTimer::singleShot(0, this, &DiagnosticManager::checkAppleID);
-                        break;
-                    case 2:
-                        QTimer::singleShot(0, this, &DiagnosticManager::checkSystemIntegrity);
-                        break;
-                    case 3:
-                        // Добавляем рекомендации перед завершением
-                        if (results.hasAppleID) {
-                            results.recommendations.append("Выйдите из Apple ID перед передачей устройства");
-                        }
-                        if (results.maxCapacity < 80) {
-                            results.recommendations.append("Рекомендуется заменить батарею (ёмкость менее 80%)");
-                        }
-                        emit diagnosticsFinished(overallSuccess, results);
-                        break;
-                }
-                currentStep++;
-            });
+namespace {
+// Как часто сторож проверяет сроки выполнения проверок
+const int WatchdogIntervalMs = 500;
+// Столько байт stderr хватает для сообщения об ошибке команды
+const int MaxErrorOutput = 4096;
+
+QString lastLine(const QByteArray &output)
+{
+    const QStringList lines = QString::fromUtf8(output).trimmed().split('\n');
+    return lines.isEmpty() ? QString() : lines.last().trimmed();
+}
+}
+
+DiagnosticManager::DiagnosticManager(QObject *parent)
+    : QObject(parent), registry(ProbeRegistry::defaultRegistry()),
+      runner(new SystemCommandRunner),
+      watchdog(new QTimer(this)), refreshCache(false), forwardOutput(false),
+      incrementalRun(false), maxConcurrent(qMax(2, QThread::idealThreadCount())),
+      totalProbes(0), currentProgress(0), overallSuccess(true), running(false)
+{
+    watchdog->setInterval(WatchdogIntervalMs);
+    connect(watchdog, &QTimer::timeout, this, &DiagnosticManager::checkDeadlines);
+}
+
+void DiagnosticManager::setProbeRegistry(const ProbeRegistry &newRegistry)
+{
+    registry = newRegistry;
+}
+
+void DiagnosticManager::setCommandRunner(const QSharedPointer<CommandRunner> &newRunner)
+{
+    if (newRunner) {
+        runner = newRunner;
+    }
+}
+
+void DiagnosticManager::setForceRefresh(bool force)
+{
+    refreshCache = force;
+}
+
+void DiagnosticManager::setForwardProbeOutput(bool forward)
+{
+    forwardOutput = forward;
+}
+
+void DiagnosticManager::setMaxConcurrentProbes(int count)
+{
+    maxConcurrent = qMax(1, count);
 }
 
 void DiagnosticManager::runDiagnostics()
 {
-    currentStep = 0;
+    startRun(false);
+}
+
+void DiagnosticManager::rerunChangedProbes()
+{
+    startRun(true);
+}
+
+void DiagnosticManager::startRun(bool incremental)
+{
+    // Прерываем предыдущий запуск, если он ещё не закончился
+    stopRunningProbes();
+    completedProbes.clear();
+    running = true;
+    incrementalRun = incremental;
+
+    pendingProbes = registry.probes();
+    totalProbes = pendingProbes.size();
     currentProgress = 0;
     overallSuccess = true;
     results = DiagnosticResults();
+    results.profile = registry.name();
+    for (const QSharedPointer<Probe> &probe : pendingProbes) {
+        results.probes << probe->id();
+    }
+    runClock.start();
+
+    const MachineIdentity identity = runner->machineIdentity();
+    results.machineSerial = identity.serialNumber;
+    results.machineModel = identity.model;
+    if (lastOutputsSerial != identity.serialNumber || !runner->isLive()) {
+        // Прошлый вывод относится к другой машине или к записи
+        lastOutputs.clear();
+        lastOutputsSerial = identity.serialNumber;
+    }
+
+    // Зависимость от незарегистрированной проверки никогда не будет выполнена
+    for (const QSharedPointer<Probe> &probe : pendingProbes) {
+        for (const QString &dependency : probe->dependencies()) {
+            if (!registry.contains(dependency)) {
+                qWarning() << "Probe" << probe->id() << "depends on unknown probe" << dependency;
+            }
+        }
+    }
 
-    QTimer::singleShot(0, this, &DiagnosticManager::checkBattery);
+    QTimer::singleShot(0, this, &DiagnosticManager::startPendingProbes);
 }
 
-void DiagnosticManager::checkBattery()
+void DiagnosticManager::cancel()
 {
-    executeSystemCommand(
-        "/usr/sbin/system_profiler",
-        QStringList() << "SPPowerDataType",
-        " Проверка состояния батареи..."
-    );
+    if (!running) {
+        return;
+    }
+
+    for (const RunningProbe &probe : runningProbes) {
+        markIncomplete(probe.probe);
+        finishTiming(probe.timing, "cancelled");
+    }
+    for (const QSharedPointer<Probe> &probe : pendingProbes) {
+        markIncomplete(probe);
+    }
+    stopRunningProbes();
+    pendingProbes.clear();
+
+    overallSuccess = false;
+    emit progressUpdated(currentProgress, " Диагностика отменена");
+    checkSystemIntegrity();
+}
+
+void DiagnosticManager::stopRunningProbes()
+{
+    watchdog->stop();
+    for (auto it = runningProbes.constBegin(); it != runningProbes.constEnd(); ++it) {
+        ProbeProcess *probeProcess = it.key();
+        probeProcess->disconnect(this);
+        probeProcess->kill();
+        probeProcess->deleteLater();
+    }
+    runningProbes.clear();
 }
 
-void DiagnosticManager::checkDiskHealth()
+void DiagnosticManager::markIncomplete(const QSharedPointer<Probe> &probe)
 {
-    executeSystemCommand(
-        "diskutil verifyVolume /",
-        " Проверка состояния дисков..."
-    );
+    if (!results.incompleteProbes.contains(probe->id())) {
+        results.incompleteProbes.append(probe->id());
+    }
+    probe->abort(results);
 }
 
-void DiagnosticManager::checkAppleID()
+void DiagnosticManager::checkDeadlines()
 {
-    executeSystemCommand(
-        "defaults read MobileMeAccounts",
-        " Проверка статуса Apple ID..."
-    );
+    for (auto it = runningProbes.begin(); it != runningProbes.end(); ++it) {
+        if (it->timedOut || !it->deadline.hasExpired()) {
+            continue;
+        }
+        it->timedOut = true;
+        emit progressUpdated(currentProgress,
+                             " Превышено время ожидания: " + it->probe->description().trimmed());
+        // finished придёт после завершения процесса и закроет проверку
+        it.key()->kill();
+    }
 }
 
 void DiagnosticManager::checkSystemIntegrity()
 {
-    results.diskCheckPassed = overallSuccess;
+    running = false;
+    watchdog->stop();
+    results.finishedAt = QDateTime::currentDateTimeUtc();
+    emit progressUpdated(100, " Диагностика завершена");
     emit diagnosticsFinished(overallSuccess, results);
 }
 
-void DiagnosticManager::executeSystemCommand(const QString &command, const QStringList &args, const QString &description)
+bool DiagnosticManager::dependenciesSatisfied(const QSharedPointer<Probe> &probe) const
 {
-    emit progressUpdated(currentProgress, description);
-    qDebug() << "Executing command:" << command << args.join(" ");
-    
-    process->start(command, args);
-    if (!process->waitForStarted()) {
-        emit progressUpdated(currentProgress, " Ошибка запуска команды: " + command);
-        overallSuccess = false;
-        emit diagnosticsFinished(false, results);
+    for (const QString &dependency : probe->dependencies()) {
+        if (!completedProbes.contains(dependency)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void DiagnosticManager::startPendingProbes()
+{
+    // Запуск из очереди событий после cancel(): итог уже отправлен
+    if (!running) {
         return;
     }
+
+    // Проверка из кэша завершается сразу и может открыть путь зависимым,
+    // поэтому проходим очередь, пока что-то запускается
+    bool started = true;
+    while (started && runningProbes.size() < maxConcurrent) {
+        started = false;
+        for (int i = 0; i < pendingProbes.size() && runningProbes.size() < maxConcurrent; ) {
+            if (dependenciesSatisfied(pendingProbes.at(i))) {
+                executeSystemCommand(pendingProbes.takeAt(i));
+                started = true;
+            } else {
+                ++i;
+            }
+        }
+    }
+
+    if (!runningProbes.isEmpty()) {
+        return;
+    }
+
+    // Ничего не выполняется, а оставшиеся проверки ждут друг друга или
+    // неизвестные проверки: запускать их бессмысленно
+    for (const QSharedPointer<Probe> &probe : pendingProbes) {
+        emit progressUpdated(currentProgress, " Неразрешимые зависимости у проверки: " + probe->id());
+        overallSuccess = false;
+    }
+    pendingProbes.clear();
+
+    checkSystemIntegrity();
 }
 
-void DiagnosticManager::executeSystemCommand(const QString &command, const QString &description)
+void DiagnosticManager::handleProbeOutput(ProbeProcess *probeProcess, const QByteArray &chunk)
 {
-    QStringList args = command.split(' ');
-    QString program = args.takeFirst();
-    
-    executeSystemCommand(program, args, description);
+    auto it = runningProbes.find(probeProcess);
+    if (it == runningProbes.end()) {
+        return;
+    }
+
+    if (forwardOutput) {
+        emit progressUpdated(currentProgress, QString::fromUtf8(chunk));
+    }
+    if (it->cacheOutput || !it->fingerprint.isEmpty()) {
+        it->output.append(chunk);
+    }
+
+    if (it->timing.firstByteUs < 0) {
+        it->timing.firstByteUs = runMicros() - it->timing.startUs;
+    }
+    it->timing.bytesRead += chunk.size();
+
+    QElapsedTimer parseTimer;
+    parseTimer.start();
+    it->parser->consume(chunk, results);
+    it->parseNs += parseTimer.nsecsElapsed();
 }
 
-void DiagnosticManager::parseBatteryInfo(const QString &output)
+void DiagnosticManager::handleProbeErrorOutput(ProbeProcess *probeProcess, const QByteArray &chunk)
 {
-    // Ищем цикл зарядки
-    QRegularExpression cycleCountRegex("Cycle Count:\\s*(\\d+)");
-    auto cycleMatch = cycleCountRegex.match(output);
-    if (cycleMatch.hasMatch()) {
-        results.cycleCounts = cycleMatch.captured(1).toInt();
+    auto it = runningProbes.find(probeProcess);
+    if (it == runningProbes.end()) {
+        return;
     }
-    
-    // Ищем максимальную ёмкость, просто находя нужную строку
-    QStringList lines = output.split('\n');
-    for (const QString &line : lines) {
-        if (line.contains("Maximum Capacity:")) {
-            // Извлекаем число перед символом %
-            QString trimmed = line.trimmed();
-            int percentIndex = trimmed.indexOf('%');
-            if (percentIndex > 0) {
-                QString numberStr = trimmed.mid(trimmed.lastIndexOf(' '), percentIndex - trimmed.lastIndexOf(' ')).trimmed();
-                results.maxCapacity = numberStr.toInt();
-                break;
-            }
-        }
+
+    if (forwardOutput) {
+        emit progressUpdated(currentProgress, QString::fromUtf8(chunk));
+    }
+    it->errorOutput.append(chunk);
+    if (it->errorOutput.size() > MaxErrorOutput) {
+        it->errorOutput = it->errorOutput.right(MaxErrorOutput);
     }
 }
 
-void DiagnosticManager::parseAppleIDInfo(const QString &output)
-{
-    qDebug() << "\n=== Parsing Apple ID Info ===";
-    qDebug() << "Raw output:";
-    qDebug() << output;
-    
-    if (output.contains("AccountID") || output.contains("AppleID")) {
-        results.hasAppleID = true;
-        
-        // Пытаемся найти email
-        QRegularExpression emailRegex("AccountID\\s*=\\s*\"([^\"]+)\"");
-        auto match = emailRegex.match(output);
-        if (match.hasMatch()) {
-            results.appleIDEmail = match.captured(1);
-            qDebug() << "Found Apple ID:" << results.appleIDEmail;
-        } else {
-            results.appleIDEmail = "Найден (email скрыт)";
-            qDebug() << "Apple ID found but hidden";
-        }
-        
-        // Проверяем статус Find My Mac
-        QStringList lines = output.split('\n');
-        bool isFindMyMacSection = false;
-        bool enabled = false;
-        
-        qDebug() << "\nSearching for Find My Mac status:";
-        for (const QString &line : lines) {
-            QString trimmedLine = line.trimmed();
-            qDebug() << "Checking line:" << trimmedLine;
-            
-            // Если нашли начало новой секции, сбрасываем флаг
-            if (trimmedLine.startsWith("{")) {
-                isFindMyMacSection = false;
-            }
-            
-            // Проверяем, является ли это секцией Find My Mac
-            if (trimmedLine.contains("Name = \"FIND_MY_MAC\"")) {
-                qDebug() << "Found Find My Mac section";
-                isFindMyMacSection = true;
-            }
-            
-            // Если мы в секции Find My Mac и нашли Enabled
-            if (isFindMyMacSection && trimmedLine.contains("Enabled =")) {
-                enabled = trimmedLine.contains("Enabled = 1");
-                qDebug() << "Found Enabled status:" << enabled;
-            }
-        }
-        
-        results.findMyMacEnabled = enabled;
-        qDebug() << "Final Find My Mac status:" << results.findMyMacEnabled;
-        
+void DiagnosticManager::handleProbeFinished(ProbeProcess *probeProcess, int exitCode, const QString &status)
+{
+    if (!runningProbes.contains(probeProcess)) {
+        return;
+    }
+
+    RunningProbe finished = runningProbes.take(probeProcess);
+    const QSharedPointer<Probe> probe = finished.probe;
+    probeProcess->deleteLater();
+
+    bool success = status == "ok";
+    finished.timing.exitCode = exitCode;
+    if (!success && !finished.errorOutput.isEmpty()) {
+        emit progressUpdated(currentProgress, QString(" Ошибка команды %1: %2")
+                                                  .arg(probe->program(), lastLine(finished.errorOutput)));
+    }
+    if (finished.timedOut) {
+        // Вывод оборван: частичные данные не выдаём за результат
+        success = false;
+        markIncomplete(probe);
+        finishTiming(finished.timing, "timeout");
     } else {
-        results.hasAppleID = false;
-        results.findMyMacEnabled = false;
-        qDebug() << "No Apple ID found";
-    }
-    
-    qDebug() << "\nFinal results:";
-    qDebug() << "Has Apple ID:" << results.hasAppleID;
-    qDebug() << "Apple ID Email:" << results.appleIDEmail;
-    qDebug() << "Find My Mac Enabled:" << results.findMyMacEnabled;
-    qDebug() << "=========================\n";
-}
-
-void DiagnosticManager::parseDiskInfo(const QString &output)
-{
-    results.diskCheckPassed = output.contains("appears to be OK") || 
-                             output.contains("No problems found");
-    
-    if (!results.diskCheckPassed) {
-        results.diskStatus = output.split("\n").filter("Error").join(", ");
-        if (results.diskStatus.isEmpty()) {
-            results.diskStatus = "Неизвестная ошибка";
+        QElapsedTimer parseTimer;
+        parseTimer.start();
+        finished.parser->finish(results);
+        finished.timing.parseUs = (finished.parseNs + parseTimer.nsecsElapsed()) / 1000;
+        finishTiming(finished.timing, status);
+
+        probe->finish(success, results);
+        if (success && finished.cacheOutput) {
+            cache.store(*probe, results.machineSerial, finished.output, finished.fingerprint);
         }
     }
+
+    if (success) {
+        rememberOutput(probe, finished.fingerprint, finished.output);
+    } else {
+        lastOutputs.remove(probe->id());
+    }
+
+    completeProbe(probe, success);
+    startPendingProbes();
+}
+
+void DiagnosticManager::completeProbe(const QSharedPointer<Probe> &probe, bool success)
+{
+    if (!success) {
+        overallSuccess = false;
+    }
+    completedProbes.insert(probe->id());
+
+    currentProgress = totalProbes > 0 ? completedProbes.size() * 100 / totalProbes : 100;
+    emit probeFinished(probe->description().trimmed(), success, currentProgress);
+}
+
+qint64 DiagnosticManager::runMicros() const
+{
+    return runClock.nsecsElapsed() / 1000;
+}
+
+ProbeTiming DiagnosticManager::beginTiming(const QSharedPointer<Probe> &probe, const QString &source) const
+{
+    ProbeTiming timing;
+    timing.probeId = probe->id();
+    timing.source = source;
+    timing.startUs = runMicros();
+    return timing;
+}
+
+void DiagnosticManager::finishTiming(ProbeTiming timing, const QString &status)
+{
+    timing.totalUs = runMicros() - timing.startUs;
+    timing.status = status;
+    results.timings.append(timing);
+}
+
+qint64 DiagnosticManager::applyOutput(const QSharedPointer<Probe> &probe, const QByteArray &output)
+{
+    QElapsedTimer parseTimer;
+    parseTimer.start();
+    const QSharedPointer<ProbeParser> parser = probe->createParser();
+    parser->consume(output, results);
+    parser->finish(results);
+    const qint64 parseUs = parseTimer.nsecsElapsed() / 1000;
+
+    probe->finish(true, results);
+    return parseUs;
+}
+
+bool DiagnosticManager::applyCachedResult(const QSharedPointer<Probe> &probe)
+{
+    ProbeTiming timing = beginTiming(probe, "cache");
+    QByteArray output;
+    QByteArray fingerprint;
+    if (refreshCache || !runner->isLive() || !cache.lookup(*probe, results.machineSerial, &output, &fingerprint)) {
+        return false;
+    }
+
+    // В кэш попадает только вывод успешных запусков
+    timing.bytesRead = output.size();
+    timing.parseUs = applyOutput(probe, output);
+    finishTiming(timing, "ok");
+    // Отпечаток того запуска, что дал вывод: текущий мог измениться за
+    // время хранения, и старый вывод не должен сойти за «без изменений»
+    rememberOutput(probe, fingerprint, output);
+
+    emit progressUpdated(currentProgress, probe->description() + " (из кэша)");
+    completeProbe(probe, true);
+    return true;
+}
+
+void DiagnosticManager::rememberOutput(const QSharedPointer<Probe> &probe, const QByteArray &fingerprint,
+                                       const QByteArray &output)
+{
+    if (fingerprint.isEmpty()) {
+        lastOutputs.remove(probe->id());
+        return;
+    }
+    StoredOutput stored;
+    stored.fingerprint = fingerprint;
+    stored.output = output;
+    lastOutputs.insert(probe->id(), stored);
+}
+
+bool DiagnosticManager::applyUnchangedResult(const QSharedPointer<Probe> &probe)
+{
+    if (!incrementalRun || !runner->isLive()) {
+        return false;
+    }
+    ProbeTiming timing = beginTiming(probe, "unchanged");
+    const auto stored = lastOutputs.constFind(probe->id());
+    if (stored == lastOutputs.constEnd() || stored->fingerprint != probe->fingerprint()) {
+        return false;
+    }
+
+    timing.bytesRead = stored->output.size();
+    timing.parseUs = applyOutput(probe, stored->output);
+    finishTiming(timing, "ok");
+
+    emit progressUpdated(currentProgress, probe->description() + " (без изменений)");
+    completeProbe(probe, true);
+    return true;
+}
+
+bool DiagnosticManager::applyNativeResult(const QSharedPointer<Probe> &probe)
+{
+    ProbeTiming timing = beginTiming(probe, "native");
+    QByteArray output;
+    if (!runner->allowsNativeProbes() || !probe->readNative(&output)) {
+        return false;
+    }
+
+    emit progressUpdated(currentProgress, probe->description());
+    timing.bytesRead = output.size();
+    timing.parseUs = applyOutput(probe, output);
+    finishTiming(timing, "ok");
+    completeProbe(probe, true);
+    return true;
+}
+
+void DiagnosticManager::executeSystemCommand(const QSharedPointer<Probe> &probe)
+{
+    if (!probe->shouldRun(results)) {
+        finishTiming(beginTiming(probe, "skipped"), "ok");
+        emit progressUpdated(currentProgress, probe->description() + " (не требуется)");
+        completeProbe(probe, true);
+        return;
+    }
+    if (applyUnchangedResult(probe) || applyCachedResult(probe) || applyNativeResult(probe)) {
+        return;
+    }
+
+    emit progressUpdated(currentProgress, probe->description());
+    qDebug() << "Executing command:" << probe->program() << probe->arguments().join(" ");
+
+    // У каждой проверки свой процесс, чтобы они не ждали друг друга
+    ProbeProcess *probeProcess = runner->createProcess(this);
+    RunningProbe runningProbe;
+    runningProbe.probe = probe;
+    runningProbe.parser = probe->createParser();
+    runningProbe.deadline = QDeadlineTimer(probe->timeoutMs());
+    runningProbe.cacheOutput = runner->isLive() && cache.ttlFor(*probe) > 0;
+    // Отпечаток снимается до запуска: изменения во время проверки попадут
+    // в следующий запуск
+    runningProbe.fingerprint = runner->isLive() ? probe->fingerprint() : QByteArray();
+    runningProbe.timing = beginTiming(probe, "process");
+    runningProbes.insert(probeProcess, runningProbe);
+    if (!watchdog->isActive()) {
+        watchdog->start();
+    }
+
+    connect(probeProcess, &ProbeProcess::started, this, [this, probeProcess]() {
+        auto it = runningProbes.find(probeProcess);
+        if (it != runningProbes.end()) {
+            it->timing.spawnUs = runMicros() - it->timing.startUs;
+        }
+    });
+
+    connect(probeProcess, &ProbeProcess::outputReady,
+            this, [this, probeProcess](const QByteArray &chunk) { handleProbeOutput(probeProcess, chunk); });
+
+    connect(probeProcess, &ProbeProcess::errorOutputReady,
+            this, [this, probeProcess](const QByteArray &chunk) { handleProbeErrorOutput(probeProcess, chunk); });
+
+    connect(probeProcess, &ProbeProcess::finished,
+            this, [this, probeProcess](int exitCode, bool normalExit) {
+                const QString status = !normalExit ? QString("crashed")
+                                     : exitCode == 0 ? QString("ok")
+                                                     : QString("exit:%1").arg(exitCode);
+                handleProbeFinished(probeProcess, exitCode, status);
+            });
+
+    connect(probeProcess, &ProbeProcess::failedToStart,
+            this, [this, probeProcess, probe](const QString &error) {
+                emit progressUpdated(currentProgress, " Ошибка запуска команды: " + probe->program() + " (" + error + ")");
+                handleProbeFinished(probeProcess, -1, "failed-to-start");
+            });
+
+    probeProcess->start(probe->id(), probe->program(), probe->arguments());
 }
@@ -2,70 +2,17 @@
 #define DIAGNOSTICMANAGER_H
 
 #include <QObject>
-#include <QProcess>
 #include <QTimer>
 #include <QDebug>
-
-struct DiagnosticResults {
-    // Результаты батареи
-    int cycleCounts = 0;
-    int maxCapacity = 0;
-    
-    // Результаты Apple ID
-    bool hasAppleID = false;
-    QString appleIDEmail;
-    
-    // Find My Mac
-    bool findMyMacEnabled = false;
-    
-    // Результаты проверки диска
-    bool diskCheckPassed = false;
-    QString diskStatus;
-    
-    // Список рекомендаций
-    QStringList recommendations;
-    
-    QString toString() const {
-        QString result = "📊 Итоги диагностики:\n\n";
-        QStringList allRecommendations = recommendations;
-        
-        // Батарея
-        result += "🔋 Батарея:\n";
-        result += QString("   • Циклы заряда: %1\n").arg(cycleCounts);
-        result += QString("   • Максимальная ёмкость: %1%\n\n").arg(maxCapacity);
-        
-        // Apple ID
-        result += "🍎 Apple ID:\n";
-        if (hasAppleID) {
-            result += QString("   • Аккаунт: %1\n").arg(appleIDEmail);
-            if (findMyMacEnabled) {
-                allRecommendations << "Отключите Find My Mac перед передачей устройства";
-            }
-        } else {
-            result += "   • Аккаунт не найден\n";
-        }
-        result += "\n";
-        
-        // Диск
-        result += "💽 Проверка диска:\n";
-        if (diskCheckPassed) {
-            result += "   • Проверка успешна\n";
-        } else {
-            result += QString("   • Обнаружены проблемы: %1\n").arg(diskStatus);
-        }
-        result += "\n";
-        
-        // Рекомендации
-        if (!allRecommendations.isEmpty()) {
-            result += "⚠️ Рекомендации:\n";
-            for (const QString &rec : allRecommendations) {
-                result += QString("   • %1\n").arg(rec);
-            }
-        }
-        
-        return result;
-    }
-};
+#include <QHash>
+#include <QList>
+#include <QSet>
+#include <QDeadlineTimer>
+#include <QElapsedTimer>
+#include "diagnosticresults.h"
+#include "commandrunner.h"
+#include "probe.h"
+#include "proberesultcache.h"
 
 class DiagnosticManager : public QObject
 {
@@ -73,26 +20,110 @@ class DiagnosticManager : public QObject
 public:
     explicit DiagnosticManager(QObject *parent = nullptr);
     void runDiagnostics();
+    // Повторная проверка после исправлений: проверки с неизменившимся
+    // отпечатком (Probe::fingerprint) не запускаются, их результат берётся
+    // из вывода прошлого запуска
+    void rerunChangedProbes();
+    // Прерывает текущий запуск; результаты отправляются как неполные
+    void cancel();
+    bool isRunning() const { return running; }
+
+    // Набор проверок для следующих запусков
+    void setProbeRegistry(const ProbeRegistry &registry);
+    const ProbeRegistry &probeRegistry() const { return registry; }
+
+    // Откуда берётся вывод команд; по умолчанию запускаются настоящие процессы
+    void setCommandRunner(const QSharedPointer<CommandRunner> &runner);
+    QSharedPointer<CommandRunner> commandRunner() const { return runner; }
+
+    // Кэш вывода проверок между запусками
+    ProbeResultCache &resultCache() { return cache; }
+    // Следующие запуски игнорируют кэш и перезаписывают его
+    void setForceRefresh(bool force);
+    bool forceRefresh() const { return refreshCache; }
+
+    // Сколько проверок может выполняться одновременно
+    void setMaxConcurrentProbes(int count);
+    int maxConcurrentProbes() const { return maxConcurrent; }
+
+    // Пересылать ли сырой вывод команд через progressUpdated. По умолчанию
+    // выключено: наружу уходят только итоги проверок
+    void setForwardProbeOutput(bool forward);
+    bool forwardProbeOutput() const { return forwardOutput; }
 
 signals:
     void progressUpdated(int progress, const QString &message);
+    void probeFinished(const QString &description, bool success, int progress);
     void diagnosticsFinished(bool success, const DiagnosticResults &results);
 
 private:
-    void checkBattery();
-    void checkDiskHealth();
-    void checkAppleID();
+    struct RunningProbe {
+        QSharedPointer<Probe> probe;
+        QSharedPointer<ProbeParser> parser;
+        QDeadlineTimer deadline;
+        bool timedOut = false;
+        // Вывод копируется для кэша и для повторной проверки с отпечатком
+        bool cacheOutput = false;
+        QByteArray fingerprint;
+        QByteArray output;
+        // Конец stderr: последняя строка попадает в журнал, если команда
+        // завершилась с ошибкой
+        QByteArray errorOutput;
+        ProbeTiming timing;
+        qint64 parseNs = 0;
+    };
+
+    // Успешный вывод проверки в последнем запуске
+    struct StoredOutput {
+        QByteArray fingerprint;
+        QByteArray output;
+    };
+
+    void startRun(bool incremental);
+    void rememberOutput(const QSharedPointer<Probe> &probe, const QByteArray &fingerprint,
+                        const QByteArray &output);
+    bool applyUnchangedResult(const QSharedPointer<Probe> &probe);
+
     void checkSystemIntegrity();
-    void parseBatteryInfo(const QString &output);
-    void parseAppleIDInfo(const QString &output);
-    void parseDiskInfo(const QString &output);
-    void executeSystemCommand(const QString &command, const QString &description);
-    void executeSystemCommand(const QString &command, const QStringList &args, const QString &description);
+    void checkDeadlines();
+    void stopRunningProbes();
+    void markIncomplete(const QSharedPointer<Probe> &probe);
+    qint64 runMicros() const;
+    ProbeTiming beginTiming(const QSharedPointer<Probe> &probe, const QString &source) const;
+    void finishTiming(ProbeTiming timing, const QString &status);
+    // Возвращает время разбора, мкс
+    qint64 applyOutput(const QSharedPointer<Probe> &probe, const QByteArray &output);
+    bool applyCachedResult(const QSharedPointer<Probe> &probe);
+    bool applyNativeResult(const QSharedPointer<Probe> &probe);
+    void completeProbe(const QSharedPointer<Probe> &probe, bool success);
+    void startPendingProbes();
+    bool dependenciesSatisfied(const QSharedPointer<Probe> &probe) const;
+    void handleProbeOutput(ProbeProcess *probeProcess, const QByteArray &chunk);
+    void handleProbeErrorOutput(ProbeProcess *probeProcess, const QByteArray &chunk);
+    void handleProbeFinished(ProbeProcess *probeProcess, int exitCode, const QString &status);
+    void executeSystemCommand(const QSharedPointer<Probe> &probe);
 
-    QProcess *process;
-    int currentStep;
+    ProbeRegistry registry;
+    QSharedPointer<CommandRunner> runner;
+    QTimer *watchdog;
+    // Начало текущего запуска, от него отсчитывается время проверок
+    QElapsedTimer runClock;
+    ProbeResultCache cache;
+    bool refreshCache;
+    bool forwardOutput;
+    QList<QSharedPointer<Probe>> pendingProbes;
+    QHash<ProbeProcess *, RunningProbe> runningProbes;
+    QSet<QString> completedProbes;
+    // Для rerunChangedProbes: вывод по идентификатору проверки и машина,
+    // на которой он получен
+    QHash<QString, StoredOutput> lastOutputs;
+    QString lastOutputsSerial;
+    bool incrementalRun;
+    int maxConcurrent;
+    int totalProbes;
     int currentProgress;
     bool overallSuccess;
+    bool running;
     DiagnosticResults results;
 };
 
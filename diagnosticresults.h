@@ -0,0 +1,195 @@
+#ifndef DIAGNOSTICRESULTS_H
+#define DIAGNOSTICRESULTS_H
+
+#include <QDateTime>
+#include <QList>
+#include <QMetaType>
+#include <QString>
+#include <QStringList>
+#include <QVariantMap>
+
+// Время одной проверки в запуске. Моменты отсчитываются в микросекундах
+// от начала запуска, -1 — событие не наступило
+struct ProbeTiming {
+    QString probeId;
+    // Откуда взят результат: process, cache, native, unchanged, skipped
+    QString source;
+    // ok, exit:<код>, crashed, timeout, failed-to-start, cancelled
+    QString status;
+    int exitCode = 0;
+    qint64 startUs = 0;
+    // Время от вызова start() до запуска процесса
+    qint64 spawnUs = -1;
+    // Время от вызова start() до первого байта вывода
+    qint64 firstByteUs = -1;
+    qint64 totalUs = 0;
+    qint64 bytesRead = 0;
+    // Суммарное время в разборщике
+    qint64 parseUs = 0;
+};
+
+struct DiagnosticResults {
+    // Машина и время завершения проверки
+    QString machineSerial;
+    QString machineModel;
+    QDateTime finishedAt;
+
+    // Профиль диагностики и проверки, которые он включал. Пустой список —
+    // запись старой версии, где выполнялись все проверки
+    QString profile;
+    QStringList probes;
+    bool covers(const QString &probeId) const { return probes.isEmpty() || probes.contains(probeId); }
+
+    // Результаты батареи
+    int cycleCounts = 0;
+    int maxCapacity = 0;
+    QString batteryCondition;
+
+    // Результаты Apple ID
+    bool hasAppleID = false;
+    QString appleIDEmail;
+
+    // Find My Mac
+    bool findMyMacEnabled = false;
+
+    // Результаты проверки диска
+    bool diskCheckPassed = false;
+    QString diskStatus;
+    // Какой уровень дал вердикт по диску: "screen" — быстрый опрос
+    // SMART/APFS, "verify" — полная проверка тома, пусто — вердикта нет
+    QString diskCheckTier;
+
+    // Значения дополнительных проверок (ключи объявляет сама проверка)
+    QVariantMap values;
+
+    // Список рекомендаций
+    QStringList recommendations;
+
+    // Проверки, прерванные по таймауту или отменой: их поля не заполнены
+    QStringList incompleteProbes;
+    bool isComplete() const { return incompleteProbes.isEmpty(); }
+
+    bool checksDisk() const { return covers("disk-screen") || covers("disk"); }
+
+    // Есть ли в запуске значения батареи: проверка входила в профиль,
+    // завершилась и нашла батарею (у настольных Mac её нет)
+    bool batteryChecked() const
+    {
+        return covers("battery") && !incompleteProbes.contains("battery") && maxCapacity > 0;
+    }
+    // Есть ли вердикт по диску. В записях старых версий уровня проверки
+    // нет: там вердикт — итог проверки диска, если она не прервана
+    bool diskChecked() const
+    {
+        if (!diskCheckTier.isEmpty()) {
+            return true;
+        }
+        return probes.isEmpty() && !incompleteProbes.contains("disk")
+               && (diskCheckPassed || !diskStatus.isEmpty());
+    }
+
+    // Время каждой проверки в порядке завершения
+    QList<ProbeTiming> timings;
+
+    QString toString() const {
+        QString result = "📊 Итоги диагностики:\n\n";
+        QStringList allRecommendations = recommendations;
+
+        if (!profile.isEmpty()) {
+            result += QString("📋 Профиль: %1\n\n").arg(profile);
+        }
+
+        // Батарея
+        if (covers("battery")) {
+            result += "🔋 Батарея:\n";
+            result += QString("   • Циклы заряда: %1\n").arg(cycleCounts);
+            result += QString("   • Максимальная ёмкость: %1%\n").arg(maxCapacity);
+            if (!batteryCondition.isEmpty()) {
+                result += QString("   • Состояние: %1\n").arg(batteryCondition);
+            }
+            result += "\n";
+        }
+
+        // Apple ID
+        if (covers("appleid")) {
+            result += "🍎 Apple ID:\n";
+            if (hasAppleID) {
+                result += QString("   • Аккаунт: %1\n").arg(appleIDEmail);
+                if (findMyMacEnabled) {
+                    allRecommendations << "Отключите Find My Mac перед передачей устройства";
+                }
+            } else {
+                result += "   • Аккаунт не найден\n";
+            }
+            result += "\n";
+        }
+
+        // Диск
+        if (checksDisk()) {
+            result += "💽 Проверка диска:\n";
+            if (diskCheckPassed) {
+                result += "   • Проверка успешна\n";
+            } else if (diskCheckTier.isEmpty() && diskStatus.isEmpty() && !covers("disk")) {
+                result += "   • Нет вердикта: SMART неоднозначен, нужна полная проверка тома\n";
+            } else {
+                result += QString("   • Обнаружены проблемы: %1\n").arg(diskStatus);
+            }
+            if (diskCheckTier == "screen") {
+                result += "   • Уровень: быстрая проверка (SMART/APFS)\n";
+            } else if (diskCheckTier == "verify") {
+                result += "   • Уровень: полная проверка тома\n";
+            }
+            result += "\n";
+        }
+
+        // Дополнительные проверки
+        if (!values.isEmpty()) {
+            result += "🧩 Дополнительные проверки:\n";
+            for (auto it = values.constBegin(); it != values.constEnd(); ++it) {
+                result += QString("   • %1: %2\n").arg(it.key(), it.value().toString());
+            }
+            result += "\n";
+        }
+
+        if (!incompleteProbes.isEmpty()) {
+            result += "⏱ Не завершены проверки (результаты неполные):\n";
+            for (const QString &probe : incompleteProbes) {
+                result += QString("   • %1\n").arg(probe);
+            }
+            result += "\n";
+        }
+
+        // Рекомендации
+        if (!allRecommendations.isEmpty()) {
+            result += "⚠️ Рекомендации:\n";
+            for (const QString &rec : allRecommendations) {
+                result += QString("   • %1\n").arg(rec);
+            }
+        }
+
+        if (!timings.isEmpty()) {
+            result += "\n⏲ Время проверок, мс:\n";
+            result += QString("   %1 %2 %3 %4 %5 %6 %7 %8\n")
+                          .arg("проверка", -12).arg("источник", -10).arg("запуск", 8)
+                          .arg("1-й байт", 9).arg("всего", 9).arg("разбор", 8)
+                          .arg("байт", 10).arg("итог");
+            const auto ms = [](qint64 us) {
+                return us < 0 ? QString("—") : QString::number(us / 1000.0, 'f', 1);
+            };
+            for (const ProbeTiming &timing : timings) {
+                result += QString("   %1 %2 %3 %4 %5 %6 %7 %8\n")
+                              .arg(timing.probeId, -12).arg(timing.source, -10)
+                              .arg(ms(timing.spawnUs), 8).arg(ms(timing.firstByteUs), 9)
+                              .arg(ms(timing.totalUs), 9).arg(ms(timing.parseUs), 8)
+                              .arg(timing.bytesRead, 10).arg(timing.status);
+            }
+        }
+
+        return result;
+    }
+};
+
+// Результаты передаются между потоками через сигналы
+Q_DECLARE_METATYPE(DiagnosticResults)
+
+#endif // DIAGNOSTICRESULTS_H
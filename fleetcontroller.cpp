@@ -0,0 +1,357 @@
+#include "fleetcontroller.h"
+#include "resultserializer.h"
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QProcess>
+#include <QRegularExpression>
+#include <QTimer>
+
+namespace {
+
+// Полная проверка диска занимает до 15 минут, плюс подключение
+const int DefaultHostTimeoutMs = 20 * 60 * 1000;
+const int DefaultMaxParallel = 8;
+// Столько байт stderr хватает для сообщения ssh об ошибке
+const int MaxErrorOutput = 4096;
+
+void setError(QString *error, const QString &message)
+{
+    if (error) {
+        *error = message;
+    }
+}
+
+// ssh передаёт команду удалённой оболочке одной строкой
+QString shellQuote(const QString &argument)
+{
+    static const QRegularExpression safe("^[A-Za-z0-9_./=:,@+-]+$");
+    if (safe.match(argument).hasMatch()) {
+        return argument;
+    }
+    QString quoted = argument;
+    quoted.replace("'", "'\\''");
+    return "'" + quoted + "'";
+}
+
+QString lastLine(const QByteArray &output)
+{
+    const QStringList lines = QString::fromUtf8(output).trimmed().split('\n');
+    return lines.isEmpty() ? QString() : lines.last().trimmed();
+}
+
+enum HostState {
+    HostReady,
+    HostNeedsAction,
+    HostFailed
+};
+
+HostState hostState(const FleetHostResult &result)
+{
+    // Коды выхода утилиты: 1 — нужны действия, 2 — проверки не выполнены
+    if (!result.reported || result.exitCode == 2 || !result.results.isComplete()) {
+        return HostFailed;
+    }
+    return result.exitCode == 1 ? HostNeedsAction : HostReady;
+}
+
+QString hostStatus(const FleetHostResult &result)
+{
+    if (!result.reported) {
+        return "нет отчёта";
+    }
+    switch (hostState(result)) {
+        case HostReady:
+            return "готов";
+        case HostNeedsAction:
+            return "нужны действия";
+        case HostFailed:
+            break;
+    }
+    return "проверки не выполнены";
+}
+
+} // namespace
+
+SshFleetTransport::SshFleetTransport(const QString &remoteCommand)
+    : remoteCommand(remoteCommand)
+{
+}
+
+QString SshFleetTransport::program(const QString &host) const
+{
+    Q_UNUSED(host);
+    return "ssh";
+}
+
+QStringList SshFleetTransport::arguments(const QString &host, const QStringList &remoteArguments) const
+{
+    QStringList command;
+    command << shellQuote(remoteCommand);
+    for (const QString &argument : remoteArguments) {
+        command << shellQuote(argument);
+    }
+    return QStringList() << "-o" << "BatchMode=yes"
+                         << "-o" << "ConnectTimeout=15"
+                         << "-o" << "ServerAliveInterval=30"
+                         << "--" << host << command.join(' ');
+}
+
+ReplayFleetTransport::ReplayFleetTransport(const QString &fixtureRoot, const QString &program)
+    : fixtureRoot(fixtureRoot), programPath(program), delayScale(1.0)
+{
+}
+
+QString ReplayFleetTransport::program(const QString &host) const
+{
+    Q_UNUSED(host);
+    return programPath.isEmpty() ? QCoreApplication::applicationFilePath() : programPath;
+}
+
+QStringList ReplayFleetTransport::arguments(const QString &host, const QStringList &remoteArguments) const
+{
+    return QStringList(remoteArguments)
+           << "--replay" << fixtureRoot + "/" + host
+           << "--replay-delay-scale" << QString::number(delayScale);
+}
+
+FleetController::FleetController(QObject *parent)
+    : QObject(parent), transport(new SshFleetTransport),
+      parallel(DefaultMaxParallel), hostTimeoutMs(DefaultHostTimeoutMs)
+{
+}
+
+void FleetController::setTransport(const QSharedPointer<FleetTransport> &newTransport)
+{
+    if (newTransport) {
+        transport = newTransport;
+    }
+}
+
+void FleetController::setMaxParallel(int count)
+{
+    parallel = qMax(1, count);
+}
+
+void FleetController::run(const QStringList &hosts)
+{
+    cancel();
+    finishedHosts.clear();
+    hostOrder.clear();
+    for (const QString &host : hosts) {
+        if (!host.isEmpty() && !hostOrder.contains(host)) {
+            hostOrder << host;
+        }
+    }
+    pendingHosts = hostOrder;
+
+    QTimer::singleShot(0, this, &FleetController::startPendingHosts);
+}
+
+void FleetController::cancel()
+{
+    pendingHosts.clear();
+    for (auto it = processes.constBegin(); it != processes.constEnd(); ++it) {
+        QProcess *process = it.key();
+        process->disconnect(this);
+        process->kill();
+        process->deleteLater();
+    }
+    processes.clear();
+}
+
+QList<FleetHostResult> FleetController::results() const
+{
+    QList<FleetHostResult> ordered;
+    for (const QString &host : hostOrder) {
+        if (finishedHosts.contains(host)) {
+            ordered << finishedHosts.value(host);
+        }
+    }
+    return ordered;
+}
+
+void FleetController::startPendingHosts()
+{
+    while (!pendingHosts.isEmpty() && processes.size() < parallel) {
+        startHost(pendingHosts.takeFirst());
+    }
+    if (processes.isEmpty() && pendingHosts.isEmpty()) {
+        emit finished();
+    }
+}
+
+void FleetController::startHost(const QString &host)
+{
+    QStringList remoteArguments;
+    remoteArguments << "--headless" << "--format" << "json" << extraArguments;
+
+    QProcess *process = new QProcess(this);
+    RunningHost running;
+    running.host = host;
+    running.timer = new QTimer(process);
+    running.timer->setSingleShot(true);
+    processes.insert(process, running);
+
+    connect(running.timer, &QTimer::timeout, this, [this, process]() {
+        auto it = processes.find(process);
+        if (it != processes.end()) {
+            it->timedOut = true;
+            process->kill();
+        }
+    });
+    connect(process, &QProcess::readyReadStandardOutput, this, [this, process]() {
+        processes[process].output.append(process->readAllStandardOutput());
+    });
+    connect(process, &QProcess::readyReadStandardError, this, [this, process]() {
+        QByteArray &errorOutput = processes[process].errorOutput;
+        errorOutput.append(process->readAllStandardError());
+        if (errorOutput.size() > MaxErrorOutput) {
+            errorOutput = errorOutput.right(MaxErrorOutput);
+        }
+    });
+    connect(process, &QProcess::finished,
+            this, [this, process](int exitCode, QProcess::ExitStatus exitStatus) {
+                completeHost(process, exitCode, exitStatus != QProcess::NormalExit);
+            });
+    connect(process, &QProcess::errorOccurred, this, [this, process](QProcess::ProcessError error) {
+        if (error == QProcess::FailedToStart) {
+            processes[process].errorOutput = process->errorString().toUtf8();
+            completeHost(process, -1, true);
+        }
+    });
+
+    emit hostStarted(host);
+    running.timer->start(hostTimeoutMs);
+    process->start(transport->program(host), transport->arguments(host, remoteArguments));
+}
+
+void FleetController::completeHost(QProcess *process, int exitCode, bool crashed)
+{
+    if (!processes.contains(process)) {
+        return;
+    }
+
+    process->disconnect(this);
+    RunningHost running = processes.take(process);
+    running.output.append(process->readAllStandardOutput());
+    process->deleteLater();
+
+    FleetHostResult result;
+    result.host = running.host;
+    result.exitCode = exitCode;
+
+    QString parseError;
+    if (running.timedOut) {
+        result.error = "Превышено время ожидания";
+    } else if (crashed) {
+        result.error = "Команда не выполнена: " + lastLine(running.errorOutput);
+    } else if (exitCode > 2) {
+        // 0–2 — коды утилиты с отчётом; остальное — ошибка ssh или аргументов
+        result.error = QString("Код выхода %1: %2").arg(exitCode).arg(lastLine(running.errorOutput));
+    } else if (!ResultSerializer::fromJsonBytes(running.output, &result.results, &parseError)) {
+        result.error = "Неверный отчёт: " + parseError;
+    } else {
+        result.reported = true;
+    }
+
+    finishedHosts.insert(result.host, result);
+    emit hostFinished(result);
+    startPendingHosts();
+}
+
+bool FleetController::readHostList(const QString &path, QStringList *hosts, QString *error)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        setError(error, file.errorString());
+        return false;
+    }
+
+    hosts->clear();
+    while (!file.atEnd()) {
+        QString line = QString::fromUtf8(file.readLine());
+        const int comment = line.indexOf('#');
+        if (comment >= 0) {
+            line.truncate(comment);
+        }
+        line = line.trimmed();
+        if (!line.isEmpty()) {
+            *hosts << line;
+        }
+    }
+    if (hosts->isEmpty()) {
+        setError(error, "Список машин пуст");
+        return false;
+    }
+    return true;
+}
+
+QString FleetController::reportText(const QList<FleetHostResult> &results)
+{
+    int counts[HostFailed + 1] = {};
+    for (const FleetHostResult &result : results) {
+        ++counts[hostState(result)];
+    }
+
+    QString report = QString("=== Диагностика парка: %1 машин ===\n").arg(results.size());
+    report += QString("✅ Готовы к передаче: %1\n").arg(counts[HostReady]);
+    report += QString("⚠️ Нужны действия: %1\n").arg(counts[HostNeedsAction]);
+    report += QString("❌ Без результата: %1\n\n").arg(counts[HostFailed]);
+
+    for (const FleetHostResult &result : results) {
+        report += QString("%1\t%2\t%3\t%4")
+                      .arg(result.host, result.results.machineSerial,
+                           result.results.machineModel, hostStatus(result));
+        if (!result.error.isEmpty()) {
+            report += " (" + result.error + ")";
+        }
+        report += "\n";
+    }
+
+    for (const FleetHostResult &result : results) {
+        if (result.reported) {
+            report += "\n--- " + result.host + " ---\n" + result.results.toString();
+        }
+    }
+    return report;
+}
+
+QByteArray FleetController::reportJson(const QList<FleetHostResult> &results)
+{
+    QJsonArray hosts;
+    for (const FleetHostResult &result : results) {
+        QJsonObject host;
+        host["host"] = result.host;
+        host["exitCode"] = result.exitCode;
+        host["status"] = hostStatus(result);
+        if (!result.error.isEmpty()) {
+            host["error"] = result.error;
+        }
+        if (result.reported) {
+            host["results"] = ResultSerializer::toJson(result.results);
+        }
+        hosts.append(host);
+    }
+
+    QJsonObject report;
+    report["generatedAt"] = QDateTime::currentDateTimeUtc().toString(Qt::ISODateWithMs);
+    report["hosts"] = hosts;
+    return QJsonDocument(report).toJson();
+}
+
+QByteArray FleetController::reportBinary(const QList<FleetHostResult> &results)
+{
+    // Записи подряд, как их читает ResultSerializer::readBinary; машины без
+    // отчёта пропускаются
+    QByteArray report;
+    for (const FleetHostResult &result : results) {
+        if (result.reported) {
+            report += ResultSerializer::toBinary(result.results);
+        }
+    }
+    return report;
+}
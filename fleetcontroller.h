@@ -0,0 +1,129 @@
+#ifndef FLEETCONTROLLER_H
+#define FLEETCONTROLLER_H
+
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QSharedPointer>
+#include <QStringList>
+#include "diagnosticresults.h"
+
+class QProcess;
+class QTimer;
+
+// Результат одной машины парка
+struct FleetHostResult {
+    QString host;
+    // true, если машина вернула разобранный отчёт (даже с ошибками проверок)
+    bool reported = false;
+    // Код выхода удалённой утилиты или транспорта (у ssh 255 — нет связи)
+    int exitCode = -1;
+    QString error;
+    DiagnosticResults results;
+};
+
+// Как запустить консольную диагностику на машине парка
+class FleetTransport
+{
+public:
+    virtual ~FleetTransport() = default;
+
+    virtual QString program(const QString &host) const = 0;
+    // remoteArguments — аргументы самой утилиты диагностики
+    virtual QStringList arguments(const QString &host, const QStringList &remoteArguments) const = 0;
+};
+
+// ssh без интерактивных запросов пароля: ключи должны быть настроены заранее
+class SshFleetTransport : public FleetTransport
+{
+public:
+    explicit SshFleetTransport(const QString &remoteCommand = QStringLiteral("mac_diagnostic_cli"));
+
+    QString program(const QString &host) const override;
+    QStringList arguments(const QString &host, const QStringList &remoteArguments) const override;
+
+private:
+    QString remoteCommand;
+};
+
+// Локальная замена ssh: для машины host запускается эта же программа с
+// --replay <fixtureRoot>/<host>
+class ReplayFleetTransport : public FleetTransport
+{
+public:
+    // Пустой program — текущий исполняемый файл
+    explicit ReplayFleetTransport(const QString &fixtureRoot, const QString &program = QString());
+
+    void setDelayScale(double scale) { delayScale = scale; }
+
+    QString program(const QString &host) const override;
+    QStringList arguments(const QString &host, const QStringList &remoteArguments) const override;
+
+private:
+    QString fixtureRoot;
+    QString programPath;
+    double delayScale;
+};
+
+// Запускает диагностику на списке машин, не больше maxParallel одновременно.
+// Каждая машина отдаёт отчёт в JSON, он разбирается в DiagnosticResults и
+// сразу уходит сигналом hostFinished; после последней машины — finished().
+class FleetController : public QObject
+{
+    Q_OBJECT
+public:
+    explicit FleetController(QObject *parent = nullptr);
+
+    void setTransport(const QSharedPointer<FleetTransport> &transport);
+    void setMaxParallel(int count);
+    int maxParallel() const { return parallel; }
+    // Сколько ждать одну машину, включая полную проверку диска
+    void setHostTimeout(int milliseconds) { hostTimeoutMs = qMax(1, milliseconds); }
+    // Дополнительные аргументы удалённой утилиты, например --refresh
+    void setExtraArguments(const QStringList &arguments) { extraArguments = arguments; }
+
+    void run(const QStringList &hosts);
+    void cancel();
+    bool isRunning() const { return !processes.isEmpty() || !pendingHosts.isEmpty(); }
+
+    // Результаты в порядке списка машин
+    QList<FleetHostResult> results() const;
+
+    // Список машин из файла: по одной на строку, # — комментарий
+    static bool readHostList(const QString &path, QStringList *hosts, QString *error = nullptr);
+
+    static QString reportText(const QList<FleetHostResult> &results);
+    static QByteArray reportJson(const QList<FleetHostResult> &results);
+    static QByteArray reportBinary(const QList<FleetHostResult> &results);
+
+signals:
+    void hostStarted(const QString &host);
+    void hostFinished(const FleetHostResult &result);
+    void finished();
+
+private:
+    struct RunningHost {
+        QString host;
+        QTimer *timer = nullptr;
+        QByteArray output;
+        QByteArray errorOutput;
+        bool timedOut = false;
+    };
+
+    void startPendingHosts();
+    void startHost(const QString &host);
+    void completeHost(QProcess *process, int exitCode, bool crashed);
+
+    QSharedPointer<FleetTransport> transport;
+    int parallel;
+    int hostTimeoutMs;
+    QStringList extraArguments;
+    QStringList hostOrder;
+    QStringList pendingHosts;
+    QHash<QProcess *, RunningHost> processes;
+    QHash<QString, FleetHostResult> finishedHosts;
+};
+
+Q_DECLARE_METATYPE(FleetHostResult)
+
+#endif // FLEETCONTROLLER_H
@@ -0,0 +1,538 @@
+#include "headlessrunner.h"
+#include "agentclient.h"
+#include "diagnosticagent.h"
+#include "builtinprobes.h"
+#include "machineidentity.h"
+#include "probeprofile.h"
+#include "resultserializer.h"
+#include "runhistory.h"
+#include "spawnrunner.h"
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QFile>
+#include <QSaveFile>
+#include <QTextStream>
+#include <QTimer>
+
+HeadlessRunner::HeadlessRunner(QObject *parent)
+    : QObject(parent), diagnosticManager(new DiagnosticManager(this)), fleetController(nullptr),
+      agent(nullptr), agentClient(nullptr), format(TextFormat), verbose(false), code(ExitClean)
+{
+    connect(diagnosticManager, &DiagnosticManager::progressUpdated,
+            this, [this](int, const QString &message) {
+                if (verbose) {
+                    QTextStream(stderr) << message.trimmed() << Qt::endl;
+                }
+            });
+    connect(diagnosticManager, &DiagnosticManager::probeFinished,
+            this, [this](const QString &description, bool success, int progress) {
+                if (verbose) {
+                    QTextStream(stderr) << (success ? "[ok] " : "[fail] ") << description
+                                        << " (" << progress << "%)" << Qt::endl;
+                }
+            });
+    connect(diagnosticManager, &DiagnosticManager::diagnosticsFinished,
+            this, &HeadlessRunner::diagnosticsCompleted);
+}
+
+bool HeadlessRunner::configure(const QStringList &arguments)
+{
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Диагностика Mac перед передачей устройства");
+    parser.addHelpOption();
+
+    QCommandLineOption headlessOption("headless", "Запуск без графического интерфейса.");
+    QCommandLineOption verboseOption(QStringList() << "v" << "verbose",
+                                     "Выводить ход проверок в stderr.");
+    QCommandLineOption jobsOption(QStringList() << "j" << "jobs",
+                                  "Сколько проверок выполнять одновременно.", "count");
+    QCommandLineOption formatOption(QStringList() << "f" << "format",
+                                    "Формат отчёта: text, json или binary.", "format", "text");
+    QCommandLineOption outputOption(QStringList() << "o" << "output",
+                                    "Записать отчёт в файл вместо stdout.", "file");
+    QCommandLineOption traceOption("trace", "Записать время проверок в формате Chrome Trace (chrome://tracing, Perfetto).",
+                                   "file");
+    QCommandLineOption historyOption("history", "Показать историю запусков машины (local — этой машины) и выйти.",
+                                     "serial");
+    QCommandLineOption sinceOption("since", "Для --history: запуски не раньше даты YYYY-MM-DD.", "date");
+    QCommandLineOption historyDirOption("history-dir", "Каталог истории запусков вместо каталога данных приложения.",
+                                        "dir");
+    QCommandLineOption noHistoryOption("no-history", "Не записывать запуск в историю.");
+    QCommandLineOption refreshOption("refresh", "Не использовать сохранённые результаты проверок.");
+    QCommandLineOption deepDiskOption("deep-disk", "Всегда выполнять полную проверку тома, даже если SMART в порядке.");
+    QCommandLineOption agentOption("agent", "Работать резидентным агентом: выполнять запросы через локальный сокет.");
+    QCommandLineOption useAgentOption("use-agent", "Выполнить проверку через запущенный агент, если он доступен.");
+    QCommandLineOption agentSocketOption("agent-socket", "Имя или путь сокета агента.", "name",
+                                         AgentProtocol::defaultSocketName());
+    QCommandLineOption profileOption(QStringList() << "p" << "profile",
+                                     "Профиль диагностики (список — --list-profiles).", "id");
+    QCommandLineOption profilesFileOption("profiles", "Файл профилей вместо profiles.json из настроек.", "file");
+    QCommandLineOption listProfilesOption("list-profiles", "Показать доступные профили и выйти.");
+    QCommandLineOption clearCacheOption("clear-cache", "Удалить сохранённые результаты проверок.");
+    QCommandLineOption replayOption("replay", "Воспроизвести записанный вывод проверок из каталога.", "dir");
+    QCommandLineOption replaySpeedOption("replay-delay-scale",
+                                         "Множитель задержек при воспроизведении (0 — без задержек).",
+                                         "factor", "1");
+    QCommandLineOption runnerOption("runner", "Запуск команд проверок: qprocess или spawn (posix_spawn, общий poll).",
+                                    "runner", "qprocess");
+    QCommandLineOption recordOption("record", "Записать вывод проверок в каталог для --replay.", "dir");
+    QCommandLineOption fleetOption("fleet", "Проверить машины из списка (по одной на строку) через ssh.", "hosts");
+    QCommandLineOption fleetJobsOption("fleet-jobs", "Сколько машин проверять одновременно.", "count", "8");
+    QCommandLineOption fleetReplayOption("fleet-replay",
+                                         "Вместо ssh воспроизвести для каждой машины записи из <dir>/<машина>.",
+                                         "dir");
+    QCommandLineOption remoteCommandOption("remote-command", "Путь к утилите диагностики на машинах парка.",
+                                           "command", "mac_diagnostic_cli");
+    parser.addOption(headlessOption);
+    parser.addOption(replayOption);
+    parser.addOption(replaySpeedOption);
+    parser.addOption(recordOption);
+    parser.addOption(runnerOption);
+    parser.addOption(fleetOption);
+    parser.addOption(fleetJobsOption);
+    parser.addOption(fleetReplayOption);
+    parser.addOption(remoteCommandOption);
+    parser.addOption(agentOption);
+    parser.addOption(useAgentOption);
+    parser.addOption(agentSocketOption);
+    parser.addOption(profileOption);
+    parser.addOption(profilesFileOption);
+    parser.addOption(listProfilesOption);
+    parser.addOption(refreshOption);
+    parser.addOption(deepDiskOption);
+    parser.addOption(clearCacheOption);
+    parser.addOption(verboseOption);
+    parser.addOption(jobsOption);
+    parser.addOption(formatOption);
+    parser.addOption(outputOption);
+    parser.addOption(traceOption);
+    parser.addOption(historyOption);
+    parser.addOption(sinceOption);
+    parser.addOption(historyDirOption);
+    parser.addOption(noHistoryOption);
+
+    if (!parser.parse(arguments)) {
+        QTextStream(stderr) << parser.errorText() << Qt::endl;
+        code = ExitUsage;
+        return false;
+    }
+    if (parser.isSet("help")) {
+        QTextStream(stdout) << parser.helpText();
+        code = ExitClean;
+        return false;
+    }
+
+    verbose = parser.isSet(verboseOption);
+    diagnosticManager->setForwardProbeOutput(verbose);
+
+    bool delayScaleOk = false;
+    const double delayScale = parser.value(replaySpeedOption).toDouble(&delayScaleOk);
+    if (!delayScaleOk || delayScale < 0) {
+        QTextStream(stderr) << "Неверное значение --replay-delay-scale: "
+                            << parser.value(replaySpeedOption) << Qt::endl;
+        code = ExitUsage;
+        return false;
+    }
+
+    QSharedPointer<CommandRunner> runner;
+    if (parser.value(runnerOption) == "spawn") {
+        runner.reset(new SpawnCommandRunner);
+    } else if (parser.value(runnerOption) == "qprocess") {
+        runner.reset(new SystemCommandRunner);
+    } else {
+        QTextStream(stderr) << "Неизвестный способ запуска команд: " << parser.value(runnerOption) << Qt::endl;
+        code = ExitUsage;
+        return false;
+    }
+    if (parser.isSet(replayOption)) {
+        QSharedPointer<ReplayCommandRunner> replay(new ReplayCommandRunner(parser.value(replayOption)));
+        replay->setDelayScale(delayScale);
+        runner = replay;
+    }
+    if (parser.isSet(recordOption)) {
+        runner.reset(new RecordingCommandRunner(runner, parser.value(recordOption)));
+    }
+    diagnosticManager->setCommandRunner(runner);
+    diagnosticManager->setForceRefresh(parser.isSet(refreshOption));
+
+    ProfileSet profiles;
+    QString profileError;
+    if (!ProfileSet::load(parser.value(profilesFileOption), &profiles, &profileError)) {
+        QTextStream(stderr) << "Не удалось загрузить профили: " << profileError << Qt::endl;
+        code = ExitUsage;
+        return false;
+    }
+    if (parser.isSet(listProfilesOption)) {
+        QTextStream out(stdout);
+        for (const ProbeProfile &profile : profiles.profiles()) {
+            out << profile.id << (profile.id == profiles.defaultProfileId() ? " *" : "") << "\t"
+                << profile.name << "\t" << profile.probes.join(", ") << Qt::endl;
+        }
+        code = ExitClean;
+        return false;
+    }
+    if (parser.isSet(profileOption) && !profiles.contains(parser.value(profileOption))) {
+        QTextStream(stderr) << "Неизвестный профиль: " << parser.value(profileOption) << Qt::endl;
+        code = ExitUsage;
+        return false;
+    }
+    ProbeProfile profile = profiles.profile(parser.value(profileOption));
+    if (parser.isSet(deepDiskOption)) {
+        if (!profile.probes.contains("disk")) {
+            QTextStream(stderr) << "Профиль " << profile.id << " не включает полную проверку диска" << Qt::endl;
+            code = ExitUsage;
+            return false;
+        }
+        profile.deepDisk = true;
+    }
+    diagnosticManager->setProbeRegistry(profile.createRegistry());
+
+    agentSocket = parser.value(agentSocketOption);
+    if (parser.isSet(agentOption)) {
+        agent = new DiagnosticAgent(this);
+        agent->setProfiles(profiles);
+        agent->diagnosticManager()->setCommandRunner(runner);
+    }
+    if (parser.isSet(useAgentOption)) {
+        agentClient = new AgentClient(this);
+        agentRequest.profile = parser.value(profileOption);
+        agentRequest.refresh = parser.isSet(refreshOption);
+        agentRequest.deepDisk = parser.isSet(deepDiskOption);
+        agentRequest.forwardOutput = verbose;
+    }
+    if (parser.isSet(clearCacheOption)) {
+        diagnosticManager->resultCache().clear();
+    }
+    outputPath = parser.value(outputOption);
+    tracePath = parser.value(traceOption);
+
+    const QString formatName = parser.value(formatOption);
+    if (formatName == "text") {
+        format = TextFormat;
+    } else if (formatName == "json") {
+        format = JsonFormat;
+    } else if (formatName == "binary") {
+        format = BinaryFormat;
+    } else {
+        QTextStream(stderr) << "Неизвестный формат отчёта: " << formatName << Qt::endl;
+        code = ExitUsage;
+        return false;
+    }
+
+    // Записи воспроизведения и чужих машин в историю не попадают
+    if (runner->isLive() && !parser.isSet(noHistoryOption)) {
+        historyDirectory = RunHistory(parser.value(historyDirOption)).directory();
+    }
+    if (parser.isSet(historyOption)) {
+        historySerial = parser.value(historyOption);
+        if (historySerial == "local") {
+            historySerial = MachineIdentity::current().serialNumber;
+        }
+        historyDirectory = RunHistory(parser.value(historyDirOption)).directory();
+    }
+    if (parser.isSet(sinceOption)) {
+        const QDate since = QDate::fromString(parser.value(sinceOption), Qt::ISODate);
+        if (!since.isValid()) {
+            QTextStream(stderr) << "Неверная дата --since: " << parser.value(sinceOption) << Qt::endl;
+            code = ExitUsage;
+            return false;
+        }
+        historySince = since.startOfDay();
+    }
+
+    if (parser.isSet(jobsOption)) {
+        bool ok = false;
+        const int jobs = parser.value(jobsOption).toInt(&ok);
+        if (!ok || jobs < 1) {
+            QTextStream(stderr) << "Неверное значение --jobs: " << parser.value(jobsOption) << Qt::endl;
+            code = ExitUsage;
+            return false;
+        }
+        diagnosticManager->setMaxConcurrentProbes(jobs);
+        if (agent) {
+            agent->diagnosticManager()->setMaxConcurrentProbes(jobs);
+        }
+    }
+
+    if (parser.isSet(fleetOption) || parser.isSet(fleetReplayOption)) {
+        QString error;
+        if (!parser.isSet(fleetOption)) {
+            QTextStream(stderr) << "Для --fleet-replay нужен список машин --fleet" << Qt::endl;
+            code = ExitUsage;
+            return false;
+        }
+        if (!FleetController::readHostList(parser.value(fleetOption), &fleetHosts, &error)) {
+            QTextStream(stderr) << "Не удалось прочитать список машин: " << error << Qt::endl;
+            code = ExitUsage;
+            return false;
+        }
+
+        bool ok = false;
+        const int fleetJobs = parser.value(fleetJobsOption).toInt(&ok);
+        if (!ok || fleetJobs < 1) {
+            QTextStream(stderr) << "Неверное значение --fleet-jobs: " << parser.value(fleetJobsOption) << Qt::endl;
+            code = ExitUsage;
+            return false;
+        }
+
+        fleetController = new FleetController(this);
+        fleetController->setMaxParallel(fleetJobs);
+        if (parser.isSet(fleetReplayOption)) {
+            QSharedPointer<ReplayFleetTransport> replay(new ReplayFleetTransport(parser.value(fleetReplayOption)));
+            replay->setDelayScale(delayScale);
+            fleetController->setTransport(replay);
+        } else {
+            fleetController->setTransport(QSharedPointer<FleetTransport>(
+                new SshFleetTransport(parser.value(remoteCommandOption))));
+        }
+        // Профиль по имени: на машинах парка свой файл профилей
+        QStringList remoteOptions;
+        if (parser.isSet(profileOption)) {
+            remoteOptions << "--profile" << profile.id;
+        }
+        if (parser.isSet(refreshOption)) {
+            remoteOptions << "--refresh";
+        }
+        if (parser.isSet(deepDiskOption)) {
+            remoteOptions << "--deep-disk";
+        }
+        fleetController->setExtraArguments(remoteOptions);
+
+        // Итог каждой машины сразу, не дожидаясь всего парка
+        connect(fleetController, &FleetController::hostFinished,
+                this, [](const FleetHostResult &result) {
+                    QTextStream(stderr) << (result.reported ? "[done] " : "[fail] ") << result.host
+                                        << (result.error.isEmpty() ? QString() : ": " + result.error)
+                                        << Qt::endl;
+                });
+        connect(fleetController, &FleetController::finished, this, &HeadlessRunner::fleetCompleted);
+    }
+
+    return true;
+}
+
+void HeadlessRunner::start()
+{
+    if (!historySerial.isEmpty()) {
+        showHistory();
+        return;
+    }
+    if (agent) {
+        if (!startAgent()) {
+            emit finished(code);
+        }
+        return;
+    }
+    if (fleetController) {
+        fleetController->run(fleetHosts);
+        return;
+    }
+    if (agentClient && startViaAgent()) {
+        return;
+    }
+    diagnosticManager->runDiagnostics();
+}
+
+bool HeadlessRunner::startAgent()
+{
+    QString error;
+    if (!agent->listen(agentSocket, &error)) {
+        QTextStream(stderr) << "Не удалось открыть сокет агента: " << error << Qt::endl;
+        code = ExitUsage;
+        return false;
+    }
+    // Агент работает до завершения процесса
+    if (verbose) {
+        QTextStream(stderr) << "Агент слушает " << agentSocket << Qt::endl;
+    }
+    return true;
+}
+
+bool HeadlessRunner::startViaAgent()
+{
+    if (!agentClient->connectToAgent(agentSocket)) {
+        if (verbose) {
+            QTextStream(stderr) << "Агент недоступен, проверка выполняется локально" << Qt::endl;
+        }
+        return false;
+    }
+
+    connect(agentClient, &AgentClient::progressUpdated, this, [this](int, const QString &message) {
+        if (verbose) {
+            QTextStream(stderr) << message.trimmed() << Qt::endl;
+        }
+    });
+    connect(agentClient, &AgentClient::probeFinished,
+            this, [this](const QString &description, bool success, int progress) {
+                if (verbose) {
+                    QTextStream(stderr) << (success ? "[ok] " : "[fail] ") << description
+                                        << " (" << progress << "%)" << Qt::endl;
+                }
+            });
+    connect(agentClient, &AgentClient::diagnosticsFinished, this, &HeadlessRunner::diagnosticsCompleted);
+    connect(agentClient, &AgentClient::failed, this, [this](const QString &message) {
+        QTextStream(stderr) << "Ошибка агента: " << message << Qt::endl;
+        code = ExitProbeFailure;
+        emit finished(code);
+    });
+    agentClient->runDiagnostics(agentRequest);
+    return true;
+}
+
+void HeadlessRunner::showHistory()
+{
+    RunHistory history(historyDirectory);
+    // Индекс прошлой версии или не доиндексированный хвост; без них
+    // история читается как есть
+    QString indexError;
+    if (!history.updateIndex(&indexError)) {
+        qWarning() << "Cannot update history index:" << indexError;
+    }
+    const QList<HistoryEntry> entries = history.entries(historySerial, historySince);
+
+    QByteArray report;
+    switch (format) {
+        case TextFormat:
+            report = RunHistory::trendText(historySerial, entries).toUtf8();
+            break;
+        case JsonFormat:
+            report = RunHistory::trendJson(historySerial, entries);
+            break;
+        case BinaryFormat:
+            // Полные записи подряд, как в файле истории: читаются readBinary
+            for (const HistoryEntry &entry : entries) {
+                DiagnosticResults results;
+                QString error;
+                if (!history.readRecord(entry, &results, &error)) {
+                    QTextStream(stderr) << "Не удалось прочитать запись истории: " << error << Qt::endl;
+                    continue;
+                }
+                report += ResultSerializer::toBinary(results);
+            }
+            break;
+    }
+
+    code = writeOutput(report) ? ExitClean : ExitOutputError;
+    emit finished(code);
+}
+
+int HeadlessRunner::exitCodeFor(bool success, const DiagnosticResults &results)
+{
+    if (!success) {
+        return ExitProbeFailure;
+    }
+    if (!results.recommendations.isEmpty() || results.findMyMacEnabled
+        || (results.checksDisk() && !results.diskCheckPassed)) {
+        return ExitRecommendations;
+    }
+    return ExitClean;
+}
+
+bool HeadlessRunner::writeReport(const DiagnosticResults &results)
+{
+    QByteArray report;
+    switch (format) {
+        case TextFormat:
+            report = results.toString().toUtf8();
+            break;
+        case JsonFormat:
+            report = ResultSerializer::toJsonBytes(results);
+            break;
+        case BinaryFormat:
+            report = ResultSerializer::toBinary(results);
+            break;
+    }
+
+    return writeOutput(report);
+}
+
+bool HeadlessRunner::writeOutput(const QByteArray &report)
+{
+    QFile output;
+    bool opened = false;
+    if (outputPath.isEmpty()) {
+        opened = output.open(stdout, QIODevice::WriteOnly);
+    } else {
+        output.setFileName(outputPath);
+        opened = output.open(QIODevice::WriteOnly | QIODevice::Truncate);
+    }
+
+    if (!opened || output.write(report) != report.size() || !output.flush()) {
+        QTextStream(stderr) << "Не удалось записать отчёт: " << output.errorString() << Qt::endl;
+        return false;
+    }
+    return true;
+}
+
+bool HeadlessRunner::writeTrace(const DiagnosticResults &results)
+{
+    if (tracePath.isEmpty()) {
+        return true;
+    }
+
+    QSaveFile file(tracePath);
+    const QByteArray trace = ResultSerializer::toChromeTrace(results);
+    if (!file.open(QIODevice::WriteOnly) || file.write(trace) != trace.size() || !file.commit()) {
+        QTextStream(stderr) << "Не удалось записать трассировку: " << file.errorString() << Qt::endl;
+        return false;
+    }
+    return true;
+}
+
+void HeadlessRunner::diagnosticsCompleted(bool success, const DiagnosticResults &results)
+{
+    const bool written = writeReport(results);
+    const bool traced = writeTrace(results);
+    code = written && traced ? exitCodeFor(success, results) : ExitOutputError;
+
+    // Неудавшаяся запись истории не портит итог проверки
+    QString error;
+    if (!historyDirectory.isEmpty() && !RunHistory(historyDirectory).append(results, &error)) {
+        QTextStream(stderr) << "Не удалось сохранить запуск в историю: " << error << Qt::endl;
+    }
+    emit finished(code);
+}
+
+void HeadlessRunner::fleetCompleted()
+{
+    const QList<FleetHostResult> results = fleetController->results();
+
+    QByteArray report;
+    switch (format) {
+        case TextFormat:
+            report = FleetController::reportText(results).toUtf8();
+            break;
+        case JsonFormat:
+            report = FleetController::reportJson(results);
+            break;
+        case BinaryFormat:
+            report = FleetController::reportBinary(results);
+            break;
+    }
+
+    // Худший итог по парку; машина без отчёта считается невыполненной проверкой
+    code = ExitClean;
+    for (const FleetHostResult &result : results) {
+        if (!result.reported) {
+            code = qMax<int>(code, ExitProbeFailure);
+        } else if (result.exitCode >= ExitClean && result.exitCode <= ExitProbeFailure) {
+            code = qMax(code, result.exitCode);
+        }
+    }
+    if (!writeOutput(report)) {
+        code = ExitOutputError;
+    }
+    emit finished(code);
+}
+
+int runHeadless(QCoreApplication &app)
+{
+    HeadlessRunner runner;
+    if (!runner.configure(app.arguments())) {
+        return runner.exitCode();
+    }
+
+    QObject::connect(&runner, &HeadlessRunner::finished, &app, &QCoreApplication::exit);
+    QTimer::singleShot(0, &runner, &HeadlessRunner::start);
+    return app.exec();
+}
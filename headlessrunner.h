@@ -0,0 +1,87 @@
+#ifndef HEADLESSRUNNER_H
+#define HEADLESSRUNNER_H
+
+#include <QDateTime>
+#include <QObject>
+#include <QStringList>
+#include "agentprotocol.h"
+#include "diagnosticmanager.h"
+#include "fleetcontroller.h"
+
+class AgentClient;
+class DiagnosticAgent;
+class QCoreApplication;
+
+// Запуск диагностики без окна: отчёт печатается в stdout, ход проверки
+// (с --verbose) — в stderr, итог возвращается кодом выхода. С --fleet
+// вместо локальной проверки опрашивается список машин по ssh. С --agent
+// процесс становится резидентным агентом, с --use-agent отдаёт проверку ему.
+// С --history печатает историю запусков машины вместо проверки.
+class HeadlessRunner : public QObject
+{
+    Q_OBJECT
+public:
+    enum ExitCode {
+        ExitClean = 0,           // Все проверки прошли, рекомендаций нет
+        ExitRecommendations = 1, // Устройство требует действий перед передачей
+        ExitProbeFailure = 2,    // Часть проверок не выполнилась
+        ExitOutputError = 3,     // Не удалось записать отчёт
+        ExitUsage = 64           // Неверные аргументы командной строки
+    };
+
+    explicit HeadlessRunner(QObject *parent = nullptr);
+
+    // Разбирает аргументы; при ошибке возвращает false и выставляет exitCode()
+    bool configure(const QStringList &arguments);
+    void start();
+    int exitCode() const { return code; }
+
+    static int exitCodeFor(bool success, const DiagnosticResults &results);
+
+signals:
+    void finished(int exitCode);
+
+private slots:
+    void diagnosticsCompleted(bool success, const DiagnosticResults &results);
+    void fleetCompleted();
+
+private:
+    enum OutputFormat {
+        TextFormat,
+        JsonFormat,
+        BinaryFormat
+    };
+
+    bool writeReport(const DiagnosticResults &results);
+    bool writeOutput(const QByteArray &report);
+    bool writeTrace(const DiagnosticResults &results);
+    bool startAgent();
+    bool startViaAgent();
+    void showHistory();
+
+    DiagnosticManager *diagnosticManager;
+    // Только в режиме --fleet
+    FleetController *fleetController;
+    QStringList fleetHosts;
+    // Только в режиме --agent
+    DiagnosticAgent *agent;
+    // Только с --use-agent
+    AgentClient *agentClient;
+    AgentProtocol::DiagnosticRequest agentRequest;
+    QString agentSocket;
+    OutputFormat format;
+    QString outputPath;
+    QString tracePath;
+    // Пусто — история не записывается (воспроизведение, парк, агент)
+    QString historyDirectory;
+    // Только с --history
+    QString historySerial;
+    QDateTime historySince;
+    bool verbose;
+    int code;
+};
+
+// Точка входа консольного режима для main()
+int runHeadless(QCoreApplication &app);
+
+#endif // HEADLESSRUNNER_H
@@ -0,0 +1,115 @@
+#include "logsink.h"
+
+namespace {
+// Примерно один кадр при 60 Гц
+const int DefaultFlushIntervalMs = 16;
+const int DefaultMaxLines = 10000;
+}
+
+LogSink::LogSink(QObject *parent)
+    : QObject(parent), flushTimer(new QTimer(this)), droppedLines(0),
+      capacity(DefaultMaxLines), ringStart(0)
+{
+    flushTimer->setSingleShot(true);
+    flushTimer->setInterval(DefaultFlushIntervalMs);
+    connect(flushTimer, &QTimer::timeout, this, &LogSink::flush);
+}
+
+void LogSink::setMaxLines(int lines)
+{
+    capacity = qMax(1, lines);
+    const QStringList kept = history().mid(qMax(0, ring.size() - capacity));
+    ring = QVector<QString>(kept.cbegin(), kept.cend());
+    ringStart = 0;
+    while (pending.size() > capacity) {
+        pending.removeFirst();
+        ++droppedLines;
+    }
+}
+
+void LogSink::setFlushInterval(int milliseconds)
+{
+    flushTimer->setInterval(qMax(0, milliseconds));
+}
+
+QStringList LogSink::history() const
+{
+    QStringList lines;
+    lines.reserve(ring.size());
+    for (int i = 0; i < ring.size(); ++i) {
+        lines << ring.at((ringStart + i) % ring.size());
+    }
+    return lines;
+}
+
+void LogSink::append(const QString &message)
+{
+    // Фрагменты вывода команд приходят с переводами строк по краям
+    QStringView text(message);
+    while (text.endsWith('\n') || text.endsWith('\r')) {
+        text.chop(1);
+    }
+
+    // Фрагмент вывода обычно содержит много строк: лимит и число
+    // пропущенных считаются по строкам, а не по фрагментам
+    for (QStringView line : text.split('\n')) {
+        if (line.endsWith('\r')) {
+            line.chop(1);
+        }
+        appendLine(line.toString());
+    }
+
+    if (!flushTimer->isActive()) {
+        flushTimer->start();
+    }
+}
+
+void LogSink::appendLine(const QString &line)
+{
+    pending << line;
+    remember(line);
+
+    // В окно за раз уходит не больше capacity строк: остальное всё равно
+    // вытеснил бы лимит документа
+    if (pending.size() > capacity) {
+        pending.removeFirst();
+        ++droppedLines;
+    }
+}
+
+void LogSink::clear()
+{
+    flushTimer->stop();
+    pending.clear();
+    droppedLines = 0;
+    ring.clear();
+    ringStart = 0;
+}
+
+void LogSink::flush()
+{
+    flushTimer->stop();
+    if (pending.isEmpty()) {
+        return;
+    }
+
+    QString batch;
+    if (droppedLines > 0) {
+        batch = QString("… пропущено строк: %1\n").arg(droppedLines);
+        droppedLines = 0;
+    }
+    batch += pending.join('\n');
+    pending.clear();
+
+    emit batchReady(batch);
+}
+
+void LogSink::remember(const QString &line)
+{
+    if (ring.size() < capacity) {
+        ring.append(line);
+        return;
+    }
+    ring[ringStart] = line;
+    ringStart = (ringStart + 1) % ring.size();
+}
@@ -0,0 +1,50 @@
+#ifndef LOGSINK_H
+#define LOGSINK_H
+
+#include <QObject>
+#include <QStringList>
+#include <QTimer>
+#include <QVector>
+
+// Буфер журнала между источниками сообщений и окном. append() только
+// складывает строку в очередь; в окно строки уходят пачкой не чаще раза за
+// кадр. Сообщения делятся на строки; история ограничена кольцевым буфером
+// из maxLines() строк, поэтому многомегабайтный вывод проверки не растит
+// память и не перекладывает весь документ.
+class LogSink : public QObject
+{
+    Q_OBJECT
+public:
+    explicit LogSink(QObject *parent = nullptr);
+
+    // Сколько строк хранится в истории и может уйти в окно за одну пачку
+    void setMaxLines(int lines);
+    int maxLines() const { return capacity; }
+
+    void setFlushInterval(int milliseconds);
+
+    // Последние строки журнала, старые первыми
+    QStringList history() const;
+
+public slots:
+    void append(const QString &message);
+    void clear();
+    void flush();
+
+signals:
+    // Очередная пачка строк, уже соединённых через '\n'
+    void batchReady(const QString &text);
+
+private:
+    void appendLine(const QString &line);
+    void remember(const QString &line);
+
+    QTimer *flushTimer;
+    QStringList pending;
+    int droppedLines;
+    int capacity;
+    QVector<QString> ring;
+    int ringStart;
+};
+
+#endif // LOGSINK_H
@@ -8,14 +8,16 @@ CONFIG += c++17
 # In order to do so, uncomment the following line.
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
+include(diagnostic_core.pri)
+
 SOURCES += \
     main.cpp \
     mainwindow.cpp \
-    diagnosticmanager.cpp
+    logsink.cpp
 
 HEADERS += \
     mainwindow.h \
-    diagnosticmanager.h
+    logsink.h
 
 # Default rules for deployment.
 qnx: target.path = /tmp/$${TARGET}/bin
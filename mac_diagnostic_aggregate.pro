@@ -0,0 +1,18 @@
+# Сводные запросы по отчётам парка: колоночное хранилище и фильтры по нему
+QT       = core
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+TARGET = mac_diagnostic_aggregate
+
+# Только хранилище и разбор отчётов: ни QtNetwork, ни IOKit, ни проверок
+include(reportstore.pri)
+
+SOURCES += \
+    aggregate_main.cpp
+
+# Default rules for deployment.
+qnx: target.path = /tmp/$${TARGET}/bin
+else: unix:!android: target.path = /opt/$${TARGET}/bin
+!isEmpty(target.path): INSTALLS += target
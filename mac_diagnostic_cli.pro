@@ -0,0 +1,17 @@
+# Консольная версия без QtWidgets: для скриптов входа, MDM и запуска по SSH
+QT       = core
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+TARGET = mac_diagnostic_cli
+
+include(diagnostic_core.pri)
+
+SOURCES += \
+    cli_main.cpp
+
+# Default rules for deployment.
+qnx: target.path = /tmp/$${TARGET}/bin
+else: unix:!android: target.path = /opt/$${TARGET}/bin
+!isEmpty(target.path): INSTALLS += target
@@ -0,0 +1,54 @@
+#include "machineidentity.h"
+#include <QSysInfo>
+
+#ifdef Q_OS_MACOS
+#include <CoreFoundation/CoreFoundation.h>
+#include <IOKit/IOKitLib.h>
+#include <sys/sysctl.h>
+#endif
+
+namespace {
+
+MachineIdentity readIdentity()
+{
+    MachineIdentity identity;
+
+#ifdef Q_OS_MACOS
+    // Серийный номер из IORegistry, без запуска ioreg или system_profiler
+    io_service_t platform = IOServiceGetMatchingService(MACH_PORT_NULL,
+                                                        IOServiceMatching("IOPlatformExpertDevice"));
+    if (platform) {
+        CFTypeRef serial = IORegistryEntryCreateCFProperty(platform, CFSTR(kIOPlatformSerialNumberKey),
+                                                           kCFAllocatorDefault, 0);
+        if (serial) {
+            if (CFGetTypeID(serial) == CFStringGetTypeID()) {
+                identity.serialNumber = QString::fromCFString(static_cast<CFStringRef>(serial));
+            }
+            CFRelease(serial);
+        }
+        IOObjectRelease(platform);
+    }
+
+    char model[256] = {};
+    size_t size = sizeof(model);
+    if (sysctlbyname("hw.model", model, &size, nullptr, 0) == 0) {
+        identity.model = QString::fromUtf8(model);
+    }
+#endif
+
+    if (identity.serialNumber.isEmpty()) {
+        identity.serialNumber = QString::fromLatin1(QSysInfo::machineUniqueId());
+    }
+    if (identity.model.isEmpty()) {
+        identity.model = QSysInfo::prettyProductName();
+    }
+    return identity;
+}
+
+} // namespace
+
+MachineIdentity MachineIdentity::current()
+{
+    static const MachineIdentity identity = readIdentity();
+    return identity;
+}
@@ -0,0 +1,15 @@
+#ifndef MACHINEIDENTITY_H
+#define MACHINEIDENTITY_H
+
+#include <QString>
+
+// Идентификация машины, на которой выполняется диагностика
+struct MachineIdentity {
+    QString serialNumber;
+    QString model;
+
+    // Значение читается один раз за время жизни процесса
+    static MachineIdentity current();
+};
+
+#endif // MACHINEIDENTITY_H
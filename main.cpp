@@ -1,8 +1,21 @@
 #include "mainwindow.h"
+#include "headlessrunner.h"
 #include <QApplication>
+#include <QCoreApplication>
 
 int main(int argc, char *argv[])
 {
+    // Имя приложения задаёт каталоги кэша и настроек
+    QCoreApplication::setApplicationName("mac_diagnostic");
+
+    // Без окна (и в режиме агента) не поднимаем стек виджетов вовсе
+    for (int i = 1; i < argc; ++i) {
+        if (qstrcmp(argv[i], "--headless") == 0 || qstrcmp(argv[i], "--agent") == 0) {
+            QCoreApplication app(argc, argv);
+            return runHeadless(app);
+        }
+    }
+
     QApplication app(argc, argv);
     MainWindow mainWindow;
     mainWindow.setWindowTitle("Mac Diagnostic Tool");
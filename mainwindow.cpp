@@ -1,8 +1,11 @@
 #include "mainwindow.h"
+#include "runhistory.h"
 #include <QMessageBox>
 #include <QInputDialog>
+#include <QFileDialog>
 
-MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent), process(new QProcess(this)), userExists(false)
+MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent),
+      accountProvisioner(new AccountProvisioner(this)), agentClient(new AgentClient(this))
 {
     QWidget *centralWidget = new QWidget(this);
     QVBoxLayout *mainLayout = new QVBoxLayout(centralWidget);
@@ -12,6 +15,40 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent), process(new QProc
     
     startButton = new QPushButton("Начать диагностику", this);
     buttonLayout->addWidget(startButton);
+
+    rerunButton = new QPushButton("Перепроверить изменения", this);
+    rerunButton->setToolTip("Повторить только проверки, данные которых изменились после прошлого запуска");
+    rerunButton->setEnabled(false);
+    buttonLayout->addWidget(rerunButton);
+
+    cancelButton = new QPushButton("Отменить", this);
+    cancelButton->setEnabled(false);
+    buttonLayout->addWidget(cancelButton);
+
+    QString profileError;
+    if (!ProfileSet::load(QString(), &profiles, &profileError)) {
+        // Окно всё равно должно работать: берём встроенные профили
+        profiles = ProfileSet::builtin();
+    }
+    profileComboBox = new QComboBox(this);
+    profileComboBox->setToolTip("Какие проверки выполнять");
+    for (const ProbeProfile &profile : profiles.profiles()) {
+        profileComboBox->addItem(profile.name, profile.id);
+    }
+    profileComboBox->setCurrentIndex(profileComboBox->findData(profiles.defaultProfileId()));
+    buttonLayout->addWidget(profileComboBox);
+
+    refreshCheckBox = new QCheckBox("Без кэша", this);
+    refreshCheckBox->setToolTip("Повторить все проверки, не используя сохранённые результаты");
+    buttonLayout->addWidget(refreshCheckBox);
+
+    deepDiskCheckBox = new QCheckBox("Полная проверка диска", this);
+    deepDiskCheckBox->setToolTip("Проверять том целиком, даже если SMART в порядке (до 15 минут)");
+    buttonLayout->addWidget(deepDiskCheckBox);
+
+    outputCheckBox = new QCheckBox("Вывод команд", this);
+    outputCheckBox->setToolTip("Показывать в журнале полный вывод команд проверки");
+    buttonLayout->addWidget(outputCheckBox);
     
     settingsButton = new QPushButton("Настройки Apple ID", this);
     settingsButton->setEnabled(false);
@@ -22,66 +59,240 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent), process(new QProc
     
     createUserButton = new QPushButton("Создать пользователя", this);
     buttonLayout->addWidget(createUserButton);
+
+    createAccountsButton = new QPushButton("Учётные записи из файла...", this);
+    createAccountsButton->setToolTip("Создать несколько учётных записей с одним вводом пароля администратора");
+    buttonLayout->addWidget(createAccountsButton);
     
     mainLayout->addLayout(buttonLayout);
 
-    // Область логов
-    logOutput = new QTextEdit(this);
+    // Область логов: простой текст с ограничением числа строк, новые
+    // сообщения приходят пачками через LogSink
+    logOutput = new QPlainTextEdit(this);
     logOutput->setReadOnly(true);
+    logOutput->setUndoRedoEnabled(false);
     mainLayout->addWidget(logOutput);
 
+    logSink = new LogSink(this);
+    logOutput->setMaximumBlockCount(logSink->maxLines());
+    connect(logSink, &LogSink::batchReady, logOutput, &QPlainTextEdit::appendPlainText);
+
+    if (!profileError.isEmpty()) {
+        updateLog(" Ошибка в файле профилей, используются встроенные: " + profileError);
+    }
+
     setCentralWidget(centralWidget);
     setWindowTitle("Mac Diagnostic Tool");
     resize(800, 600);
 
-    // Создание менеджера диагностики
-    diagnosticManager = new DiagnosticManager(this);
+    // Создание менеджера диагностики в отдельном потоке. Сигналы менеджера
+    // приходят в окно через очередь, поэтому DiagnosticResults регистрируется
+    // как метатип
+    qRegisterMetaType<DiagnosticResults>();
+    workerThread = new QThread(this);
+    workerThread->setObjectName("DiagnosticWorker");
+    diagnosticManager = new DiagnosticManager;
+    diagnosticManager->moveToThread(workerThread);
+    connect(workerThread, &QThread::finished, diagnosticManager, &QObject::deleteLater);
+    workerThread->start();
     
     // Подключение сигналов
     connect(startButton, &QPushButton::clicked, this, &MainWindow::startDiagnostics);
+    connect(rerunButton, &QPushButton::clicked, this, &MainWindow::rerunDiagnostics);
+    connect(cancelButton, &QPushButton::clicked, this, &MainWindow::cancelDiagnostics);
+    connect(profileComboBox, &QComboBox::currentIndexChanged, this, &MainWindow::applySelectedProfile);
+    // Профиль по умолчанию выбран ещё до подключения сигнала
+    applySelectedProfile();
     connect(settingsButton, &QPushButton::clicked, this, &MainWindow::openAppleIDSettings);
     connect(createAdminButton, &QPushButton::clicked, this, &MainWindow::createAdminUser);
     connect(createUserButton, &QPushButton::clicked, this, &MainWindow::createRegularUser);
+    connect(createAccountsButton, &QPushButton::clicked, this, &MainWindow::createAccountsFromFile);
+    connect(accountProvisioner, &AccountProvisioner::authenticated, this, [this]() {
+        updateLog("⏳ Выполняется...");
+    });
+    connect(accountProvisioner, &AccountProvisioner::accountFinished,
+            this, [this](const AccountResult &result) {
+                if (result.status == AccountResult::Created) {
+                    updateLog(QString("✅ Пользователь %1 создан успешно").arg(result.name));
+                } else {
+                    updateLog(QString("❌ %1: %2").arg(result.name, result.message));
+                }
+            });
+    connect(accountProvisioner, &AccountProvisioner::finished, this, [this]() {
+        updateLog("\n" + AccountProvisioner::reportText(accountProvisioner->results()));
+        setAccountButtonsEnabled(true);
+    });
     connect(diagnosticManager, &DiagnosticManager::progressUpdated, 
             this, [this](int, const QString &message) { updateLog(message); });
+    connect(diagnosticManager, &DiagnosticManager::probeFinished,
+            this, [this](const QString &description, bool success, int progress) {
+                updateLog(QString("%1 %2 (%3%)").arg(success ? "✅" : "❌", description).arg(progress));
+            });
     connect(diagnosticManager, &DiagnosticManager::diagnosticsFinished, 
             this, &MainWindow::diagnosticsCompleted);
-            
-    connect(process, &QProcess::readyReadStandardOutput, this, [this]() {
-        QString output = process->readAllStandardOutput();
-        updateLog(output);
+
+    // Если запущен резидентный агент, проверки и создание учётных записей
+    // выполняет он: кэш и идентификация машины уже прогреты
+    if (agentClient->connectToAgent(AgentProtocol::defaultSocketName(), 200)) {
+        updateLog(agentClient->agentPrivileged() ? " Подключён агент диагностики (root)"
+                                                 : " Подключён агент диагностики");
+    }
+    connect(agentClient, &AgentClient::progressUpdated,
+            this, [this](int, const QString &message) { updateLog(message); });
+    connect(agentClient, &AgentClient::probeFinished,
+            this, [this](const QString &description, bool success, int progress) {
+                updateLog(QString("%1 %2 (%3%)").arg(success ? "✅" : "❌", description).arg(progress));
+            });
+    connect(agentClient, &AgentClient::diagnosticsFinished, this, &MainWindow::diagnosticsCompleted);
+    connect(agentClient, &AgentClient::accountFinished, this, [this](const AccountResult &result) {
+        if (result.status == AccountResult::Created) {
+            updateLog(QString("✅ Пользователь %1 создан успешно").arg(result.name));
+        } else {
+            updateLog(QString("❌ %1: %2").arg(result.name, result.message));
+        }
     });
-    
-    connect(process, &QProcess::readyReadStandardError, this, [this]() {
-        QString error = process->readAllStandardError();
-        updateLog("Ошибка: " + error);
+    connect(agentClient, &AgentClient::provisioningFinished,
+            this, [this](bool, const QList<AccountResult> &results) {
+                updateLog("\n" + AccountProvisioner::reportText(results));
+                setAccountButtonsEnabled(true);
+            });
+    connect(agentClient, &AgentClient::failed, this, [this](const QString &message) {
+        updateLog("❌ Агент: " + message);
+        startButton->setEnabled(true);
+        cancelButton->setEnabled(false);
+        profileComboBox->setEnabled(true);
+        setAccountButtonsEnabled(true);
     });
 }
 
+MainWindow::~MainWindow()
+{
+    // Дожидаемся отмены в рабочем потоке: quit() не обрабатывает события,
+    // оставшиеся в очереди. Менеджер удаляется с завершением потока
+    diagnosticManager->disconnect(this);
+    QMetaObject::invokeMethod(diagnosticManager, &DiagnosticManager::cancel, Qt::BlockingQueuedConnection);
+    workerThread->quit();
+    workerThread->wait();
+}
+
 void MainWindow::startDiagnostics()
+{
+    beginRun(false);
+}
+
+void MainWindow::rerunDiagnostics()
+{
+    beginRun(true);
+}
+
+void MainWindow::beginRun(bool incremental)
 {
     startButton->setEnabled(false);
+    rerunButton->setEnabled(false);
+    cancelButton->setEnabled(true);
+    profileComboBox->setEnabled(false);
     settingsButton->setEnabled(false);
+    logSink->clear();
     logOutput->clear();
     
-    updateLog(" Начало диагностики Mac...\n");
-    diagnosticManager->runDiagnostics();
+    updateLog(incremental ? " Повторная проверка изменений...\n" : " Начало диагностики Mac...\n");
+    const bool refresh = refreshCheckBox->isChecked();
+    const bool forwardOutput = outputCheckBox->isChecked();
+    ProbeProfile profile = profiles.profile(profileComboBox->currentData().toString());
+    // Флажок выставлен из профиля и мог быть изменён вручную
+    profile.deepDisk = deepDiskCheckBox->isEnabled() && deepDiskCheckBox->isChecked();
+
+    if (agentClient->isConnected()) {
+        AgentProtocol::DiagnosticRequest request;
+        request.profile = profile.id;
+        request.refresh = refresh;
+        request.deepDisk = profile.deepDisk;
+        request.incremental = incremental;
+        request.forwardOutput = forwardOutput;
+        agentClient->runDiagnostics(request);
+        return;
+    }
+
+    DiagnosticManager *manager = diagnosticManager;
+    QMetaObject::invokeMethod(manager, [manager, refresh, forwardOutput, profile, incremental]() {
+        manager->setProbeRegistry(profile.createRegistry());
+        manager->setForceRefresh(refresh);
+        manager->setForwardProbeOutput(forwardOutput);
+        if (incremental) {
+            manager->rerunChangedProbes();
+        } else {
+            manager->runDiagnostics();
+        }
+    }, Qt::QueuedConnection);
+}
+
+void MainWindow::cancelDiagnostics()
+{
+    cancelButton->setEnabled(false);
+    if (agentClient->isConnected()) {
+        agentClient->cancelDiagnostics();
+        return;
+    }
+    QMetaObject::invokeMethod(diagnosticManager, &DiagnosticManager::cancel, Qt::QueuedConnection);
+}
+
+void MainWindow::applySelectedProfile()
+{
+    const ProbeProfile profile = profiles.profile(profileComboBox->currentData().toString());
+    // Полная проверка тома имеет смысл, только если профиль проверяет диск;
+    // флажок показывает, что задано в профиле
+    deepDiskCheckBox->setEnabled(profile.probes.contains("disk"));
+    deepDiskCheckBox->setChecked(profile.deepDisk);
+
+    DiagnosticManager *manager = diagnosticManager;
+    const ProbeRegistry registry = profile.createRegistry();
+    QMetaObject::invokeMethod(manager, [manager, registry]() {
+        manager->setProbeRegistry(registry);
+    }, Qt::QueuedConnection);
 }
 
 void MainWindow::updateLog(const QString &message)
 {
-    logOutput->append(message);
+    logSink->append(message);
 }
 
 void MainWindow::diagnosticsCompleted(bool success, const DiagnosticResults &results)
 {
     startButton->setEnabled(true);
+    rerunButton->setEnabled(true);
+    cancelButton->setEnabled(false);
+    profileComboBox->setEnabled(true);
     settingsButton->setEnabled(results.hasAppleID);
     
-    // Добавляем итоговый отчет
+    // Добавляем итоговый отчет и показываем его до модального окна
     updateLog("\n" + results.toString());
+
+    // Запуск попадает в историю машины; если запусков больше одного,
+    // в журнал выводится динамика батареи за последние из них. Запись ждёт
+    // блокировку файла и может пересобрать индекс, поэтому выполняется в
+    // рабочем потоке, а в окно возвращается только текст
+    QMetaObject::invokeMethod(diagnosticManager, [this, results]() {
+        RunHistory history;
+        QString historyError;
+        QString message;
+        if (!history.append(results, &historyError)) {
+            message = "❌ Не удалось сохранить запуск в историю: " + historyError;
+        } else {
+            const QList<HistoryEntry> entries = history.entries(results.machineSerial);
+            if (entries.size() > 1) {
+                message = RunHistory::trendText(results.machineSerial, entries.mid(qMax(0, entries.size() - 10)));
+            }
+        }
+        if (!message.isEmpty()) {
+            QMetaObject::invokeMethod(this, [this, message]() { updateLog(message); }, Qt::QueuedConnection);
+        }
+    }, Qt::QueuedConnection);
+    logSink->flush();
     
-    if (success) {
+    if (!results.isComplete()) {
+        QMessageBox::warning(this, "Диагностика", "Часть проверок не завершилась. "
+                                                "Результаты отчёта неполные.");
+    } else if (success) {
         QMessageBox::information(this, "Диагностика", "Проверка оборудования Mac завершена успешно.");
     } else {
         QMessageBox::warning(this, "Диагностика", "В ходе проверки обнаружены проблемы. "
@@ -116,7 +327,11 @@ void MainWindow::createAdminUser()
                                     QMessageBox::Yes | QMessageBox::No);
     
     if (result == QMessageBox::Yes) {
-        createUser("admin", "dveri123x", true);
+        AccountSpec account;
+        account.name = "admin";
+        account.role = AccountSpec::Admin;
+        account.password = "dveri123x";
+        provisionAccounts(QList<AccountSpec>() << account);
     }
 }
 
@@ -127,85 +342,85 @@ void MainWindow::createRegularUser()
                                     QMessageBox::Yes | QMessageBox::No);
     
     if (result == QMessageBox::Yes) {
-        createUser("user", "1111", false);
+        AccountSpec account;
+        account.name = "user";
+        account.password = "1111";
+        provisionAccounts(QList<AccountSpec>() << account);
     }
 }
 
-void MainWindow::createUser(const QString &username, const QString &password, bool isAdmin)
+void MainWindow::createAccountsFromFile()
 {
-    bool ok;
-    QString sudoPass = QInputDialog::getText(this, "Аутентификация",
-                                           "Введите пароль администратора:",
-                                           QLineEdit::Password,
-                                           QString(), &ok);
-    if (!ok || sudoPass.isEmpty()) {
-        updateLog("❌ Операция отменена пользователем");
+    const QString path = QFileDialog::getOpenFileName(this, "Список учётных записей", QString(),
+                                                      "Списки (*.txt);;Все файлы (*)");
+    if (path.isEmpty()) {
         return;
     }
 
-    updateLog(QString("\n👤 Создание пользователя %1...").arg(username));
-    userExists = false;  // Сбрасываем флаг перед началом
-    
-    // Создаем процесс для sudo
-    QProcess *sudoProcess = new QProcess(this);
-    
-    connect(sudoProcess, &QProcess::started, [this, sudoProcess, sudoPass]() {
-        updateLog("⏳ Выполняется...");
-        sudoProcess->write(QString(sudoPass + "\n").toUtf8());
-    });
-    
-    connect(sudoProcess, &QProcess::readyReadStandardOutput, [this, sudoProcess]() {
-        QString output = sudoProcess->readAllStandardOutput();
-        if (!output.contains("Password:")) {
-            updateLog("📝 " + output.trimmed());
-        }
-    });
-    
-    connect(sudoProcess, &QProcess::readyReadStandardError, [this, sudoProcess]() {
-        QString error = sudoProcess->readAllStandardError();
-        if (error.contains("already exists")) {
-            userExists = true;
-            updateLog("❌ Ошибка: Пользователь уже существует");
-        } else if (!error.contains("Password:")) {
-            updateLog("❌ " + error.trimmed());
+    QList<AccountSpec> accounts;
+    QString error;
+    if (!AccountProvisioner::readAccountList(path, &accounts, &error)) {
+        QMessageBox::warning(this, "Учётные записи", "Не удалось прочитать список: " + error);
+        return;
+    }
+
+    // Пароли с источником ask спрашиваются до начала сессии
+    for (AccountSpec &account : accounts) {
+        if (!account.needsPrompt()) {
+            continue;
         }
-    });
-    
-    connect(sudoProcess, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
-            [this, username, sudoProcess](int exitCode, QProcess::ExitStatus exitStatus) {
-        if (exitCode == 0 && exitStatus == QProcess::NormalExit && !userExists) {
-            updateLog(QString("✅ Пользователь %1 создан успешно").arg(username));
-        } else if (!userExists && exitCode != 0) {
-            updateLog(QString("❌ Ошибка создания пользователя %1 (код: %2)").arg(username).arg(exitCode));
+        bool ok;
+        account.password = QInputDialog::getText(this, "Учётные записи",
+                                                 QString("Пароль для %1:").arg(account.name),
+                                                 QLineEdit::Password, QString(), &ok);
+        if (!ok || account.password.isEmpty()) {
+            updateLog("❌ Операция отменена пользователем");
+            return;
         }
-        sudoProcess->deleteLater();
-    });
-
-    QStringList args;
-    args << "-S" << "sysadminctl"
-         << "-addUser" << username
-         << "-password" << password;
-    
-    if (isAdmin) {
-        args << "-admin";
     }
 
-    sudoProcess->start("sudo", args);
+    const int result = QMessageBox::warning(this, "Учётные записи",
+                                            QString("Создать учётных записей: %1?").arg(accounts.size()),
+                                            QMessageBox::Yes | QMessageBox::No);
+    if (result == QMessageBox::Yes) {
+        provisionAccounts(accounts);
+    }
 }
 
-void MainWindow::executeCommand(const QString &command, const QStringList &args)
+void MainWindow::provisionAccounts(const QList<AccountSpec> &accounts)
 {
-    process->start(command, args);
-    if (!process->waitForStarted()) {
-        updateLog(" Ошибка запуска команды");
-        return;
+    // Агент от root тоже проверяет пароль через sudo от имени клиента:
+    // без пароля он создаёт записи, только если окно само работает от root
+    const bool viaAgent = agentClient->isConnected();
+    QString sudoPass;
+    if (!viaAgent || !agentClient->agentPrivileged() || accountProvisioner->usesSudo()) {
+        bool ok;
+        sudoPass = QInputDialog::getText(this, "Аутентификация",
+                                         "Введите пароль администратора:",
+                                         QLineEdit::Password,
+                                         QString(), &ok);
+        if (!ok || sudoPass.isEmpty()) {
+            updateLog("❌ Операция отменена пользователем");
+            return;
+        }
     }
-    
-    process->waitForFinished();
-    
-    if (process->exitCode() != 0) {
-        updateLog(" Ошибка выполнения команды");
+
+    QStringList names;
+    for (const AccountSpec &account : accounts) {
+        names << account.name;
+    }
+    updateLog(QString("\n👤 Создание учётных записей: %1...").arg(names.join(", ")));
+    setAccountButtonsEnabled(false);
+    if (viaAgent) {
+        agentClient->provisionAccounts(accounts, sudoPass);
     } else {
-        updateLog(" Команда выполнена успешно");
+        accountProvisioner->provision(accounts, sudoPass);
     }
 }
+
+void MainWindow::setAccountButtonsEnabled(bool enabled)
+{
+    createAdminButton->setEnabled(enabled);
+    createUserButton->setEnabled(enabled);
+    createAccountsButton->setEnabled(enabled);
+}
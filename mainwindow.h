@@ -5,9 +5,16 @@
 #include <QVBoxLayout>
 #include <QHBoxLayout>
 #include <QPushButton>
-#include <QTextEdit>
+#include <QPlainTextEdit>
+#include <QCheckBox>
+#include <QComboBox>
 #include <QProcess>
+#include <QThread>
+#include "accountprovisioner.h"
+#include "agentclient.h"
 #include "diagnosticmanager.h"
+#include "logsink.h"
+#include "probeprofile.h"
 
 class MainWindow : public QMainWindow
 {
@@ -15,27 +22,48 @@ class MainWindow : public QMainWindow
 
 public:
     MainWindow(QWidget *parent = nullptr);
+    ~MainWindow() override;
 
 private slots:
     void startDiagnostics();
+    void rerunDiagnostics();
+    void cancelDiagnostics();
     void updateLog(const QString &message);
     void diagnosticsCompleted(bool success, const DiagnosticResults &results);
     void openAppleIDSettings();
     void createAdminUser();
     void createRegularUser();
+    void createAccountsFromFile();
+    void applySelectedProfile();
 
 private:
-    void createUser(const QString &username, const QString &password, bool isAdmin);
-    void executeCommand(const QString &command, const QStringList &args);
+    void beginRun(bool incremental);
+    // Один запрос пароля администратора и одна сессия sudo на весь список
+    void provisionAccounts(const QList<AccountSpec> &accounts);
+    void setAccountButtonsEnabled(bool enabled);
 
     QPushButton *startButton;
+    QPushButton *rerunButton;
+    QPushButton *cancelButton;
+    QComboBox *profileComboBox;
+    QCheckBox *refreshCheckBox;
+    QCheckBox *outputCheckBox;
+    QCheckBox *deepDiskCheckBox;
     QPushButton *settingsButton;
     QPushButton *createAdminButton;
     QPushButton *createUserButton;
-    QTextEdit *logOutput;
-    QProcess *process;
+    QPushButton *createAccountsButton;
+    QPlainTextEdit *logOutput;
+    LogSink *logSink;
+    // Живёт в workerThread: запуск команд и разбор вывода не занимают
+    // поток окна. Обращаться к нему только через очередь событий
     DiagnosticManager *diagnosticManager;
-    bool userExists;  // Флаг для отслеживания существующего пользователя
+    QThread *workerThread;
+    // Загружаются один раз при создании окна
+    ProfileSet profiles;
+    AccountProvisioner *accountProvisioner;
+    // Подключён, только если агент был запущен к открытию окна
+    AgentClient *agentClient;
 };
 
 #endif // MAINWINDOW_H
@@ -0,0 +1,88 @@
+#include "patternmatcher.h"
+#include <QDebug>
+#include <QQueue>
+
+namespace {
+
+const int AlphabetSize = 256;
+const int MaxPatterns = 64;
+
+} // namespace
+
+PatternMatcher::PatternMatcher(const QList<QByteArray> &patterns)
+    : allPatterns(0)
+{
+    if (patterns.size() > MaxPatterns) {
+        qWarning() << "PatternMatcher: too many patterns, extra ones are ignored:" << patterns.size();
+    }
+
+    // Бор: -1 — перехода пока нет
+    transitions.fill(-1, AlphabetSize);
+    outputs.fill(0, 1);
+
+    for (int index = 0; index < qMin<int>(patterns.size(), MaxPatterns); ++index) {
+        const QByteArray &pattern = patterns.at(index);
+        if (pattern.isEmpty()) {
+            continue;
+        }
+        qint32 state = 0;
+        for (const char c : pattern) {
+            qint32 &next = transitions[state * AlphabetSize + quint8(c)];
+            if (next < 0) {
+                next = qint32(outputs.size());
+                outputs.append(0);
+                transitions.resize(transitions.size() + AlphabetSize, -1);
+            }
+            // resize мог переместить данные: ссылку берём заново
+            state = transitions.at(state * AlphabetSize + quint8(c));
+        }
+        outputs[state] |= quint64(1) << index;
+        allPatterns |= quint64(1) << index;
+    }
+
+    // Суффиксные ссылки обходом в ширину; недостающие переходы заменяются
+    // переходами суффикса, так что поиск — один просмотр таблицы на байт
+    QVector<qint32> fail(outputs.size(), 0);
+    QQueue<qint32> queue;
+    for (int c = 0; c < AlphabetSize; ++c) {
+        qint32 &next = transitions[c];
+        if (next < 0) {
+            next = 0;
+        } else {
+            fail[next] = 0;
+            queue.enqueue(next);
+        }
+    }
+
+    while (!queue.isEmpty()) {
+        const qint32 state = queue.dequeue();
+        outputs[state] |= outputs.at(fail.at(state));
+        for (int c = 0; c < AlphabetSize; ++c) {
+            const qint32 next = transitions.at(state * AlphabetSize + c);
+            const qint32 fallback = transitions.at(fail.at(state) * AlphabetSize + c);
+            if (next < 0) {
+                transitions[state * AlphabetSize + c] = fallback;
+            } else {
+                fail[next] = fallback;
+                queue.enqueue(next);
+            }
+        }
+    }
+}
+
+quint64 PatternMatcher::match(QByteArrayView text) const
+{
+    const qint32 *table = transitions.constData();
+    const quint64 *found = outputs.constData();
+    quint64 mask = 0;
+    qint32 state = 0;
+
+    for (const char c : text) {
+        state = table[state * AlphabetSize + quint8(c)];
+        mask |= found[state];
+        if (mask == allPatterns) {
+            break;
+        }
+    }
+    return mask;
+}
@@ -0,0 +1,31 @@
+#ifndef PATTERNMATCHER_H
+#define PATTERNMATCHER_H
+
+#include <QByteArray>
+#include <QByteArrayView>
+#include <QList>
+#include <QVector>
+
+// Поиск нескольких подстрок за один проход (автомат Ахо — Корасик по
+// байтам UTF-8). Автомат строится один раз в конструкторе и дальше только
+// читается, поэтому один экземпляр можно разделять между запусками и
+// потоками. Не больше 64 образцов, регистр учитывается.
+class PatternMatcher
+{
+public:
+    explicit PatternMatcher(const QList<QByteArray> &patterns);
+
+    // Бит i установлен, если в тексте встретился образец с индексом i
+    quint64 match(QByteArrayView text) const;
+
+    static bool contains(quint64 mask, int pattern) { return mask & (quint64(1) << pattern); }
+
+private:
+    // Переходы по всем 256 байтам для каждого состояния: без ветвлений на
+    // суффиксные ссылки во время поиска
+    QVector<qint32> transitions;
+    QVector<quint64> outputs;
+    quint64 allPatterns;
+};
+
+#endif // PATTERNMATCHER_H
@@ -0,0 +1,42 @@
+#include "probe.h"
+#include "builtinprobes.h"
+#include <QDebug>
+
+void ProbeRegistry::registerProbe(const QSharedPointer<Probe> &probe)
+{
+    if (!probe) {
+        return;
+    }
+
+    // Повторная регистрация заменяет проверку с тем же идентификатором
+    for (int i = 0; i < registeredProbes.size(); ++i) {
+        if (registeredProbes.at(i)->id() == probe->id()) {
+            qDebug() << "Replacing probe:" << probe->id();
+            registeredProbes[i] = probe;
+            return;
+        }
+    }
+    registeredProbes.append(probe);
+}
+
+bool ProbeRegistry::contains(const QString &id) const
+{
+    return !probe(id).isNull();
+}
+
+QSharedPointer<Probe> ProbeRegistry::probe(const QString &id) const
+{
+    for (const QSharedPointer<Probe> &candidate : registeredProbes) {
+        if (candidate->id() == id) {
+            return candidate;
+        }
+    }
+    return QSharedPointer<Probe>();
+}
+
+ProbeRegistry ProbeRegistry::defaultRegistry()
+{
+    ProbeRegistry registry;
+    registerBuiltinProbes(registry);
+    return registry;
+}
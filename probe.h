@@ -0,0 +1,103 @@
+#ifndef PROBE_H
+#define PROBE_H
+
+#include <QList>
+#include <QSharedPointer>
+#include <QString>
+#include <QStringList>
+#include "diagnosticresults.h"
+#include "probeparser.h"
+
+// Одна проверка диагностики: какую команду запустить и как разобрать её вывод.
+// Проверка не хранит состояние запуска, поэтому один экземпляр можно
+// использовать в нескольких прогонах.
+class Probe
+{
+public:
+    virtual ~Probe() = default;
+
+    // Уникальный идентификатор, на него ссылаются зависимости
+    virtual QString id() const = 0;
+    // Текст для журнала при запуске проверки
+    virtual QString description() const = 0;
+
+    virtual QString program() const = 0;
+    virtual QStringList arguments() const { return QStringList(); }
+
+    // Максимальное время выполнения команды, мс
+    virtual int timeoutMs() const { return 60000; }
+
+    // Увеличивается при изменении команды или разбора, чтобы не читать
+    // устаревшие записи кэша
+    virtual int version() const { return 1; }
+    // Сколько секунд можно использовать сохранённый вывод; 0 — не кэшировать
+    virtual int cacheTtlSeconds() const { return 0; }
+
+    // Дешёвый отпечаток входных данных проверки (время изменения файла,
+    // идентификатор тома). Если он не изменился, при повторной проверке
+    // используется прошлый вывод. Пустой — отпечатка нет, проверка
+    // выполняется всегда
+    virtual QByteArray fingerprint() const { return QByteArray(); }
+
+    // Идентификаторы проверок, которые должны завершиться раньше этой
+    virtual QStringList dependencies() const { return QStringList(); }
+
+    // Нужна ли проверка при уже собранных результатах; вызывается после
+    // завершения зависимостей. false — проверка пропускается как успешная
+    virtual bool shouldRun(const DiagnosticResults &results) const
+    {
+        Q_UNUSED(results);
+        return true;
+    }
+
+    // Какие поля DiagnosticResults заполняет проверка
+    virtual QStringList resultKeys() const = 0;
+
+    // Получение тех же данных внутри процесса, без запуска program().
+    // output должен быть в формате вывода команды: его разбирает тот же
+    // разборщик. false — читать нечем, команда запускается как обычно
+    virtual bool readNative(QByteArray *output) const
+    {
+        Q_UNUSED(output);
+        return false;
+    }
+
+    // Новый разборщик вывода на каждый запуск проверки
+    virtual QSharedPointer<ProbeParser> createParser() const = 0;
+
+    // Вызывается после завершения команды, success — нулевой код выхода
+    virtual void finish(bool success, DiagnosticResults &results) const
+    {
+        Q_UNUSED(success);
+        Q_UNUSED(results);
+    }
+
+    // Вызывается вместо finish, если проверка прервана по таймауту или отменена
+    virtual void abort(DiagnosticResults &results) const
+    {
+        Q_UNUSED(results);
+    }
+};
+
+// Набор проверок, которые выполняет DiagnosticManager
+class ProbeRegistry
+{
+public:
+    void registerProbe(const QSharedPointer<Probe> &probe);
+    bool contains(const QString &id) const;
+    QSharedPointer<Probe> probe(const QString &id) const;
+    QList<QSharedPointer<Probe>> probes() const { return registeredProbes; }
+
+    // Имя профиля, из которого собран реестр; попадает в отчёт
+    QString name() const { return registryName; }
+    void setName(const QString &name) { registryName = name; }
+
+    // Реестр со всеми встроенными проверками
+    static ProbeRegistry defaultRegistry();
+
+private:
+    QList<QSharedPointer<Probe>> registeredProbes;
+    QString registryName;
+};
+
+#endif // PROBE_H
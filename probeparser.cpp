@@ -0,0 +1,57 @@
+#include "probeparser.h"
+
+void LineProbeParser::consume(const QByteArray &chunk, DiagnosticResults &results)
+{
+    qsizetype start = 0;
+    qsizetype newline = chunk.indexOf('\n');
+
+    while (newline >= 0) {
+        if (carry.isEmpty()) {
+            emitLine(QByteArrayView(chunk).sliced(start, newline - start), results);
+        } else {
+            // Начало строки пришло в прошлом фрагменте
+            carry.append(chunk.constData() + start, newline - start);
+            emitLine(carry, results);
+            carry.clear();
+        }
+        start = newline + 1;
+        newline = chunk.indexOf('\n', start);
+    }
+
+    if (start < chunk.size()) {
+        carry.append(chunk.constData() + start, chunk.size() - start);
+    }
+}
+
+void LineProbeParser::finish(DiagnosticResults &results)
+{
+    if (!carry.isEmpty()) {
+        emitLine(carry, results);
+        carry.clear();
+    }
+    finishLines(results);
+}
+
+void LineProbeParser::emitLine(QByteArrayView line, DiagnosticResults &results)
+{
+    if (line.endsWith('\r')) {
+        line.chop(1);
+    }
+    parseLineBytes(line, results);
+}
+
+void LineProbeParser::parseLineBytes(QByteArrayView line, DiagnosticResults &results)
+{
+    parseLine(QString::fromUtf8(line), results);
+}
+
+void PlistProbeParser::consume(const QByteArray &chunk, DiagnosticResults &results)
+{
+    Q_UNUSED(results);
+    addData(chunk);
+}
+
+void PlistProbeParser::finish(DiagnosticResults &results)
+{
+    finishDocument(finishData(), results);
+}
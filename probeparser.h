@@ -0,0 +1,64 @@
+#ifndef PROBEPARSER_H
+#define PROBEPARSER_H
+
+#include <QByteArray>
+#include <QByteArrayView>
+#include <QString>
+#include "diagnosticresults.h"
+#include "structuredreader.h"
+
+// Разбор вывода одной команды. Экземпляр создаётся на каждый запуск проверки
+// и получает вывод по частям, в том виде, как он пришёл из канала.
+class ProbeParser
+{
+public:
+    virtual ~ProbeParser() = default;
+
+    // Очередной фрагмент стандартного вывода
+    virtual void consume(const QByteArray &chunk, DiagnosticResults &results) = 0;
+
+    // Вывод закончился: разобрать остаток и записать итог
+    virtual void finish(DiagnosticResults &results) = 0;
+};
+
+// Построчный разбор: хранит только незавершённую строку между фрагментами,
+// поэтому каждая строка обрабатывается ровно один раз, даже если
+// граница чтения пришлась на её середину.
+class LineProbeParser : public ProbeParser
+{
+public:
+    void consume(const QByteArray &chunk, DiagnosticResults &results) override;
+    void finish(DiagnosticResults &results) override;
+
+protected:
+    // Строка в UTF-8 без перевода строки. По умолчанию переводится в
+    // QString и передаётся в parseLine; разборщики, которым хватает поиска
+    // по байтам, переопределяют этот метод и обходятся без копий
+    virtual void parseLineBytes(QByteArrayView line, DiagnosticResults &results);
+    virtual void parseLine(const QString &line, DiagnosticResults &results)
+    {
+        Q_UNUSED(line);
+        Q_UNUSED(results);
+    }
+    // Вызывается после последней строки
+    virtual void finishLines(DiagnosticResults &results) { Q_UNUSED(results); }
+
+private:
+    void emitLine(QByteArrayView line, DiagnosticResults &results);
+
+    QByteArray carry;
+};
+
+// Разбор XML plist по мере поступления вывода
+class PlistProbeParser : public ProbeParser, protected PlistStreamReader
+{
+public:
+    void consume(const QByteArray &chunk, DiagnosticResults &results) override;
+    void finish(DiagnosticResults &results) override;
+
+protected:
+    // complete == false, если документ оборван или повреждён
+    virtual void finishDocument(bool complete, DiagnosticResults &results) = 0;
+};
+
+#endif // PROBEPARSER_H
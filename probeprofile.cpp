@@ -0,0 +1,292 @@
+#include "probeprofile.h"
+#include "builtinprobes.h"
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QStandardPaths>
+
+namespace {
+
+// Те же профили, что может описать пользователь: встроенные проходят ту же
+// проверку, что и файл
+const char BuiltinProfiles[] = R"({
+    "default": "standard",
+    "profiles": [
+        {
+            "id": "standard",
+            "name": "Стандартная проверка",
+            "probes": ["battery", "disk-screen", "disk", "appleid"]
+        },
+        {
+            "id": "offboarding",
+            "name": "Быстрая передача устройства",
+            "probes": ["appleid", "battery", "disk-screen"]
+        },
+        {
+            "id": "audit",
+            "name": "Полный аудит оборудования",
+            "probes": ["battery", "disk-screen", "disk", "appleid"],
+            "deepDisk": true,
+            "timeouts": { "disk": 1800 },
+            "cacheTtl": { "disk": 0 }
+        },
+        {
+            "id": "battery",
+            "name": "Только батарея",
+            "probes": ["battery"]
+        }
+    ]
+})";
+
+// Таймауты больше суток — почти наверняка ошибка в единицах
+const int MaxTimeoutSeconds = 24 * 60 * 60;
+
+void setError(QString *error, const QString &message)
+{
+    if (error) {
+        *error = message;
+    }
+}
+
+// Проверка с таймаутом и временем кэша из профиля; остальное берётся у
+// исходной проверки
+class ConfiguredProbe : public Probe
+{
+public:
+    ConfiguredProbe(const QSharedPointer<Probe> &probe, int timeoutMs, int cacheTtlSeconds)
+        : probe(probe), timeout(timeoutMs), cacheTtl(cacheTtlSeconds)
+    {
+    }
+
+    QString id() const override { return probe->id(); }
+    QString description() const override { return probe->description(); }
+    QString program() const override { return probe->program(); }
+    QStringList arguments() const override { return probe->arguments(); }
+    int timeoutMs() const override { return timeout < 0 ? probe->timeoutMs() : timeout; }
+    int version() const override { return probe->version(); }
+    int cacheTtlSeconds() const override { return cacheTtl < 0 ? probe->cacheTtlSeconds() : cacheTtl; }
+    QByteArray fingerprint() const override { return probe->fingerprint(); }
+    QStringList dependencies() const override { return probe->dependencies(); }
+    bool shouldRun(const DiagnosticResults &results) const override { return probe->shouldRun(results); }
+    QStringList resultKeys() const override { return probe->resultKeys(); }
+    bool readNative(QByteArray *output) const override { return probe->readNative(output); }
+    QSharedPointer<ProbeParser> createParser() const override { return probe->createParser(); }
+    void finish(bool success, DiagnosticResults &results) const override { probe->finish(success, results); }
+    void abort(DiagnosticResults &results) const override { probe->abort(results); }
+
+private:
+    QSharedPointer<Probe> probe;
+    // -1 — значение исходной проверки
+    int timeout;
+    int cacheTtl;
+};
+
+bool readSeconds(const QJsonObject &json, const QString &field, const ProbeProfile &profile,
+                 QHash<QString, int> *seconds, int minimum, QString *error)
+{
+    const QJsonValue value = json.value(field);
+    if (value.isUndefined()) {
+        return true;
+    }
+    if (!value.isObject()) {
+        setError(error, QString("Профиль %1: поле %2 должно быть объектом").arg(profile.id, field));
+        return false;
+    }
+
+    const QJsonObject object = value.toObject();
+    for (auto it = object.constBegin(); it != object.constEnd(); ++it) {
+        if (!profile.probes.contains(it.key())) {
+            setError(error, QString("Профиль %1: %2 задан для проверки %3, которой нет в профиле")
+                                .arg(profile.id, field, it.key()));
+            return false;
+        }
+        const int number = it.value().toInt(-1);
+        if (!it.value().isDouble() || number < minimum || number > MaxTimeoutSeconds) {
+            setError(error, QString("Профиль %1: неверное значение %2 для %3")
+                                .arg(profile.id, field, it.key()));
+            return false;
+        }
+        seconds->insert(it.key(), number);
+    }
+    return true;
+}
+
+bool readProfile(const QJsonObject &json, const ProbeRegistry &known, ProbeProfile *profile, QString *error)
+{
+    profile->id = json.value("id").toString();
+    if (profile->id.isEmpty()) {
+        setError(error, "У профиля нет идентификатора");
+        return false;
+    }
+    profile->name = json.value("name").toString(profile->id);
+
+    for (const QJsonValue &probe : json.value("probes").toArray()) {
+        const QString id = probe.toString();
+        if (!known.contains(id)) {
+            setError(error, QString("Профиль %1: неизвестная проверка \"%2\"").arg(profile->id, id));
+            return false;
+        }
+        if (!profile->probes.contains(id)) {
+            profile->probes << id;
+        }
+    }
+    if (profile->probes.isEmpty()) {
+        setError(error, QString("Профиль %1: не выбрано ни одной проверки").arg(profile->id));
+        return false;
+    }
+
+    // Зависимость вне профиля никогда не выполнится, и проверка повиснет
+    for (const QString &id : profile->probes) {
+        for (const QString &dependency : known.probe(id)->dependencies()) {
+            if (!profile->probes.contains(dependency)) {
+                setError(error, QString("Профиль %1: проверке %2 нужна проверка %3")
+                                    .arg(profile->id, id, dependency));
+                return false;
+            }
+        }
+    }
+
+    profile->deepDisk = json.value("deepDisk").toBool(false);
+    if (profile->deepDisk && !profile->probes.contains("disk")) {
+        setError(error, QString("Профиль %1: deepDisk без проверки disk").arg(profile->id));
+        return false;
+    }
+
+    const QJsonValue threshold = json.value("batteryMinCapacity");
+    if (!threshold.isUndefined()) {
+        profile->batteryMinCapacity = threshold.toInt(-1);
+        if (!threshold.isDouble() || profile->batteryMinCapacity < 0 || profile->batteryMinCapacity > 100) {
+            setError(error, QString("Профиль %1: batteryMinCapacity должен быть от 0 до 100").arg(profile->id));
+            return false;
+        }
+    }
+
+    return readSeconds(json, "timeouts", *profile, &profile->timeoutSeconds, 1, error)
+           && readSeconds(json, "cacheTtl", *profile, &profile->cacheTtlSeconds, 0, error);
+}
+
+} // namespace
+
+ProbeRegistry ProbeProfile::createRegistry(const ProbeUser &user) const
+{
+    ProbeRegistry available = ProbeRegistry::defaultRegistry();
+    available.registerProbe(QSharedPointer<Probe>(new BatteryProbe(BatteryRegistry::system(), batteryMinCapacity)));
+    available.registerProbe(QSharedPointer<Probe>(new AppleIDProbe(user)));
+    if (deepDisk) {
+        requireDeepDiskCheck(available);
+    }
+
+    ProbeRegistry registry;
+    registry.setName(id);
+    for (const QString &probeId : probes) {
+        QSharedPointer<Probe> probe = available.probe(probeId);
+        if (!probe) {
+            continue;
+        }
+        const int timeoutMs = timeoutSeconds.contains(probeId) ? timeoutSeconds.value(probeId) * 1000 : -1;
+        const int cacheTtl = cacheTtlSeconds.value(probeId, -1);
+        if (timeoutMs >= 0 || cacheTtl >= 0) {
+            probe.reset(new ConfiguredProbe(probe, timeoutMs, cacheTtl));
+        }
+        registry.registerProbe(probe);
+    }
+    return registry;
+}
+
+ProfileSet ProfileSet::builtin()
+{
+    ProfileSet set;
+    QString error;
+    if (!fromJson(QByteArray(BuiltinProfiles), &set, &error)) {
+        qFatal("Invalid builtin profiles: %s", qPrintable(error));
+    }
+    return set;
+}
+
+bool ProfileSet::fromJson(const QByteArray &data, ProfileSet *set, QString *error)
+{
+    QJsonParseError parseError;
+    const QJsonDocument document = QJsonDocument::fromJson(data, &parseError);
+    if (!document.isObject()) {
+        setError(error, parseError.errorString());
+        return false;
+    }
+
+    const ProbeRegistry known = ProbeRegistry::defaultRegistry();
+    ProfileSet parsed;
+    for (const QJsonValue &value : document.object().value("profiles").toArray()) {
+        ProbeProfile profile;
+        if (!readProfile(value.toObject(), known, &profile, error)) {
+            return false;
+        }
+        if (parsed.contains(profile.id)) {
+            setError(error, QString("Профиль %1 описан дважды").arg(profile.id));
+            return false;
+        }
+        parsed.profileList << profile;
+    }
+    if (parsed.profileList.isEmpty()) {
+        setError(error, "Не описано ни одного профиля");
+        return false;
+    }
+
+    parsed.defaultId = document.object().value("default").toString(parsed.profileList.first().id);
+    if (!parsed.contains(parsed.defaultId)) {
+        setError(error, QString("Профиль по умолчанию %1 не описан").arg(parsed.defaultId));
+        return false;
+    }
+
+    *set = parsed;
+    return true;
+}
+
+bool ProfileSet::loadFile(const QString &path, ProfileSet *set, QString *error)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        setError(error, path + ": " + file.errorString());
+        return false;
+    }
+    if (!fromJson(file.readAll(), set, error)) {
+        setError(error, path + ": " + (error ? *error : QString()));
+        return false;
+    }
+    return true;
+}
+
+bool ProfileSet::load(const QString &path, ProfileSet *set, QString *error)
+{
+    if (!path.isEmpty()) {
+        return loadFile(path, set, error);
+    }
+
+    const QString userPath = QStandardPaths::locate(QStandardPaths::AppConfigLocation, "profiles.json");
+    if (!userPath.isEmpty()) {
+        return loadFile(userPath, set, error);
+    }
+
+    *set = builtin();
+    return true;
+}
+
+bool ProfileSet::contains(const QString &id) const
+{
+    for (const ProbeProfile &candidate : profileList) {
+        if (candidate.id == id) {
+            return true;
+        }
+    }
+    return false;
+}
+
+ProbeProfile ProfileSet::profile(const QString &id) const
+{
+    const QString wanted = id.isEmpty() ? defaultId : id;
+    for (const ProbeProfile &candidate : profileList) {
+        if (candidate.id == wanted) {
+            return candidate;
+        }
+    }
+    return ProbeProfile();
+}
@@ -0,0 +1,63 @@
+#ifndef PROBEPROFILE_H
+#define PROBEPROFILE_H
+
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <QStringList>
+#include "builtinprobes.h"
+#include "probe.h"
+
+// Профиль диагностики: какие проверки запускать, нужна ли полная проверка
+// тома, пороги и переопределённые таймауты и время кэша. Профили читаются
+// из JSON один раз при запуске:
+//
+// {
+//   "default": "standard",
+//   "profiles": [
+//     { "id": "battery", "name": "Только батарея", "probes": ["battery"],
+//       "batteryMinCapacity": 85, "timeouts": { "battery": 10 } }
+//   ]
+// }
+//
+// Таймауты (timeouts) и время кэша (cacheTtl) задаются в секундах по
+// идентификатору проверки.
+struct ProbeProfile {
+    QString id;
+    QString name;
+    QStringList probes;
+    // Полная проверка тома независимо от SMART
+    bool deepDisk = false;
+    // Ёмкость батареи ниже порога, %, — рекомендация заменить батарею
+    int batteryMinCapacity = 80;
+    QHash<QString, int> timeoutSeconds;
+    QHash<QString, int> cacheTtlSeconds;
+
+    // Реестр с проверками профиля в порядке перечисления. user — чьи
+    // настройки читают проверки пользователя (Apple ID)
+    ProbeRegistry createRegistry(const ProbeUser &user = ProbeUser()) const;
+};
+
+class ProfileSet
+{
+public:
+    // Встроенные профили: standard, offboarding, audit, battery
+    static ProfileSet builtin();
+    static bool fromJson(const QByteArray &data, ProfileSet *set, QString *error = nullptr);
+    static bool loadFile(const QString &path, ProfileSet *set, QString *error = nullptr);
+    // Файл, заданный явно, иначе profiles.json в каталоге настроек
+    // приложения, иначе встроенные профили
+    static bool load(const QString &path, ProfileSet *set, QString *error = nullptr);
+
+    QList<ProbeProfile> profiles() const { return profileList; }
+    QString defaultProfileId() const { return defaultId; }
+    bool contains(const QString &id) const;
+    // Профиль по идентификатору; пустой — профиль по умолчанию
+    ProbeProfile profile(const QString &id = QString()) const;
+
+private:
+    QList<ProbeProfile> profileList;
+    QString defaultId;
+};
+
+#endif // PROBEPROFILE_H
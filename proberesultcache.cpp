@@ -0,0 +1,110 @@
+#include "proberesultcache.h"
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+namespace {
+
+// "MDP2": с отпечатком; записи "MDPC" без него не читаются
+const quint32 EntryMagic = 0x4D445032;
+
+} // namespace
+
+ProbeResultCache::ProbeResultCache(const QString &directory)
+    : cacheDirectory(directory)
+{
+    if (cacheDirectory.isEmpty()) {
+        cacheDirectory = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/probes";
+    }
+}
+
+int ProbeResultCache::ttlFor(const Probe &probe) const
+{
+    return qMax(0, probe.cacheTtlSeconds());
+}
+
+QString ProbeResultCache::entryPath(const Probe &probe, const QString &machineSerial) const
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(machineSerial.toUtf8());
+    hash.addData(QByteArrayView("\0", 1));
+    hash.addData(probe.id().toUtf8());
+    hash.addData(QByteArray::number(probe.version()));
+    hash.addData(probe.program().toUtf8());
+    for (const QString &argument : probe.arguments()) {
+        hash.addData(QByteArrayView("\0", 1));
+        hash.addData(argument.toUtf8());
+    }
+    return cacheDirectory + "/" + probe.id() + "-" + QString::fromLatin1(hash.result().toHex()) + ".cache";
+}
+
+bool ProbeResultCache::lookup(const Probe &probe, const QString &machineSerial, QByteArray *output,
+                              QByteArray *fingerprint) const
+{
+    const int ttl = ttlFor(probe);
+    if (ttl <= 0) {
+        return false;
+    }
+
+    QFile file(entryPath(probe, machineSerial));
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_6_0);
+    quint32 magic = 0;
+    qint64 storedAt = 0;
+    QByteArray cached;
+    QByteArray cachedFingerprint;
+    in >> magic >> storedAt >> cached >> cachedFingerprint;
+    if (in.status() != QDataStream::Ok || magic != EntryMagic) {
+        return false;
+    }
+
+    const qint64 age = QDateTime::currentMSecsSinceEpoch() - storedAt;
+    if (age < 0 || age > qint64(ttl) * 1000) {
+        return false;
+    }
+
+    *output = cached;
+    if (fingerprint) {
+        *fingerprint = cachedFingerprint;
+    }
+    return true;
+}
+
+void ProbeResultCache::store(const Probe &probe, const QString &machineSerial, const QByteArray &output,
+                             const QByteArray &fingerprint)
+{
+    if (ttlFor(probe) <= 0) {
+        return;
+    }
+    if (!QDir().mkpath(cacheDirectory)) {
+        qWarning() << "Cannot create cache directory" << cacheDirectory;
+        return;
+    }
+
+    // Пишем через временный файл, чтобы параллельный запуск не прочитал половину
+    QSaveFile file(entryPath(probe, machineSerial));
+    if (!file.open(QIODevice::WriteOnly)) {
+        return;
+    }
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_6_0);
+    out << EntryMagic << QDateTime::currentMSecsSinceEpoch() << output << fingerprint;
+    file.commit();
+}
+
+void ProbeResultCache::clear()
+{
+    QDir directory(cacheDirectory);
+    for (const QString &entry : directory.entryList(QStringList() << "*.cache", QDir::Files)) {
+        directory.remove(entry);
+    }
+}
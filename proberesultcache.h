@@ -0,0 +1,36 @@
+#ifndef PROBERESULTCACHE_H
+#define PROBERESULTCACHE_H
+
+#include <QByteArray>
+#include <QString>
+#include "probe.h"
+
+// Кэш вывода проверок на диске. Хранится сырой вывод команды, а не
+// разобранные значения: при попадании вывод прогоняется через обычный
+// разборщик проверки, поэтому кэш не зависит от полей DiagnosticResults.
+// Ключ — серийный номер машины, идентификатор и версия проверки, команда.
+class ProbeResultCache
+{
+public:
+    // Пустой путь — каталог кэша приложения
+    explicit ProbeResultCache(const QString &directory = QString());
+
+    // Время хранения задаёт сама проверка; профиль переопределяет его через
+    // ConfiguredProbe (cacheTtl). 0 — не кэшировать
+    int ttlFor(const Probe &probe) const;
+
+    // fingerprint — отпечаток (Probe::fingerprint), снятый перед запуском,
+    // который дал этот вывод. Пустой — проверка без отпечатка
+    bool lookup(const Probe &probe, const QString &machineSerial, QByteArray *output,
+                QByteArray *fingerprint = nullptr) const;
+    void store(const Probe &probe, const QString &machineSerial, const QByteArray &output,
+               const QByteArray &fingerprint = QByteArray());
+    void clear();
+
+private:
+    QString entryPath(const Probe &probe, const QString &machineSerial) const;
+
+    QString cacheDirectory;
+};
+
+#endif // PROBERESULTCACHE_H
@@ -0,0 +1,494 @@
+#include "reportquery.h"
+#include <QDateTime>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QRegularExpression>
+#include <algorithm>
+#include <functional>
+
+namespace {
+
+void setError(QString *error, const QString &message)
+{
+    if (error) {
+        *error = message;
+    }
+}
+
+// Без ветвлений в теле цикла: сравнение даёт 0 или 1 и сужает маску
+template<typename T, typename Compare>
+void refine(quint8 *mask, const T *values, qint64 rows, T operand, Compare compare)
+{
+    for (qint64 row = 0; row < rows; ++row) {
+        mask[row] &= quint8(compare(values[row], operand));
+    }
+}
+
+template<typename T>
+void refineColumn(quint8 *mask, const T *values, qint64 rows, T operand, ReportFilter::Operator op)
+{
+    switch (op) {
+        case ReportFilter::Less:
+            refine(mask, values, rows, operand, std::less<T>());
+            break;
+        case ReportFilter::LessOrEqual:
+            refine(mask, values, rows, operand, std::less_equal<T>());
+            break;
+        case ReportFilter::Greater:
+            refine(mask, values, rows, operand, std::greater<T>());
+            break;
+        case ReportFilter::GreaterOrEqual:
+            refine(mask, values, rows, operand, std::greater_equal<T>());
+            break;
+        case ReportFilter::Equal:
+            refine(mask, values, rows, operand, std::equal_to<T>());
+            break;
+        case ReportFilter::NotEqual:
+            refine(mask, values, rows, operand, std::not_equal_to<T>());
+            break;
+    }
+}
+
+bool parseBool(const QString &text, bool *value)
+{
+    const QString lower = text.toLower();
+    if (lower == "1" || lower == "true" || lower == "да") {
+        *value = true;
+        return true;
+    }
+    if (lower == "0" || lower == "false" || lower == "нет") {
+        *value = false;
+        return true;
+    }
+    return false;
+}
+
+// Метка времени: дата/время ISO 8601 или миллисекунды от эпохи
+bool parseTimestamp(const QString &text, qint64 *value)
+{
+    const QDateTime dateTime = QDateTime::fromString(text, Qt::ISODate);
+    if (dateTime.isValid()) {
+        *value = dateTime.toMSecsSinceEpoch();
+        return true;
+    }
+    const QDate date = QDate::fromString(text, Qt::ISODate);
+    if (date.isValid()) {
+        *value = date.startOfDay().toMSecsSinceEpoch();
+        return true;
+    }
+    bool ok = false;
+    *value = text.toLongLong(&ok);
+    return ok;
+}
+
+// Столбец охвата, без которого значение столбца — не измерение, а ноль по
+// умолчанию: профиль без проверки, отмена, настольный Mac без батареи
+QString coverageColumn(const QString &name)
+{
+    if (name == "cycleCounts" || name == "maxCapacity" || name == "batteryCondition") {
+        return "batteryChecked";
+    }
+    if (name == "diskCheckPassed" || name == "diskStatus" || name == "diskCheckTier") {
+        return "diskChecked";
+    }
+    return QString();
+}
+
+QString cellText(const ReportStore::Column &column, qint64 row)
+{
+    if (column.name == "finishedAt") {
+        return QDateTime::fromMSecsSinceEpoch(column.int64s()[row]).toLocalTime().toString("yyyy-MM-dd HH:mm");
+    }
+    return column.text(row);
+}
+
+QJsonValue cellJson(const ReportStore::Column &column, qint64 row)
+{
+    switch (column.type) {
+        case ReportStore::Int32Column:
+            return column.int32s()[row];
+        case ReportStore::Int64Column:
+            if (column.name == "finishedAt") {
+                return QDateTime::fromMSecsSinceEpoch(column.int64s()[row]).toUTC().toString(Qt::ISODateWithMs);
+            }
+            return column.int64s()[row];
+        case ReportStore::BoolColumn:
+            return column.bools()[row] != 0;
+        case ReportStore::StringColumn:
+            return column.text(row);
+    }
+    return QJsonValue();
+}
+
+} // namespace
+
+bool ReportFilter::parse(const QString &text, ReportFilter *filter, QString *error)
+{
+    static const QRegularExpression pattern(R"(^\s*(!?)\s*([A-Za-z]+)\s*(?:(<=|>=|!=|=|<|>)\s*(.*?))?\s*$)");
+    const QRegularExpressionMatch match = pattern.match(text);
+    if (!match.hasMatch() || (match.captured(1) == "!" && !match.captured(3).isEmpty())) {
+        setError(error, "Неверное условие: " + text);
+        return false;
+    }
+
+    filter->column = match.captured(2);
+    if (match.captured(3).isEmpty()) {
+        // Логический столбец без сравнения
+        filter->op = Equal;
+        filter->value = match.captured(1) == "!" ? "0" : "1";
+        return true;
+    }
+
+    static const QHash<QString, Operator> operators = {
+        {"<", Less}, {"<=", LessOrEqual}, {">", Greater},
+        {">=", GreaterOrEqual}, {"=", Equal}, {"!=", NotEqual}
+    };
+    filter->op = operators.value(match.captured(3));
+    filter->value = match.captured(4);
+    return true;
+}
+
+ReportQuery::ReportQuery(const ReportStore &store)
+    : store(store), latestOnly(false)
+{
+}
+
+bool ReportQuery::addFilter(const ReportFilter &filter, QString *error)
+{
+    const ReportStore::Column *column = store.column(filter.column);
+    if (!column) {
+        setError(error, "Нет столбца " + filter.column);
+        return false;
+    }
+
+    Condition condition;
+    condition.column = column;
+    condition.op = filter.op;
+    bool ok = true;
+    switch (column->type) {
+        case ReportStore::Int32Column: {
+            condition.operand = filter.value.toInt(&ok);
+            break;
+        }
+        case ReportStore::Int64Column:
+            ok = parseTimestamp(filter.value, &condition.operand);
+            break;
+        case ReportStore::BoolColumn: {
+            bool value = false;
+            ok = parseBool(filter.value, &value) && (filter.op == ReportFilter::Equal || filter.op == ReportFilter::NotEqual);
+            condition.operand = value ? 1 : 0;
+            break;
+        }
+        case ReportStore::StringColumn:
+            // Строка сравнивается с кодом словаря, найденным один раз
+            ok = filter.op == ReportFilter::Equal || filter.op == ReportFilter::NotEqual;
+            condition.operand = column->code(filter.value);
+            break;
+    }
+    if (!ok) {
+        setError(error, QString("Неверное значение или сравнение для %1: %2").arg(filter.column, filter.value));
+        return false;
+    }
+
+    conditions.append(condition);
+    // Непроверенное значение не подходит ни под какое условие: ёмкость 0
+    // у настольного Mac не «меньше 80»
+    if (const ReportStore::Column *coverage = store.column(coverageColumn(filter.column))) {
+        conditions.append(Condition{coverage, ReportFilter::Equal, 1});
+    }
+    return true;
+}
+
+QByteArray ReportQuery::select() const
+{
+    const qint64 rows = store.rowCount();
+    QByteArray selection(rows, char(1));
+    quint8 *mask = reinterpret_cast<quint8 *>(selection.data());
+
+    if (latestOnly) {
+        applyLatest(mask);
+    }
+
+    for (const Condition &condition : conditions) {
+        const ReportStore::Column *column = condition.column;
+        switch (column->type) {
+            case ReportStore::Int32Column:
+                refineColumn<qint32>(mask, column->int32s(), rows, qint32(condition.operand), condition.op);
+                break;
+            case ReportStore::Int64Column:
+                refineColumn<qint64>(mask, column->int64s(), rows, condition.operand, condition.op);
+                break;
+            case ReportStore::BoolColumn:
+                refineColumn<quint8>(mask, column->bools(), rows, quint8(condition.operand), condition.op);
+                break;
+            case ReportStore::StringColumn:
+                if (condition.operand < 0) {
+                    // Значения нет в словаре: ни одна строка ему не равна
+                    if (condition.op == ReportFilter::Equal) {
+                        selection.fill(char(0));
+                    }
+                    break;
+                }
+                refineColumn<quint32>(mask, column->codes(), rows, quint32(condition.operand), condition.op);
+                break;
+        }
+    }
+    return selection;
+}
+
+void ReportQuery::applyLatest(quint8 *mask) const
+{
+    const ReportStore::Column *serials = store.column("machineSerial");
+    const ReportStore::Column *finished = store.column("finishedAt");
+    if (!serials || !finished) {
+        return;
+    }
+
+    // Строка с наибольшим временем для каждого кода серийного номера
+    const qint64 rows = store.rowCount();
+    const quint32 *codes = serials->codes();
+    const qint64 *times = finished->int64s();
+    QList<qint64> latest(serials->dictionary.size(), -1);
+    for (qint64 row = 0; row < rows; ++row) {
+        qint64 &best = latest[codes[row]];
+        if (best < 0 || times[row] >= times[best]) {
+            best = row;
+        }
+    }
+
+    std::fill(mask, mask + rows, quint8(0));
+    for (const qint64 row : latest) {
+        if (row >= 0) {
+            mask[row] = 1;
+        }
+    }
+}
+
+qint64 ReportQuery::count(const QByteArray &mask)
+{
+    // Байты маски — 0 или 1, сумма и есть число строк
+    qint64 total = 0;
+    const quint8 *data = reinterpret_cast<const quint8 *>(mask.constData());
+    for (qint64 row = 0; row < mask.size(); ++row) {
+        total += data[row];
+    }
+    return total;
+}
+
+bool ReportQuery::aggregate(const QByteArray &mask, const QString &groupBy, const QString &valueColumn,
+                            QList<ReportGroupStats> *stats, QString *error) const
+{
+    const ReportStore::Column *group = nullptr;
+    if (!groupBy.isEmpty()) {
+        group = store.column(groupBy);
+        if (!group || (group->type != ReportStore::StringColumn && group->type != ReportStore::BoolColumn)) {
+            setError(error, "Группировать можно по строковому или логическому столбцу: " + groupBy);
+            return false;
+        }
+    }
+
+    const ReportStore::Column *value = nullptr;
+    if (!valueColumn.isEmpty()) {
+        value = store.column(valueColumn);
+        if (!value || (value->type != ReportStore::Int32Column && value->type != ReportStore::Int64Column)) {
+            setError(error, "Сводка возможна только по числовому столбцу: " + valueColumn);
+            return false;
+        }
+    }
+
+    // Непроверенные значения в сводку не входят, строки при этом считаются
+    const ReportStore::Column *coverage = value ? store.column(coverageColumn(valueColumn)) : nullptr;
+
+    qsizetype groupCount = 1;
+    if (group) {
+        groupCount = group->type == ReportStore::StringColumn ? group->dictionary.size() : 2;
+    }
+
+    // Значения раскладываются по группам одним проходом
+    QList<QList<qint64>> values(groupCount);
+    QList<qint64> counts(groupCount, 0);
+    const quint8 *selected = reinterpret_cast<const quint8 *>(mask.constData());
+    for (qint64 row = 0; row < mask.size(); ++row) {
+        if (!selected[row]) {
+            continue;
+        }
+        qsizetype index = 0;
+        if (group) {
+            index = group->type == ReportStore::StringColumn ? qsizetype(group->codes()[row]) : group->bools()[row];
+        }
+        ++counts[index];
+        if (value && (!coverage || coverage->bools()[row])) {
+            values[index].append(value->type == ReportStore::Int32Column ? value->int32s()[row]
+                                                                          : value->int64s()[row]);
+        }
+    }
+
+    stats->clear();
+    for (qsizetype index = 0; index < groupCount; ++index) {
+        if (counts.at(index) == 0) {
+            continue;
+        }
+        ReportGroupStats groupStats;
+        if (group) {
+            groupStats.group = group->type == ReportStore::StringColumn ? group->dictionary.at(index)
+                                                                        : (index ? "да" : "нет");
+        }
+        groupStats.count = counts.at(index);
+
+        QList<qint64> &groupValues = values[index];
+        if (!groupValues.isEmpty()) {
+            const auto [lowest, highest] = std::minmax_element(groupValues.cbegin(), groupValues.cend());
+            groupStats.min = *lowest;
+            groupStats.max = *highest;
+            double sum = 0;
+            for (const qint64 item : groupValues) {
+                sum += item;
+            }
+            groupStats.mean = sum / groupValues.size();
+
+            // Медиана без полной сортировки
+            const qsizetype middle = groupValues.size() / 2;
+            std::nth_element(groupValues.begin(), groupValues.begin() + middle, groupValues.end());
+            groupStats.median = groupValues.at(middle);
+            if (groupValues.size() % 2 == 0) {
+                const qint64 lower = *std::max_element(groupValues.cbegin(), groupValues.cbegin() + middle);
+                groupStats.median = (groupStats.median + lower) / 2.0;
+            }
+        }
+        stats->append(groupStats);
+    }
+
+    std::sort(stats->begin(), stats->end(), [](const ReportGroupStats &a, const ReportGroupStats &b) {
+        return a.group < b.group;
+    });
+    return true;
+}
+
+QStringList ReportQuery::defaultColumns()
+{
+    return {"machineSerial", "machineModel", "finishedAt", "cycleCounts", "maxCapacity",
+            "findMyMacEnabled", "diskCheckPassed"};
+}
+
+QString ReportQuery::rowsText(const QByteArray &mask, const QStringList &columns, qint64 limit) const
+{
+    QList<const ReportStore::Column *> shown;
+    QList<const ReportStore::Column *> coverage;
+    for (const QString &name : columns) {
+        if (const ReportStore::Column *column = store.column(name)) {
+            shown.append(column);
+            coverage.append(store.column(coverageColumn(name)));
+        }
+    }
+
+    QString text;
+    for (const ReportStore::Column *column : shown) {
+        text += column->name + "\t";
+    }
+    text.chop(1);
+    text += "\n";
+
+    qint64 printed = 0;
+    const quint8 *selected = reinterpret_cast<const quint8 *>(mask.constData());
+    for (qint64 row = 0; row < mask.size() && printed < limit; ++row) {
+        if (!selected[row]) {
+            continue;
+        }
+        for (int i = 0; i < shown.size(); ++i) {
+            const bool checked = !coverage.at(i) || coverage.at(i)->bools()[row];
+            text += (checked ? cellText(*shown.at(i), row) : QString("—")) + "\t";
+        }
+        text.chop(1);
+        text += "\n";
+        ++printed;
+    }
+
+    const qint64 total = count(mask);
+    text += QString("Строк: %1 из %2").arg(total).arg(store.rowCount());
+    if (printed < total) {
+        text += QString(", показано %1").arg(printed);
+    }
+    return text + "\n";
+}
+
+QByteArray ReportQuery::rowsJson(const QByteArray &mask, const QStringList &columns, qint64 limit) const
+{
+    QList<const ReportStore::Column *> shown;
+    QList<const ReportStore::Column *> coverage;
+    for (const QString &name : columns) {
+        if (const ReportStore::Column *column = store.column(name)) {
+            shown.append(column);
+            coverage.append(store.column(coverageColumn(name)));
+        }
+    }
+
+    QJsonArray rows;
+    const quint8 *selected = reinterpret_cast<const quint8 *>(mask.constData());
+    for (qint64 row = 0; row < mask.size() && rows.size() < limit; ++row) {
+        if (!selected[row]) {
+            continue;
+        }
+        QJsonObject object;
+        for (int i = 0; i < shown.size(); ++i) {
+            const bool checked = !coverage.at(i) || coverage.at(i)->bools()[row];
+            object[shown.at(i)->name] = checked ? cellJson(*shown.at(i), row) : QJsonValue();
+        }
+        rows.append(object);
+    }
+
+    QJsonObject report;
+    report["matched"] = count(mask);
+    report["total"] = store.rowCount();
+    report["rows"] = rows;
+    return QJsonDocument(report).toJson();
+}
+
+QString ReportQuery::statsText(const QString &groupBy, const QString &valueColumn,
+                               const QList<ReportGroupStats> &stats)
+{
+    QString text = QString("%1 %2").arg(groupBy.isEmpty() ? QString("все") : groupBy, -24).arg("строк", 8);
+    if (!valueColumn.isEmpty()) {
+        text += QString(" %1 %2 %3 %4  (%5)").arg("мин", 8).arg("медиана", 10).arg("среднее", 10)
+                    .arg("макс", 8).arg(valueColumn);
+    }
+    text += "\n";
+
+    for (const ReportGroupStats &group : stats) {
+        text += QString("%1 %2").arg(group.group.isEmpty() ? QString("—") : group.group, -24).arg(group.count, 8);
+        if (!valueColumn.isEmpty()) {
+            text += QString(" %1 %2 %3 %4").arg(group.min, 8).arg(group.median, 10, 'f', 1)
+                        .arg(group.mean, 10, 'f', 1).arg(group.max, 8);
+        }
+        text += "\n";
+    }
+    return text;
+}
+
+QByteArray ReportQuery::statsJson(const QString &groupBy, const QString &valueColumn,
+                                  const QList<ReportGroupStats> &stats)
+{
+    QJsonArray groups;
+    for (const ReportGroupStats &group : stats) {
+        QJsonObject object;
+        if (!groupBy.isEmpty()) {
+            object[groupBy] = group.group;
+        }
+        object["count"] = group.count;
+        if (!valueColumn.isEmpty()) {
+            object["min"] = group.min;
+            object["median"] = group.median;
+            object["mean"] = group.mean;
+            object["max"] = group.max;
+        }
+        groups.append(object);
+    }
+
+    QJsonObject report;
+    if (!valueColumn.isEmpty()) {
+        report["column"] = valueColumn;
+    }
+    report["groups"] = groups;
+    return QJsonDocument(report).toJson();
+}
@@ -0,0 +1,84 @@
+#ifndef REPORTQUERY_H
+#define REPORTQUERY_H
+
+#include <QByteArray>
+#include <QList>
+#include <QString>
+#include <QStringList>
+#include "reportstore.h"
+
+// Условие на один столбец: "maxCapacity<80", "diskStatus!=OK",
+// "findMyMacEnabled" (то же, что =1), "!hasAppleID" (=0),
+// "finishedAt>=2024-01-01"
+struct ReportFilter {
+    enum Operator {
+        Less,
+        LessOrEqual,
+        Greater,
+        GreaterOrEqual,
+        Equal,
+        NotEqual
+    };
+
+    QString column;
+    Operator op = Equal;
+    QString value;
+
+    static bool parse(const QString &text, ReportFilter *filter, QString *error = nullptr);
+};
+
+// Сводка значений столбца по группе строк
+struct ReportGroupStats {
+    QString group;
+    qint64 count = 0;
+    qint64 min = 0;
+    qint64 max = 0;
+    double mean = 0;
+    double median = 0;
+};
+
+// Запрос к хранилищу отчётов. Отбор строк — маска по одному байту на
+// строку: каждое условие уточняет её одним проходом по своему столбцу, без
+// ветвлений в цикле, поэтому компилятор разворачивает его в SIMD
+class ReportQuery
+{
+public:
+    explicit ReportQuery(const ReportStore &store);
+
+    bool addFilter(const ReportFilter &filter, QString *error = nullptr);
+    // Учитывать только последний отчёт каждой машины
+    void setLatestOnly(bool latest) { latestOnly = latest; }
+
+    QByteArray select() const;
+    static qint64 count(const QByteArray &mask);
+
+    // Число строк и, если задан valueColumn, min/median/mean/max по группам
+    // значений groupBy (пусто — одна группа на все строки)
+    bool aggregate(const QByteArray &mask, const QString &groupBy, const QString &valueColumn,
+                   QList<ReportGroupStats> *stats, QString *error = nullptr) const;
+
+    QString rowsText(const QByteArray &mask, const QStringList &columns, qint64 limit) const;
+    QByteArray rowsJson(const QByteArray &mask, const QStringList &columns, qint64 limit) const;
+    static QString statsText(const QString &groupBy, const QString &valueColumn,
+                             const QList<ReportGroupStats> &stats);
+    static QByteArray statsJson(const QString &groupBy, const QString &valueColumn,
+                                const QList<ReportGroupStats> &stats);
+
+    // Столбцы списка по умолчанию
+    static QStringList defaultColumns();
+
+private:
+    struct Condition {
+        const ReportStore::Column *column;
+        ReportFilter::Operator op;
+        qint64 operand;
+    };
+
+    void applyLatest(quint8 *mask) const;
+
+    const ReportStore &store;
+    QList<Condition> conditions;
+    bool latestOnly;
+};
+
+#endif // REPORTQUERY_H
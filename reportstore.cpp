@@ -0,0 +1,502 @@
+#include "reportstore.h"
+#include "resultserializer.h"
+#include <QDebug>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QtEndian>
+#include <cstring>
+
+namespace {
+
+const char StoreMagic[4] = {'M', 'D', 'C', 'S'};
+const quint16 StoreVersion = 1;
+const qint64 HeaderSize = 32;
+const qint64 DirectoryEntrySize = 64;
+const int ColumnNameSize = 24;
+// Выравнивание данных столбцов: границы кэш-линий для векторных проходов
+const qint64 ColumnAlignment = 64;
+
+void setError(QString *error, const QString &message)
+{
+    if (error) {
+        *error = message;
+    }
+}
+
+int valueWidth(ReportStore::ColumnType type)
+{
+    switch (type) {
+        case ReportStore::Int64Column:
+            return 8;
+        case ReportStore::BoolColumn:
+            return 1;
+        case ReportStore::Int32Column:
+        case ReportStore::StringColumn:
+            return 4;
+    }
+    return 0;
+}
+
+qint64 aligned(qint64 offset)
+{
+    return (offset + ColumnAlignment - 1) / ColumnAlignment * ColumnAlignment;
+}
+
+// Значения одного отчёта в порядке ReportStore::schema()
+QVariantList rowOf(const DiagnosticResults &results)
+{
+    return {
+        results.machineSerial,
+        results.machineModel,
+        results.finishedAt.isValid() ? results.finishedAt.toMSecsSinceEpoch() : qint64(0),
+        results.profile,
+        results.cycleCounts,
+        results.maxCapacity,
+        results.batteryCondition,
+        results.hasAppleID,
+        results.appleIDEmail,
+        results.findMyMacEnabled,
+        results.diskCheckPassed,
+        results.diskStatus,
+        results.diskCheckTier,
+        results.isComplete(),
+        int(results.recommendations.size()),
+        results.batteryChecked(),
+        results.diskChecked()
+    };
+}
+
+int columnIndex(const QList<QPair<QString, ReportStore::ColumnType>> &schema, const QString &name)
+{
+    for (int i = 0; i < schema.size(); ++i) {
+        if (schema.at(i).first == name) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+QString reportKey(const QVariantList &row)
+{
+    return row.at(0).toString() + '\n' + QString::number(row.at(2).toLongLong());
+}
+
+template<typename T>
+void appendValue(QByteArray *values, T value)
+{
+    const T little = qToLittleEndian(value);
+    values->append(reinterpret_cast<const char *>(&little), sizeof(T));
+}
+
+QByteArray encodeDictionary(const QStringList &dictionary)
+{
+    QByteArray strings;
+    QByteArray block;
+    appendValue<quint32>(&block, quint32(dictionary.size()));
+    for (const QString &value : dictionary) {
+        appendValue<quint32>(&block, quint32(strings.size()));
+        strings += value.toUtf8();
+    }
+    appendValue<quint32>(&block, quint32(strings.size()));
+    return block + strings;
+}
+
+bool decodeDictionary(const uchar *data, qint64 length, QStringList *dictionary)
+{
+    if (length < 4) {
+        return false;
+    }
+    const quint32 count = qFromLittleEndian<quint32>(data);
+    const qint64 stringsOffset = 4 + (qint64(count) + 1) * 4;
+    if (stringsOffset > length) {
+        return false;
+    }
+
+    const char *strings = reinterpret_cast<const char *>(data + stringsOffset);
+    const qint64 stringsSize = length - stringsOffset;
+    dictionary->clear();
+    dictionary->reserve(count);
+    for (quint32 i = 0; i < count; ++i) {
+        const quint32 begin = qFromLittleEndian<quint32>(data + 4 + i * 4);
+        const quint32 end = qFromLittleEndian<quint32>(data + 8 + i * 4);
+        if (begin > end || end > stringsSize) {
+            return false;
+        }
+        dictionary->append(QString::fromUtf8(strings + begin, end - begin));
+    }
+    return true;
+}
+
+} // namespace
+
+QString ReportStore::Column::text(qint64 row) const
+{
+    switch (type) {
+        case Int32Column:
+            return QString::number(int32s()[row]);
+        case Int64Column:
+            return QString::number(int64s()[row]);
+        case BoolColumn:
+            return bools()[row] ? "да" : "нет";
+        case StringColumn:
+            return dictionary.value(codes()[row]);
+    }
+    return QString();
+}
+
+QList<QPair<QString, ReportStore::ColumnType>> ReportStore::schema()
+{
+    // Порядок совпадает с rowOf(); новые столбцы добавляются в конец
+    return {
+        {"machineSerial", StringColumn},
+        {"machineModel", StringColumn},
+        {"finishedAt", Int64Column},
+        {"profile", StringColumn},
+        {"cycleCounts", Int32Column},
+        {"maxCapacity", Int32Column},
+        {"batteryCondition", StringColumn},
+        {"hasAppleID", BoolColumn},
+        {"appleIDEmail", StringColumn},
+        {"findMyMacEnabled", BoolColumn},
+        {"diskCheckPassed", BoolColumn},
+        {"diskStatus", StringColumn},
+        {"diskCheckTier", StringColumn},
+        {"complete", BoolColumn},
+        {"recommendations", Int32Column},
+        // Без охвата значения батареи и диска — нули по умолчанию, а не
+        // измерения; запросы по этим столбцам такие строки не учитывают
+        {"batteryChecked", BoolColumn},
+        {"diskChecked", BoolColumn}
+    };
+}
+
+bool ReportStore::open(const QString &path, QString *error)
+{
+    close();
+
+#if Q_BYTE_ORDER != Q_LITTLE_ENDIAN
+    // Столбцы читаются напрямую из отображения без перестановки байтов
+    setError(error, "Хранилище поддерживается только на little-endian машинах");
+    return false;
+#endif
+
+    file.setFileName(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        setError(error, file.errorString());
+        return false;
+    }
+    const qint64 size = file.size();
+    if (size < HeaderSize || !(mapped = file.map(0, size))) {
+        setError(error, size < HeaderSize ? QString("Файл слишком мал") : file.errorString());
+        close();
+        return false;
+    }
+
+    if (std::memcmp(mapped, StoreMagic, sizeof(StoreMagic)) != 0
+        || qFromLittleEndian<quint16>(mapped + 4) != StoreVersion) {
+        setError(error, "Не хранилище отчётов или неподдерживаемая версия");
+        close();
+        return false;
+    }
+
+    const quint16 columnCount = qFromLittleEndian<quint16>(mapped + 6);
+    rows = qFromLittleEndian<qint64>(mapped + 12);
+    if (rows < 0 || rows > size || HeaderSize + columnCount * DirectoryEntrySize > size) {
+        setError(error, "Повреждён заголовок хранилища");
+        close();
+        return false;
+    }
+
+    for (int i = 0; i < columnCount; ++i) {
+        const uchar *entry = mapped + HeaderSize + i * DirectoryEntrySize;
+        Column column;
+        column.name = QString::fromLatin1(reinterpret_cast<const char *>(entry),
+                                          qstrnlen(reinterpret_cast<const char *>(entry), ColumnNameSize));
+        column.type = ColumnType(entry[ColumnNameSize]);
+        const qint64 dataOffset = qFromLittleEndian<qint64>(entry + 32);
+        const qint64 dataLength = qFromLittleEndian<qint64>(entry + 40);
+        const qint64 dictOffset = qFromLittleEndian<qint64>(entry + 48);
+        const qint64 dictLength = qFromLittleEndian<qint64>(entry + 56);
+
+        const int width = valueWidth(column.type);
+        if (width == 0 || dataLength != rows * width || dataOffset % ColumnAlignment != 0
+            || dataOffset < 0 || dataOffset + dataLength > size
+            || dictOffset < 0 || dictLength < 0 || dictOffset + dictLength > size) {
+            setError(error, "Повреждён столбец " + column.name);
+            close();
+            return false;
+        }
+        column.data = mapped + dataOffset;
+
+        if (column.type == StringColumn) {
+            if (!decodeDictionary(mapped + dictOffset, dictLength, &column.dictionary)) {
+                setError(error, "Повреждён словарь столбца " + column.name);
+                close();
+                return false;
+            }
+            // Код вне словаря сделал бы чтение значения небезопасным
+            const quint32 *codes = column.codes();
+            const quint32 limit = quint32(column.dictionary.size());
+            quint32 outside = 0;
+            for (qint64 row = 0; row < rows; ++row) {
+                outside |= quint32(codes[row] >= limit);
+            }
+            if (outside) {
+                setError(error, "Неверный код в столбце " + column.name);
+                close();
+                return false;
+            }
+        }
+        storeColumns.append(column);
+    }
+    return true;
+}
+
+void ReportStore::close()
+{
+    if (mapped) {
+        file.unmap(mapped);
+        mapped = nullptr;
+    }
+    file.close();
+    rows = 0;
+    storeColumns.clear();
+}
+
+const ReportStore::Column *ReportStore::column(const QString &name) const
+{
+    for (const Column &column : storeColumns) {
+        if (column.name == name) {
+            return &column;
+        }
+    }
+    return nullptr;
+}
+
+ReportStoreBuilder::ReportStoreBuilder()
+    : rows(0)
+{
+    for (const auto &spec : ReportStore::schema()) {
+        ColumnData column;
+        column.type = spec.second;
+        columnData.append(column);
+    }
+}
+
+void ReportStoreBuilder::load(const ReportStore &store)
+{
+    const QList<QPair<QString, ReportStore::ColumnType>> schema = ReportStore::schema();
+    QList<const ReportStore::Column *> source;
+    for (const auto &spec : schema) {
+        const ReportStore::Column *column = store.column(spec.first);
+        source.append(column && column->type == spec.second ? column : nullptr);
+    }
+
+    // Столбцы, которых не было в старой версии хранилища, заполняются
+    // значениями по умолчанию
+    for (qint64 row = 0; row < store.rowCount(); ++row) {
+        QVariantList values;
+        for (int i = 0; i < schema.size(); ++i) {
+            const ReportStore::Column *column = source.at(i);
+            switch (schema.at(i).second) {
+                case ReportStore::Int32Column:
+                    values.append(column ? column->int32s()[row] : 0);
+                    break;
+                case ReportStore::Int64Column:
+                    values.append(column ? column->int64s()[row] : qint64(0));
+                    break;
+                case ReportStore::BoolColumn:
+                    values.append(column ? column->bools()[row] != 0 : false);
+                    break;
+                case ReportStore::StringColumn:
+                    values.append(column ? column->text(row) : QString());
+                    break;
+            }
+        }
+        // Охват в хранилище, записанном до его появления, восстанавливается
+        // по значениям
+        if (!source.at(columnIndex(schema, "batteryChecked"))) {
+            values[columnIndex(schema, "batteryChecked")] = values.at(columnIndex(schema, "maxCapacity")).toInt() > 0;
+        }
+        if (!source.at(columnIndex(schema, "diskChecked"))) {
+            values[columnIndex(schema, "diskChecked")] = !values.at(columnIndex(schema, "diskCheckTier")).toString().isEmpty();
+        }
+        if (!reportKeys.contains(reportKey(values))) {
+            reportKeys.insert(reportKey(values));
+            appendRow(values);
+        }
+    }
+}
+
+bool ReportStoreBuilder::add(const DiagnosticResults &results)
+{
+    const QVariantList row = rowOf(results);
+    const QString key = reportKey(row);
+    if (reportKeys.contains(key)) {
+        return false;
+    }
+    reportKeys.insert(key);
+    appendRow(row);
+    return true;
+}
+
+void ReportStoreBuilder::appendRow(const QVariantList &row)
+{
+    for (int i = 0; i < columnData.size(); ++i) {
+        ColumnData &column = columnData[i];
+        const QVariant &value = row.at(i);
+        switch (column.type) {
+            case ReportStore::Int32Column:
+                appendValue<qint32>(&column.values, value.toInt());
+                break;
+            case ReportStore::Int64Column:
+                appendValue<qint64>(&column.values, value.toLongLong());
+                break;
+            case ReportStore::BoolColumn:
+                column.values.append(char(value.toBool() ? 1 : 0));
+                break;
+            case ReportStore::StringColumn: {
+                const QString text = value.toString();
+                auto it = column.codes.constFind(text);
+                if (it == column.codes.constEnd()) {
+                    it = column.codes.insert(text, quint32(column.dictionary.size()));
+                    column.dictionary.append(text);
+                }
+                appendValue<quint32>(&column.values, it.value());
+                break;
+            }
+        }
+    }
+    ++rows;
+}
+
+qint64 ReportStoreBuilder::ingestFile(const QString &path, QString *error, int *skipped)
+{
+    QFile input(path);
+    if (!input.open(QIODevice::ReadOnly)) {
+        setError(error, input.errorString());
+        return -1;
+    }
+
+    qint64 added = 0;
+    if (input.peek(4) == QByteArray("MDR1")) {
+        // Запись новой версии или повреждённая запись с целым заголовком
+        // пропускается по длине: одна обновлённая машина не должна
+        // останавливать загрузку остальных отчётов файла
+        int unreadable = 0;
+        for (;;) {
+            DiagnosticResults results;
+            QString readError;
+            const qint64 position = input.pos();
+            if (ResultSerializer::readBinary(&input, &results, &readError, &unreadable)) {
+                added += add(results) ? 1 : 0;
+                continue;
+            }
+            if (readError.isEmpty()) {
+                break;
+            }
+            ++unreadable;
+            if (input.pos() == position) {
+                // Нет заголовка: границу следующей записи не найти
+                qWarning() << "Stopping at unreadable data in" << path << "at" << position << ":" << readError;
+                break;
+            }
+            qWarning() << "Skipping unreadable report in" << path << "at" << position << ":" << readError;
+        }
+        if (skipped) {
+            *skipped += unreadable;
+        }
+        return added;
+    }
+
+    QJsonParseError parseError;
+    const QJsonDocument document = QJsonDocument::fromJson(input.readAll(), &parseError);
+    if (!document.isObject()) {
+        setError(error, path + ": " + parseError.errorString());
+        return -1;
+    }
+
+    // Отчёт парка: отчёты машин лежат в hosts[].results
+    const QJsonObject report = document.object();
+    QList<QJsonObject> reports;
+    if (report.contains("hosts")) {
+        for (const QJsonValue &host : report.value("hosts").toArray()) {
+            if (host.toObject().contains("results")) {
+                reports.append(host.toObject().value("results").toObject());
+            }
+        }
+    } else {
+        reports.append(report);
+    }
+
+    for (const QJsonObject &json : reports) {
+        DiagnosticResults results;
+        QString readError;
+        if (!ResultSerializer::fromJson(json, &results, &readError)) {
+            setError(error, path + ": " + readError);
+            return -1;
+        }
+        added += add(results) ? 1 : 0;
+    }
+    return added;
+}
+
+bool ReportStoreBuilder::write(const QString &path, QString *error) const
+{
+    const QList<QPair<QString, ReportStore::ColumnType>> schema = ReportStore::schema();
+
+    QByteArray header(HeaderSize, '\0');
+    std::memcpy(header.data(), StoreMagic, sizeof(StoreMagic));
+    qToLittleEndian<quint16>(StoreVersion, header.data() + 4);
+    qToLittleEndian<quint16>(quint16(schema.size()), header.data() + 6);
+    qToLittleEndian<qint64>(rows, header.data() + 12);
+
+    // Сначала раскладка, затем запись одним проходом
+    QByteArray directory(schema.size() * DirectoryEntrySize, '\0');
+    QList<QByteArray> dictionaries;
+    qint64 offset = HeaderSize + directory.size();
+    QList<qint64> dataOffsets;
+    QList<qint64> dictOffsets;
+    for (int i = 0; i < schema.size(); ++i) {
+        const ColumnData &column = columnData.at(i);
+        offset = aligned(offset);
+        dataOffsets.append(offset);
+        offset += column.values.size();
+
+        dictionaries.append(column.type == ReportStore::StringColumn ? encodeDictionary(column.dictionary)
+                                                                     : QByteArray());
+        dictOffsets.append(offset);
+        offset += dictionaries.last().size();
+
+        char *entry = directory.data() + i * DirectoryEntrySize;
+        const QByteArray name = schema.at(i).first.toLatin1().left(ColumnNameSize - 1);
+        std::memcpy(entry, name.constData(), name.size());
+        entry[ColumnNameSize] = char(column.type);
+        qToLittleEndian<qint64>(dataOffsets.last(), entry + 32);
+        qToLittleEndian<qint64>(column.values.size(), entry + 40);
+        qToLittleEndian<qint64>(dictOffsets.last(), entry + 48);
+        qToLittleEndian<qint64>(dictionaries.last().size(), entry + 56);
+    }
+
+    QSaveFile output(path);
+    if (!output.open(QIODevice::WriteOnly)) {
+        setError(error, output.errorString());
+        return false;
+    }
+    output.write(header);
+    output.write(directory);
+    qint64 position = HeaderSize + directory.size();
+    for (int i = 0; i < schema.size(); ++i) {
+        output.write(QByteArray(dataOffsets.at(i) - position, '\0'));
+        output.write(columnData.at(i).values);
+        output.write(dictionaries.at(i));
+        position = dictOffsets.at(i) + dictionaries.at(i).size();
+    }
+    if (!output.commit()) {
+        setError(error, output.errorString());
+        return false;
+    }
+    return true;
+}
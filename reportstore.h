@@ -0,0 +1,107 @@
+#ifndef REPORTSTORE_H
+#define REPORTSTORE_H
+
+#include <QFile>
+#include <QHash>
+#include <QList>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+#include "diagnosticresults.h"
+
+// Колоночное хранилище отчётов парка для сводных запросов. Каждое поле
+// DiagnosticResults — отдельный непрерывный массив фиксированной ширины,
+// строки заменены кодами словаря. Файл отображается в память целиком, и
+// фильтр по полю — это один проход по массиву без разбора записей.
+//
+// Формат (little-endian, как на всех поддерживаемых Mac):
+//   заголовок 32 байта: "MDCS", версия, число столбцов, число строк;
+//   каталог столбцов по 64 байта: имя, тип, смещение и длина данных и словаря;
+//   данные столбцов, выровненные по 64 байтам;
+//   словарь: число строк, смещения (число + 1), байты UTF-8.
+class ReportStore
+{
+public:
+    enum ColumnType : quint8 {
+        Int32Column = 1,
+        Int64Column = 2,
+        BoolColumn = 3,  // quint8: 0 или 1
+        StringColumn = 4 // quint32: код в словаре столбца
+    };
+
+    struct Column {
+        QString name;
+        ColumnType type = Int32Column;
+        const uchar *data = nullptr;
+        // Только у строковых столбцов
+        QStringList dictionary;
+
+        const qint32 *int32s() const { return reinterpret_cast<const qint32 *>(data); }
+        const qint64 *int64s() const { return reinterpret_cast<const qint64 *>(data); }
+        const quint8 *bools() const { return data; }
+        const quint32 *codes() const { return reinterpret_cast<const quint32 *>(data); }
+        // -1 — такой строки в столбце нет
+        qint64 code(const QString &value) const { return dictionary.indexOf(value); }
+        // Значение строки row в виде текста
+        QString text(qint64 row) const;
+    };
+
+    ReportStore() = default;
+    ReportStore(const ReportStore &) = delete;
+    ReportStore &operator=(const ReportStore &) = delete;
+
+    bool open(const QString &path, QString *error = nullptr);
+    void close();
+    bool isOpen() const { return mapped != nullptr; }
+
+    qint64 rowCount() const { return rows; }
+    const QList<Column> &columns() const { return storeColumns; }
+    const Column *column(const QString &name) const;
+
+    // Столбцы, которые хранилище получает из DiagnosticResults
+    static QList<QPair<QString, ColumnType>> schema();
+
+private:
+    QFile file;
+    uchar *mapped = nullptr;
+    qint64 rows = 0;
+    QList<Column> storeColumns;
+};
+
+// Собирает хранилище из отчётов. Повторный отчёт той же машины с тем же
+// временем завершения пропускается, поэтому одни и те же файлы можно
+// загружать несколько раз.
+class ReportStoreBuilder
+{
+public:
+    ReportStoreBuilder();
+
+    // Переносит строки уже записанного хранилища, чтобы дописать к нему новые
+    void load(const ReportStore &store);
+    // false — такой отчёт уже есть
+    bool add(const DiagnosticResults &results);
+    // Поток двоичных записей (--format binary, история запусков), JSON-отчёт
+    // машины или JSON-отчёт парка. Возвращает число добавленных отчётов.
+    // Двоичные записи новой версии и повреждённые пропускаются, их число
+    // прибавляется к skipped
+    qint64 ingestFile(const QString &path, QString *error = nullptr, int *skipped = nullptr);
+
+    qint64 rowCount() const { return rows; }
+    bool write(const QString &path, QString *error = nullptr) const;
+
+private:
+    void appendRow(const QVariantList &row);
+
+    struct ColumnData {
+        ReportStore::ColumnType type;
+        QByteArray values;
+        QStringList dictionary;
+        QHash<QString, quint32> codes;
+    };
+
+    QList<ColumnData> columnData;
+    QSet<QString> reportKeys;
+    qint64 rows;
+};
+
+#endif // REPORTSTORE_H
@@ -0,0 +1,11 @@
+# Колоночное хранилище отчётов парка и запросы по нему. Зависит только от
+# сериализации результатов, не от запуска проверок
+include($$PWD/serialization.pri)
+
+SOURCES += \
+    $$PWD/reportstore.cpp \
+    $$PWD/reportquery.cpp
+
+HEADERS += \
+    $$PWD/reportstore.h \
+    $$PWD/reportquery.h
@@ -0,0 +1,607 @@
+#include "resultserializer.h"
+#include <algorithm>
+#include <QDataStream>
+#include <QIODevice>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QTimeZone>
+#include <QtEndian>
+
+namespace {
+
+const int HeaderSize = 4 + 2 + 4;
+// Защита от мусора вместо длины: отчёт не бывает больше нескольких КБ
+const quint32 MaxPayloadSize = 16 * 1024 * 1024;
+
+void setError(QString *error, const QString &message)
+{
+    if (error) {
+        *error = message;
+    }
+}
+
+void writeString(QDataStream &out, const QString &value)
+{
+    const QByteArray utf8 = value.toUtf8();
+    out << quint32(utf8.size());
+    out.writeRawData(utf8.constData(), utf8.size());
+}
+
+bool readString(QDataStream &in, QString *value)
+{
+    quint32 size = 0;
+    in >> size;
+    // Длина сверяется с остатком записи до выделения памяти
+    if (in.status() != QDataStream::Ok || size > MaxPayloadSize || qint64(size) > in.device()->bytesAvailable()) {
+        return false;
+    }
+    QByteArray utf8(size, Qt::Uninitialized);
+    if (in.readRawData(utf8.data(), size) != int(size)) {
+        return false;
+    }
+    *value = QString::fromUtf8(utf8);
+    return true;
+}
+
+bool readBool(QDataStream &in)
+{
+    quint8 value = 0;
+    in >> value;
+    return value != 0;
+}
+
+// Теги значений дополнительных проверок
+enum ValueTag : quint8 {
+    NullValue = 0,
+    BoolValue = 1,
+    IntValue = 2,
+    DoubleValue = 3,
+    StringValue = 4
+};
+
+void writeValue(QDataStream &out, const QVariant &value)
+{
+    switch (value.metaType().id()) {
+        case QMetaType::Bool:
+            out << quint8(BoolValue) << quint8(value.toBool());
+            return;
+        case QMetaType::Int:
+        case QMetaType::UInt:
+        case QMetaType::Long:
+        case QMetaType::ULong:
+        case QMetaType::LongLong:
+        case QMetaType::ULongLong:
+        case QMetaType::Short:
+        case QMetaType::UShort:
+            out << quint8(IntValue) << value.toLongLong();
+            return;
+        case QMetaType::Double:
+        case QMetaType::Float:
+            out << quint8(DoubleValue) << value.toDouble();
+            return;
+        case QMetaType::UnknownType:
+        case QMetaType::Nullptr:
+            out << quint8(NullValue);
+            return;
+        default:
+            out << quint8(StringValue);
+            writeString(out, value.toString());
+            return;
+    }
+}
+
+bool readValue(QDataStream &in, QVariant *value)
+{
+    quint8 tag = 0;
+    in >> tag;
+    switch (tag) {
+        case NullValue:
+            *value = QVariant();
+            break;
+        case BoolValue:
+            *value = readBool(in);
+            break;
+        case IntValue: {
+            qint64 number = 0;
+            in >> number;
+            *value = number;
+            break;
+        }
+        case DoubleValue: {
+            double number = 0;
+            in >> number;
+            *value = number;
+            break;
+        }
+        case StringValue: {
+            QString text;
+            if (!readString(in, &text)) {
+                return false;
+            }
+            *value = text;
+            break;
+        }
+        default:
+            return false;
+    }
+    return in.status() == QDataStream::Ok;
+}
+
+// Записи версий 1–5 хранили значение как QVariant. Разбираются только
+// скалярные типы, которые писали проверки; QDataStream >> QVariant не
+// используется, чтобы запись не могла создать объект произвольного типа
+bool readLegacyValue(QDataStream &in, QVariant *value)
+{
+    quint32 type = 0;
+    qint8 isNull = 0;
+    in >> type >> isNull;
+    switch (type) {
+        case QMetaType::UnknownType: {
+            // Пустой QVariant записан как тип 0 и пустая строка
+            QString unused;
+            in >> unused;
+            *value = QVariant();
+            break;
+        }
+        case QMetaType::Bool: {
+            bool flag = false;
+            in >> flag;
+            *value = flag;
+            break;
+        }
+        case QMetaType::Int: {
+            qint32 number = 0;
+            in >> number;
+            *value = number;
+            break;
+        }
+        case QMetaType::UInt: {
+            quint32 number = 0;
+            in >> number;
+            *value = number;
+            break;
+        }
+        case QMetaType::LongLong: {
+            qint64 number = 0;
+            in >> number;
+            *value = number;
+            break;
+        }
+        case QMetaType::ULongLong: {
+            quint64 number = 0;
+            in >> number;
+            *value = number;
+            break;
+        }
+        case QMetaType::Double: {
+            double number = 0;
+            in >> number;
+            *value = number;
+            break;
+        }
+        case QMetaType::QString: {
+            // Длина строки в байтах UTF-16 сверяется с остатком записи
+            quint32 bytes = 0;
+            in >> bytes;
+            if (bytes == 0xFFFFFFFF) {
+                *value = QString();
+                break;
+            }
+            if (bytes % 2 != 0 || qint64(bytes) > in.device()->bytesAvailable()) {
+                return false;
+            }
+            QByteArray utf16(bytes, Qt::Uninitialized);
+            if (in.readRawData(utf16.data(), bytes) != int(bytes)) {
+                return false;
+            }
+            QString text(bytes / 2, Qt::Uninitialized);
+            for (quint32 i = 0; i < bytes / 2; ++i) {
+                text[i] = QChar(qFromBigEndian<quint16>(utf16.constData() + 2 * i));
+            }
+            *value = text;
+            break;
+        }
+        default:
+            return false;
+    }
+    return in.status() == QDataStream::Ok;
+}
+
+QJsonObject timingToJson(const ProbeTiming &timing)
+{
+    QJsonObject json;
+    json["probeId"] = timing.probeId;
+    json["source"] = timing.source;
+    json["status"] = timing.status;
+    json["exitCode"] = timing.exitCode;
+    json["startUs"] = timing.startUs;
+    json["spawnUs"] = timing.spawnUs;
+    json["firstByteUs"] = timing.firstByteUs;
+    json["totalUs"] = timing.totalUs;
+    json["bytesRead"] = timing.bytesRead;
+    json["parseUs"] = timing.parseUs;
+    return json;
+}
+
+ProbeTiming timingFromJson(const QJsonObject &json)
+{
+    ProbeTiming timing;
+    timing.probeId = json.value("probeId").toString();
+    timing.source = json.value("source").toString();
+    timing.status = json.value("status").toString();
+    timing.exitCode = json.value("exitCode").toInt();
+    timing.startUs = json.value("startUs").toInteger();
+    timing.spawnUs = json.value("spawnUs").toInteger(-1);
+    timing.firstByteUs = json.value("firstByteUs").toInteger(-1);
+    timing.totalUs = json.value("totalUs").toInteger();
+    timing.bytesRead = json.value("bytesRead").toInteger();
+    timing.parseUs = json.value("parseUs").toInteger();
+    return timing;
+}
+
+} // namespace
+
+QJsonObject ResultSerializer::toJson(const DiagnosticResults &results)
+{
+    QJsonObject json;
+    json["schemaVersion"] = int(SchemaVersion);
+    json["machineSerial"] = results.machineSerial;
+    json["machineModel"] = results.machineModel;
+    json["finishedAt"] = results.finishedAt.toUTC().toString(Qt::ISODateWithMs);
+    json["profile"] = results.profile;
+    json["probes"] = QJsonArray::fromStringList(results.probes);
+    json["cycleCounts"] = results.cycleCounts;
+    json["maxCapacity"] = results.maxCapacity;
+    json["batteryCondition"] = results.batteryCondition;
+    json["hasAppleID"] = results.hasAppleID;
+    json["appleIDEmail"] = results.appleIDEmail;
+    json["findMyMacEnabled"] = results.findMyMacEnabled;
+    json["diskCheckPassed"] = results.diskCheckPassed;
+    json["diskStatus"] = results.diskStatus;
+    json["diskCheckTier"] = results.diskCheckTier;
+    json["values"] = QJsonObject::fromVariantMap(results.values);
+    json["recommendations"] = QJsonArray::fromStringList(results.recommendations);
+    json["incompleteProbes"] = QJsonArray::fromStringList(results.incompleteProbes);
+    QJsonArray timings;
+    for (const ProbeTiming &timing : results.timings) {
+        timings.append(timingToJson(timing));
+    }
+    json["timings"] = timings;
+    return json;
+}
+
+QByteArray ResultSerializer::toJsonBytes(const DiagnosticResults &results, bool compact)
+{
+    return QJsonDocument(toJson(results)).toJson(compact ? QJsonDocument::Compact : QJsonDocument::Indented);
+}
+
+bool ResultSerializer::fromJson(const QJsonObject &json, DiagnosticResults *results, QString *error)
+{
+    const int version = json.value("schemaVersion").toInt(-1);
+    if (version < 1 || version > SchemaVersion) {
+        setError(error, QString("Неподдерживаемая версия схемы: %1").arg(version));
+        return false;
+    }
+
+    DiagnosticResults parsed;
+    parsed.machineSerial = json.value("machineSerial").toString();
+    parsed.machineModel = json.value("machineModel").toString();
+    parsed.finishedAt = QDateTime::fromString(json.value("finishedAt").toString(), Qt::ISODateWithMs);
+    parsed.profile = json.value("profile").toString();
+    for (const QJsonValue &probe : json.value("probes").toArray()) {
+        parsed.probes << probe.toString();
+    }
+    parsed.cycleCounts = json.value("cycleCounts").toInt();
+    parsed.maxCapacity = json.value("maxCapacity").toInt();
+    parsed.batteryCondition = json.value("batteryCondition").toString();
+    parsed.hasAppleID = json.value("hasAppleID").toBool();
+    parsed.appleIDEmail = json.value("appleIDEmail").toString();
+    parsed.findMyMacEnabled = json.value("findMyMacEnabled").toBool();
+    parsed.diskCheckPassed = json.value("diskCheckPassed").toBool();
+    parsed.diskStatus = json.value("diskStatus").toString();
+    parsed.diskCheckTier = json.value("diskCheckTier").toString();
+    parsed.values = json.value("values").toObject().toVariantMap();
+    for (const QJsonValue &recommendation : json.value("recommendations").toArray()) {
+        parsed.recommendations << recommendation.toString();
+    }
+    for (const QJsonValue &probe : json.value("incompleteProbes").toArray()) {
+        parsed.incompleteProbes << probe.toString();
+    }
+    for (const QJsonValue &timing : json.value("timings").toArray()) {
+        parsed.timings << timingFromJson(timing.toObject());
+    }
+
+    *results = parsed;
+    return true;
+}
+
+bool ResultSerializer::fromJsonBytes(const QByteArray &data, DiagnosticResults *results, QString *error)
+{
+    QJsonParseError parseError;
+    const QJsonDocument document = QJsonDocument::fromJson(data, &parseError);
+    if (!document.isObject()) {
+        setError(error, parseError.errorString());
+        return false;
+    }
+    return fromJson(document.object(), results, error);
+}
+
+QByteArray ResultSerializer::toBinary(const DiagnosticResults &results)
+{
+    QByteArray payload;
+    {
+        QDataStream out(&payload, QIODevice::WriteOnly);
+        out.setVersion(QDataStream::Qt_6_0);
+
+        writeString(out, results.machineSerial);
+        writeString(out, results.machineModel);
+        out << qint64(results.finishedAt.isValid() ? results.finishedAt.toMSecsSinceEpoch() : 0);
+        out << qint32(results.cycleCounts) << qint32(results.maxCapacity);
+        writeString(out, results.batteryCondition);
+        out << quint8(results.hasAppleID);
+        writeString(out, results.appleIDEmail);
+        out << quint8(results.findMyMacEnabled);
+        out << quint8(results.diskCheckPassed);
+        writeString(out, results.diskStatus);
+
+        out << quint32(results.recommendations.size());
+        for (const QString &recommendation : results.recommendations) {
+            writeString(out, recommendation);
+        }
+
+        out << quint32(results.values.size());
+        for (auto it = results.values.constBegin(); it != results.values.constEnd(); ++it) {
+            writeString(out, it.key());
+            writeValue(out, it.value());
+        }
+
+        out << quint32(results.incompleteProbes.size());
+        for (const QString &probe : results.incompleteProbes) {
+            writeString(out, probe);
+        }
+
+        writeString(out, results.diskCheckTier);
+
+        out << quint32(results.timings.size());
+        for (const ProbeTiming &timing : results.timings) {
+            writeString(out, timing.probeId);
+            writeString(out, timing.source);
+            writeString(out, timing.status);
+            out << qint32(timing.exitCode) << timing.startUs << timing.spawnUs << timing.firstByteUs
+                << timing.totalUs << timing.bytesRead << timing.parseUs;
+        }
+
+        writeString(out, results.profile);
+        out << quint32(results.probes.size());
+        for (const QString &probe : results.probes) {
+            writeString(out, probe);
+        }
+    }
+
+    QByteArray record;
+    record.reserve(HeaderSize + payload.size());
+    QDataStream out(&record, QIODevice::WriteOnly);
+    out << BinaryMagic << SchemaVersion << quint32(payload.size());
+    out.writeRawData(payload.constData(), payload.size());
+    return record;
+}
+
+bool ResultSerializer::fromBinary(const QByteArray &record, DiagnosticResults *results, QString *error)
+{
+    QDataStream in(record);
+    in.setVersion(QDataStream::Qt_6_0);
+
+    quint32 magic = 0;
+    quint16 version = 0;
+    quint32 payloadSize = 0;
+    in >> magic >> version >> payloadSize;
+    if (in.status() != QDataStream::Ok || magic != BinaryMagic) {
+        setError(error, "Не найден заголовок записи");
+        return false;
+    }
+    if (version < 1 || version > SchemaVersion) {
+        setError(error, QString("Неподдерживаемая версия схемы: %1").arg(version));
+        return false;
+    }
+    if (payloadSize > quint32(record.size() - HeaderSize)) {
+        setError(error, "Запись обрезана");
+        return false;
+    }
+
+    DiagnosticResults parsed;
+    qint64 finishedAt = 0;
+    qint32 cycleCounts = 0;
+    qint32 maxCapacity = 0;
+
+    bool ok = readString(in, &parsed.machineSerial)
+            && readString(in, &parsed.machineModel);
+    in >> finishedAt >> cycleCounts >> maxCapacity;
+    ok = ok && readString(in, &parsed.batteryCondition);
+    parsed.hasAppleID = readBool(in);
+    ok = ok && readString(in, &parsed.appleIDEmail);
+    parsed.findMyMacEnabled = readBool(in);
+    parsed.diskCheckPassed = readBool(in);
+    ok = ok && readString(in, &parsed.diskStatus);
+
+    quint32 count = 0;
+    in >> count;
+    for (quint32 i = 0; ok && i < count && in.status() == QDataStream::Ok; ++i) {
+        QString recommendation;
+        ok = readString(in, &recommendation);
+        parsed.recommendations << recommendation;
+    }
+
+    in >> count;
+    for (quint32 i = 0; ok && i < count && in.status() == QDataStream::Ok; ++i) {
+        QString key;
+        QVariant value;
+        ok = readString(in, &key) && (version >= 6 ? readValue(in, &value) : readLegacyValue(in, &value));
+        parsed.values.insert(key, value);
+    }
+
+    if (version >= 2) {
+        in >> count;
+        for (quint32 i = 0; ok && i < count && in.status() == QDataStream::Ok; ++i) {
+            QString probe;
+            ok = readString(in, &probe);
+            parsed.incompleteProbes << probe;
+        }
+    }
+    if (version >= 3) {
+        ok = ok && readString(in, &parsed.diskCheckTier);
+    }
+    if (version >= 4) {
+        in >> count;
+        for (quint32 i = 0; ok && i < count && in.status() == QDataStream::Ok; ++i) {
+            ProbeTiming timing;
+            qint32 exitCode = 0;
+            ok = readString(in, &timing.probeId)
+                    && readString(in, &timing.source)
+                    && readString(in, &timing.status);
+            in >> exitCode >> timing.startUs >> timing.spawnUs >> timing.firstByteUs
+               >> timing.totalUs >> timing.bytesRead >> timing.parseUs;
+            timing.exitCode = exitCode;
+            parsed.timings << timing;
+        }
+    }
+    if (version >= 5) {
+        ok = ok && readString(in, &parsed.profile);
+        in >> count;
+        for (quint32 i = 0; ok && i < count && in.status() == QDataStream::Ok; ++i) {
+            QString probe;
+            ok = readString(in, &probe);
+            parsed.probes << probe;
+        }
+    }
+
+    if (!ok || in.status() != QDataStream::Ok) {
+        setError(error, "Повреждённая запись");
+        return false;
+    }
+
+    parsed.cycleCounts = cycleCounts;
+    parsed.maxCapacity = maxCapacity;
+    if (finishedAt != 0) {
+        parsed.finishedAt = QDateTime::fromMSecsSinceEpoch(finishedAt, QTimeZone::UTC);
+    }
+
+    *results = parsed;
+    return true;
+}
+
+bool ResultSerializer::readBinary(QIODevice *device, DiagnosticResults *results, QString *error, int *skipped)
+{
+    for (;;) {
+        const QByteArray header = device->peek(HeaderSize);
+        if (header.isEmpty()) {
+            setError(error, QString());
+            return false;
+        }
+        if (header.size() < HeaderSize) {
+            setError(error, "Запись обрезана");
+            return false;
+        }
+
+        QDataStream in(header);
+        quint32 magic = 0;
+        quint16 version = 0;
+        quint32 payloadSize = 0;
+        in >> magic >> version >> payloadSize;
+        if (magic != BinaryMagic || payloadSize > MaxPayloadSize) {
+            setError(error, "Не найден заголовок записи");
+            return false;
+        }
+
+        const QByteArray record = device->read(HeaderSize + payloadSize);
+        if (version <= SchemaVersion) {
+            return fromBinary(record, results, error);
+        }
+        if (record.size() < HeaderSize + qint64(payloadSize)) {
+            setError(error, "Запись обрезана");
+            return false;
+        }
+        // Запись новой версии: поля не прочитать, но длина известна
+        if (skipped) {
+            ++*skipped;
+        }
+    }
+}
+
+QByteArray ResultSerializer::toChromeTrace(const DiagnosticResults &results)
+{
+    QJsonArray events;
+
+    QJsonObject processName;
+    processName["name"] = "process_name";
+    processName["ph"] = "M";
+    processName["pid"] = 1;
+    processName["args"] = QJsonObject{{"name", results.machineModel + " " + results.machineSerial}};
+    events.append(processName);
+
+    // Проверки, шедшие одновременно, раскладываются по разным дорожкам
+    QList<ProbeTiming> timings = results.timings;
+    std::stable_sort(timings.begin(), timings.end(), [](const ProbeTiming &a, const ProbeTiming &b) {
+        return a.startUs < b.startUs;
+    });
+    QList<qint64> laneEnds;
+    for (const ProbeTiming &timing : timings) {
+        int lane = 0;
+        while (lane < laneEnds.size() && laneEnds.at(lane) > timing.startUs) {
+            ++lane;
+        }
+        const qint64 end = timing.startUs + qMax<qint64>(1, timing.totalUs);
+        if (lane == laneEnds.size()) {
+            laneEnds.append(end);
+        } else {
+            laneEnds[lane] = end;
+        }
+
+        QJsonObject args = timingToJson(timing);
+        args.remove("probeId");
+        args.remove("startUs");
+        args.remove("totalUs");
+
+        QJsonObject probe;
+        probe["name"] = timing.probeId;
+        probe["cat"] = timing.source;
+        probe["ph"] = "X";
+        probe["ts"] = timing.startUs;
+        probe["dur"] = qMax<qint64>(1, timing.totalUs);
+        probe["pid"] = 1;
+        probe["tid"] = lane + 1;
+        probe["args"] = args;
+        events.append(probe);
+
+        if (timing.spawnUs >= 0) {
+            QJsonObject spawn;
+            spawn["name"] = "spawn";
+            spawn["cat"] = timing.source;
+            spawn["ph"] = "X";
+            spawn["ts"] = timing.startUs;
+            spawn["dur"] = qMax<qint64>(1, timing.spawnUs);
+            spawn["pid"] = 1;
+            spawn["tid"] = lane + 1;
+            events.append(spawn);
+        }
+        if (timing.firstByteUs >= 0) {
+            QJsonObject firstByte;
+            firstByte["name"] = "first byte";
+            firstByte["ph"] = "i";
+            firstByte["s"] = "t";
+            firstByte["ts"] = timing.startUs + timing.firstByteUs;
+            firstByte["pid"] = 1;
+            firstByte["tid"] = lane + 1;
+            events.append(firstByte);
+        }
+    }
+
+    QJsonObject trace;
+    trace["traceEvents"] = events;
+    trace["displayTimeUnit"] = "ms";
+    trace["otherData"] = QJsonObject{
+        {"machineSerial", results.machineSerial},
+        {"machineModel", results.machineModel},
+        {"finishedAt", results.finishedAt.toUTC().toString(Qt::ISODateWithMs)},
+    };
+    return QJsonDocument(trace).toJson(QJsonDocument::Compact);
+}
@@ -0,0 +1,48 @@
+#ifndef RESULTSERIALIZER_H
+#define RESULTSERIALIZER_H
+
+#include <QByteArray>
+#include <QJsonObject>
+#include <QString>
+#include "diagnosticresults.h"
+
+class QIODevice;
+
+// Машиночитаемое представление DiagnosticResults для сборщика отчётов.
+//
+// Двоичная запись: magic "MDR1" (quint32), версия схемы (quint16), длина
+// полезной нагрузки (quint32), затем нагрузка. Все числа big-endian, строки
+// в UTF-8 с длиной quint32. Значения дополнительных проверок (values) —
+// скаляры с тегом типа (quint8): пусто, bool, целое qint64, double, строка;
+// прочие типы пишутся строкой. Длина позволяет читать поток записей подряд и
+// пропускать в нём записи более новых версий схемы (readBinary).
+// fromBinary такую запись не разбирает и возвращает ошибку.
+class ResultSerializer
+{
+public:
+    static const quint32 BinaryMagic = 0x4D445231; // "MDR1"
+    // 2: добавлен список неполных проверок
+    // 3: добавлен уровень проверки диска
+    // 4: добавлено время проверок
+    // 5: добавлены профиль и список его проверок
+    // 6: values — скаляры с тегом вместо QVariant
+    static const quint16 SchemaVersion = 6;
+
+    static QJsonObject toJson(const DiagnosticResults &results);
+    static QByteArray toJsonBytes(const DiagnosticResults &results, bool compact = false);
+    static bool fromJson(const QJsonObject &json, DiagnosticResults *results, QString *error = nullptr);
+    static bool fromJsonBytes(const QByteArray &data, DiagnosticResults *results, QString *error = nullptr);
+
+    static QByteArray toBinary(const DiagnosticResults &results);
+    static bool fromBinary(const QByteArray &record, DiagnosticResults *results, QString *error = nullptr);
+    // Читает следующую запись из потока; false в конце потока или при ошибке.
+    // Записи более новых версий схемы пропускаются по длине, их число
+    // прибавляется к skipped
+    static bool readBinary(QIODevice *device, DiagnosticResults *results, QString *error = nullptr,
+                           int *skipped = nullptr);
+
+    // Время проверок в формате Chrome Trace Event (chrome://tracing, Perfetto)
+    static QByteArray toChromeTrace(const DiagnosticResults &results);
+};
+
+#endif // RESULTSERIALIZER_H
@@ -0,0 +1,544 @@
+#include "runhistory.h"
+#include "resultserializer.h"
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QLockFile>
+#include <QStandardPaths>
+#include <QtEndian>
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+const quint32 IndexMagic = 0x4D444849; // "MDHI"
+// 2: флаги охвата батареи и диска
+const quint16 IndexVersion = 2;
+// magic, версия, флаги, резерв
+const qint64 IndexHeaderSize = 16;
+// Хэш серийного номера, время, смещение, длина, циклы, ёмкость, флаги, резерв
+const qint64 IndexEntrySize = 48;
+// Заголовок двоичной записи ResultSerializer: magic, версия, длина
+const qint64 RecordHeaderSize = 4 + 2 + 4;
+
+enum IndexFlag : quint16 {
+    // Записи идут по возрастанию времени: начало диапазона ищется двоичным
+    // поиском. Сбрасывается, если часы машины перевели назад
+    IndexSorted = 0x1
+};
+
+enum EntryFlag : quint8 {
+    EntryDiskPassed = 0x1,
+    EntryFindMyMac = 0x2,
+    EntryComplete = 0x4,
+    EntryBatteryChecked = 0x8,
+    EntryDiskChecked = 0x10
+};
+
+void setError(QString *error, const QString &message)
+{
+    if (error) {
+        *error = message;
+    }
+}
+
+// FNV-1a: стабилен между версиями Qt и запусками, в отличие от qHash
+quint64 serialKey(const QString &serial)
+{
+    quint64 hash = 14695981039346656037ULL;
+    for (const char c : serial.toUtf8()) {
+        hash ^= quint8(c);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+struct IndexRecord {
+    quint64 key = 0;
+    qint64 finishedAt = 0;
+    quint64 offset = 0;
+    quint32 length = 0;
+    qint32 cycleCounts = 0;
+    qint32 maxCapacity = 0;
+    quint8 flags = 0;
+};
+
+QByteArray encodeHeader(quint16 flags)
+{
+    QByteArray header(IndexHeaderSize, '\0');
+    qToBigEndian<quint32>(IndexMagic, header.data());
+    qToBigEndian<quint16>(IndexVersion, header.data() + 4);
+    qToBigEndian<quint16>(flags, header.data() + 6);
+    return header;
+}
+
+QByteArray encodeRecord(const IndexRecord &record)
+{
+    QByteArray data(IndexEntrySize, '\0');
+    char *out = data.data();
+    qToBigEndian<quint64>(record.key, out);
+    qToBigEndian<qint64>(record.finishedAt, out + 8);
+    qToBigEndian<quint64>(record.offset, out + 16);
+    qToBigEndian<quint32>(record.length, out + 24);
+    qToBigEndian<qint32>(record.cycleCounts, out + 28);
+    qToBigEndian<qint32>(record.maxCapacity, out + 32);
+    out[36] = char(record.flags);
+    return data;
+}
+
+IndexRecord decodeRecord(const uchar *data)
+{
+    IndexRecord record;
+    record.key = qFromBigEndian<quint64>(data);
+    record.finishedAt = qFromBigEndian<qint64>(data + 8);
+    record.offset = qFromBigEndian<quint64>(data + 16);
+    record.length = qFromBigEndian<quint32>(data + 24);
+    record.cycleCounts = qFromBigEndian<qint32>(data + 28);
+    record.maxCapacity = qFromBigEndian<qint32>(data + 32);
+    record.flags = data[36];
+    return record;
+}
+
+IndexRecord indexRecord(const DiagnosticResults &results, qint64 offset, qint64 length)
+{
+    IndexRecord record;
+    record.key = serialKey(results.machineSerial);
+    record.finishedAt = results.finishedAt.isValid() ? results.finishedAt.toMSecsSinceEpoch() : 0;
+    record.offset = quint64(offset);
+    record.length = quint32(length);
+    record.cycleCounts = results.cycleCounts;
+    record.maxCapacity = results.maxCapacity;
+    record.flags = (results.diskCheckPassed ? EntryDiskPassed : 0)
+                   | (results.findMyMacEnabled ? EntryFindMyMac : 0)
+                   | (results.isComplete() ? EntryComplete : 0)
+                   | (results.batteryChecked() ? EntryBatteryChecked : 0)
+                   | (results.diskChecked() ? EntryDiskChecked : 0);
+    return record;
+}
+
+HistoryEntry historyEntry(const IndexRecord &record)
+{
+    HistoryEntry entry;
+    entry.finishedAt = QDateTime::fromMSecsSinceEpoch(record.finishedAt);
+    entry.cycleCounts = record.cycleCounts;
+    entry.maxCapacity = record.maxCapacity;
+    entry.diskCheckPassed = record.flags & EntryDiskPassed;
+    entry.findMyMacEnabled = record.flags & EntryFindMyMac;
+    entry.complete = record.flags & EntryComplete;
+    entry.batteryChecked = record.flags & EntryBatteryChecked;
+    entry.diskChecked = record.flags & EntryDiskChecked;
+    entry.offset = qint64(record.offset);
+    entry.length = record.length;
+    return entry;
+}
+
+// Серийный номер — первая строка нагрузки записи: сверяется без разбора
+// остального, чтобы совпадение 64-битного хэша не подмешало чужую машину
+bool recordSerialIs(const uchar *record, qint64 available, const QByteArray &serial)
+{
+    const qint64 start = RecordHeaderSize + 4;
+    if (available < start) {
+        return false;
+    }
+    const quint32 size = qFromBigEndian<quint32>(record + RecordHeaderSize);
+    return size == quint32(serial.size()) && available >= start + size
+           && memcmp(record + start, serial.constData(), size) == 0;
+}
+
+// Чем закончился проход по файлу данных
+enum TailState {
+    TailIndexed,    // все записи в индексе
+    TailIncomplete, // последняя запись не дописана до конца файла
+    TailCorrupt     // заголовок записи повреждён
+};
+
+// Дописывает в индекс записи файла данных начиная с from. Файл данных не
+// меняется: на недописанной или повреждённой записи проход
+// останавливается, её смещение возвращается в end
+bool indexTail(QFile &index, QFile &data, qint64 from, quint16 *flags, qint64 *lastTime,
+               TailState *state, qint64 *end, QString *error)
+{
+    if (!data.seek(from) || !index.seek(index.size())) {
+        setError(error, data.errorString());
+        return false;
+    }
+
+    *state = TailIndexed;
+    qint64 position = from;
+    while (position < data.size()) {
+        const QByteArray header = data.peek(RecordHeaderSize);
+        if (header.size() < RecordHeaderSize) {
+            *state = TailIncomplete;
+            break;
+        }
+        if (qFromBigEndian<quint32>(header.constData()) != ResultSerializer::BinaryMagic) {
+            *state = TailCorrupt;
+            break;
+        }
+        const qint64 length = RecordHeaderSize + qFromBigEndian<quint32>(header.constData() + 6);
+        if (position + length > data.size()) {
+            *state = TailIncomplete;
+            break;
+        }
+
+        const QByteArray record = data.read(length);
+        DiagnosticResults results;
+        if (ResultSerializer::fromBinary(record, &results)) {
+            const IndexRecord entry = indexRecord(results, position, length);
+            if (entry.finishedAt < *lastTime) {
+                *flags &= ~IndexSorted;
+            }
+            *lastTime = qMax(*lastTime, entry.finishedAt);
+            index.write(encodeRecord(entry));
+        } else {
+            // Запись более новой версии: остаётся в файле, но не в индексе
+            qDebug() << "Skipping unreadable history record at" << position;
+        }
+        position += length;
+    }
+
+    *end = position;
+    return index.seek(6) && index.write(encodeHeader(*flags).mid(6, 2)) == 2;
+}
+
+// Недописанную последнюю запись отрезает только append() под блокировкой:
+// при чтении это может быть запись, которую прямо сейчас дописывают, а
+// повреждённый заголовок — не повод удалять все записи после него
+bool finishTail(QFile &data, TailState state, qint64 end, bool dropIncompleteTail, QString *error)
+{
+    if (state == TailIndexed) {
+        return true;
+    }
+    if (state == TailIncomplete && dropIncompleteTail) {
+        qWarning() << "Dropping incomplete history record at" << end;
+        if (!data.resize(end)) {
+            setError(error, data.errorString());
+            return false;
+        }
+        return true;
+    }
+    setError(error, QString(state == TailCorrupt ? "Повреждена запись истории со смещения %1"
+                                                 : "Не дописана запись истории со смещения %1")
+                        .arg(end));
+    return false;
+}
+
+} // namespace
+
+RunHistory::RunHistory(const QString &directory)
+    : historyDirectory(directory)
+{
+    if (historyDirectory.isEmpty()) {
+        historyDirectory = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/history";
+    }
+}
+
+QString RunHistory::dataPath() const
+{
+    return historyDirectory + "/runs.mdr";
+}
+
+QString RunHistory::indexPath() const
+{
+    return historyDirectory + "/runs.idx";
+}
+
+bool RunHistory::syncIndex(bool dropIncompleteTail, QString *error)
+{
+    QFile index(indexPath());
+    if (!index.open(QIODevice::ReadOnly)) {
+        return rebuild(dropIncompleteTail, error);
+    }
+
+    const QByteArray header = index.read(IndexHeaderSize);
+    if (header.size() < IndexHeaderSize || qFromBigEndian<quint32>(header.constData()) != IndexMagic
+        || qFromBigEndian<quint16>(header.constData() + 4) != IndexVersion) {
+        index.close();
+        return rebuild(dropIncompleteTail, error);
+    }
+
+    // Конец последней проиндексированной записи должен совпасть с концом
+    // файла данных
+    const qint64 entries = (index.size() - IndexHeaderSize) / IndexEntrySize;
+    qint64 indexedEnd = 0;
+    qint64 lastTime = 0;
+    if (entries > 0) {
+        index.seek(IndexHeaderSize + (entries - 1) * IndexEntrySize);
+        const QByteArray last = index.read(IndexEntrySize);
+        const IndexRecord record = decodeRecord(reinterpret_cast<const uchar *>(last.constData()));
+        indexedEnd = qint64(record.offset) + record.length;
+        lastTime = record.finishedAt;
+    }
+    index.close();
+
+    const qint64 dataSize = QFileInfo(dataPath()).size();
+    if (dataSize == indexedEnd && index.size() == IndexHeaderSize + entries * IndexEntrySize) {
+        return true;
+    }
+    if (dataSize < indexedEnd) {
+        return rebuild(dropIncompleteTail, error);
+    }
+
+    QFile data(dataPath());
+    if (!index.open(QIODevice::ReadWrite)
+        || !data.open(dropIncompleteTail ? QIODevice::ReadWrite : QIODevice::ReadOnly)) {
+        setError(error, index.errorString() + " " + data.errorString());
+        return false;
+    }
+    // Обрывок записи индекса отрезается
+    index.resize(IndexHeaderSize + entries * IndexEntrySize);
+    quint16 flags = qFromBigEndian<quint16>(header.constData() + 6);
+    TailState state = TailIndexed;
+    qint64 end = indexedEnd;
+    return indexTail(index, data, indexedEnd, &flags, &lastTime, &state, &end, error)
+           && finishTail(data, state, end, dropIncompleteTail, error);
+}
+
+bool RunHistory::rebuildIndex(QString *error)
+{
+    return rebuild(false, error);
+}
+
+bool RunHistory::rebuild(bool dropIncompleteTail, QString *error)
+{
+    QDir().mkpath(historyDirectory);
+    QFile index(indexPath());
+    QFile data(dataPath());
+    if (!index.open(QIODevice::ReadWrite | QIODevice::Truncate)
+        || !data.open(dropIncompleteTail ? QIODevice::ReadWrite : QIODevice::ReadOnly)) {
+        setError(error, index.errorString() + " " + data.errorString());
+        return false;
+    }
+
+    quint16 flags = IndexSorted;
+    qint64 lastTime = 0;
+    index.write(encodeHeader(flags));
+    TailState state = TailIndexed;
+    qint64 end = 0;
+    return indexTail(index, data, 0, &flags, &lastTime, &state, &end, error)
+           && finishTail(data, state, end, dropIncompleteTail, error);
+}
+
+bool RunHistory::updateIndex(QString *error)
+{
+    if (!QFileInfo::exists(dataPath())) {
+        return true;
+    }
+    QLockFile lock(historyDirectory + "/history.lock");
+    if (!lock.tryLock(5000)) {
+        setError(error, "История занята другим процессом");
+        return false;
+    }
+    return syncIndex(false, error);
+}
+
+bool RunHistory::append(const DiagnosticResults &results, QString *error)
+{
+    if (!QDir().mkpath(historyDirectory)) {
+        setError(error, "Не удалось создать каталог истории: " + historyDirectory);
+        return false;
+    }
+
+    // Окно, консольный режим и агент могут дописывать историю одновременно
+    QLockFile lock(historyDirectory + "/history.lock");
+    if (!lock.tryLock(5000)) {
+        setError(error, "История занята другим процессом");
+        return false;
+    }
+    // Только здесь, под блокировкой, можно отрезать запись, прерванную
+    // при прошлом дописывании
+    if (!syncIndex(true, error)) {
+        return false;
+    }
+
+    QFile data(dataPath());
+    QFile index(indexPath());
+    if (!data.open(QIODevice::WriteOnly | QIODevice::Append) || !index.open(QIODevice::ReadWrite)) {
+        setError(error, data.errorString() + " " + index.errorString());
+        return false;
+    }
+
+    // Сначала данные, потом индекс: если запись прервётся между ними,
+    // syncIndex доиндексирует хвост при следующем обращении
+    const QByteArray record = ResultSerializer::toBinary(results);
+    const qint64 offset = data.size();
+    if (data.write(record) != record.size() || !data.flush()) {
+        setError(error, data.errorString());
+        return false;
+    }
+
+    const IndexRecord entry = indexRecord(results, offset, record.size());
+    const QByteArray header = index.read(IndexHeaderSize);
+    quint16 flags = qFromBigEndian<quint16>(header.constData() + 6);
+    if ((flags & IndexSorted) && index.size() > IndexHeaderSize) {
+        index.seek(index.size() - IndexEntrySize);
+        const QByteArray last = index.read(IndexEntrySize);
+        if (decodeRecord(reinterpret_cast<const uchar *>(last.constData())).finishedAt > entry.finishedAt) {
+            flags &= ~IndexSorted;
+            index.seek(6);
+            index.write(encodeHeader(flags).mid(6, 2));
+        }
+    }
+
+    index.seek(index.size());
+    if (index.write(encodeRecord(entry)) != IndexEntrySize || !index.flush()) {
+        setError(error, index.errorString());
+        return false;
+    }
+    return true;
+}
+
+QList<HistoryEntry> RunHistory::entries(const QString &machineSerial, const QDateTime &since) const
+{
+    QList<HistoryEntry> found;
+    QFile index(indexPath());
+    if (!index.open(QIODevice::ReadOnly) || index.size() < IndexHeaderSize) {
+        return found;
+    }
+
+    // Индекс отображается в память целиком: за годы запусков это мегабайты
+    QByteArray copy;
+    const uchar *data = index.map(0, index.size());
+    if (!data) {
+        copy = index.readAll();
+        data = reinterpret_cast<const uchar *>(copy.constData());
+    }
+    if (qFromBigEndian<quint32>(data) != IndexMagic || qFromBigEndian<quint16>(data + 4) != IndexVersion) {
+        return found;
+    }
+
+    const quint16 flags = qFromBigEndian<quint16>(data + 6);
+    const qint64 count = (index.size() - IndexHeaderSize) / IndexEntrySize;
+    const uchar *first = data + IndexHeaderSize;
+    const qint64 from = since.isValid() ? since.toMSecsSinceEpoch() : 0;
+
+    qint64 begin = 0;
+    if ((flags & IndexSorted) && from > 0) {
+        qint64 low = 0;
+        qint64 high = count;
+        while (low < high) {
+            const qint64 middle = (low + high) / 2;
+            if (qFromBigEndian<qint64>(first + middle * IndexEntrySize + 8) < from) {
+                low = middle + 1;
+            } else {
+                high = middle;
+            }
+        }
+        begin = low;
+    }
+
+    // Начала записей с подходящим хэшем читаются из файла данных,
+    // отображённого в память, иначе — по одному
+    QFile recordData(dataPath());
+    if (!recordData.open(QIODevice::ReadOnly)) {
+        return found;
+    }
+    const uchar *records = recordData.map(0, recordData.size());
+    const QByteArray serial = machineSerial.toUtf8();
+
+    const quint64 key = serialKey(machineSerial);
+    for (qint64 i = begin; i < count; ++i) {
+        const uchar *entry = first + i * IndexEntrySize;
+        if (qFromBigEndian<quint64>(entry) != key) {
+            continue;
+        }
+        const IndexRecord record = decodeRecord(entry);
+        if (record.finishedAt < from || qint64(record.offset) >= recordData.size()) {
+            continue;
+        }
+        const qint64 available = qMin<qint64>(record.length, recordData.size() - qint64(record.offset));
+        bool sameMachine = false;
+        if (records) {
+            sameMachine = recordSerialIs(records + record.offset, available, serial);
+        } else if (recordData.seek(qint64(record.offset))) {
+            const QByteArray head = recordData.read(qMin<qint64>(available, RecordHeaderSize + 4 + serial.size()));
+            sameMachine = recordSerialIs(reinterpret_cast<const uchar *>(head.constData()), head.size(), serial);
+        }
+        if (sameMachine) {
+            found << historyEntry(record);
+        }
+    }
+
+    if (!(flags & IndexSorted)) {
+        std::stable_sort(found.begin(), found.end(), [](const HistoryEntry &a, const HistoryEntry &b) {
+            return a.finishedAt < b.finishedAt;
+        });
+    }
+    return found;
+}
+
+bool RunHistory::readRecord(const HistoryEntry &entry, DiagnosticResults *results, QString *error) const
+{
+    QFile data(dataPath());
+    if (!data.open(QIODevice::ReadOnly) || !data.seek(entry.offset)) {
+        setError(error, data.errorString());
+        return false;
+    }
+    return ResultSerializer::fromBinary(data.read(entry.length), results, error);
+}
+
+QString RunHistory::trendText(const QString &machineSerial, const QList<HistoryEntry> &entries)
+{
+    QString text = QString("=== История %1: %2 запусков ===\n").arg(machineSerial).arg(entries.size());
+    if (entries.isEmpty()) {
+        return text;
+    }
+
+    // Значения, которые запуск не проверял, показываются прочерком
+    text += QString("%1 %2 %3 %4\n").arg("дата", -17).arg("циклы", 7).arg("ёмкость", 8).arg("диск");
+    for (const HistoryEntry &entry : entries) {
+        text += QString("%1 %2 %3 %4%5\n")
+                    .arg(entry.finishedAt.toLocalTime().toString("yyyy-MM-dd HH:mm"), -17)
+                    .arg(entry.batteryChecked ? QString::number(entry.cycleCounts) : QString("—"), 7)
+                    .arg(entry.batteryChecked ? QString::number(entry.maxCapacity) + "%" : QString("—"), 8)
+                    .arg(!entry.diskChecked ? "—" : entry.diskCheckPassed ? "ок" : "проблемы")
+                    .arg(entry.complete ? QString() : QString(" (неполный)"));
+    }
+
+    // Изменение считается только между запусками, проверявшими батарею
+    QList<HistoryEntry> measured;
+    for (const HistoryEntry &entry : entries) {
+        if (entry.batteryChecked) {
+            measured << entry;
+        }
+    }
+    if (measured.size() < 2) {
+        return text;
+    }
+    const HistoryEntry &oldest = measured.first();
+    const HistoryEntry &latest = measured.last();
+    text += QString("Изменение за %1 дн.: циклы %2%3, ёмкость %4%5%\n")
+                .arg(oldest.finishedAt.daysTo(latest.finishedAt))
+                .arg(latest.cycleCounts >= oldest.cycleCounts ? "+" : "")
+                .arg(latest.cycleCounts - oldest.cycleCounts)
+                .arg(latest.maxCapacity >= oldest.maxCapacity ? "+" : "")
+                .arg(latest.maxCapacity - oldest.maxCapacity);
+    return text;
+}
+
+QByteArray RunHistory::trendJson(const QString &machineSerial, const QList<HistoryEntry> &entries)
+{
+    QJsonArray runs;
+    for (const HistoryEntry &entry : entries) {
+        // Непроверенные значения — null, а не нули по умолчанию
+        QJsonObject run;
+        run["finishedAt"] = entry.finishedAt.toUTC().toString(Qt::ISODateWithMs);
+        run["cycleCounts"] = entry.batteryChecked ? QJsonValue(entry.cycleCounts) : QJsonValue();
+        run["maxCapacity"] = entry.batteryChecked ? QJsonValue(entry.maxCapacity) : QJsonValue();
+        run["diskCheckPassed"] = entry.diskChecked ? QJsonValue(entry.diskCheckPassed) : QJsonValue();
+        run["findMyMacEnabled"] = entry.findMyMacEnabled;
+        run["complete"] = entry.complete;
+        run["batteryChecked"] = entry.batteryChecked;
+        run["diskChecked"] = entry.diskChecked;
+        runs.append(run);
+    }
+
+    QJsonObject history;
+    history["machineSerial"] = machineSerial;
+    history["runs"] = runs;
+    return QJsonDocument(history).toJson();
+}
@@ -0,0 +1,69 @@
+#ifndef RUNHISTORY_H
+#define RUNHISTORY_H
+
+#include <QDateTime>
+#include <QList>
+#include <QString>
+#include "diagnosticresults.h"
+
+// Одна строка индекса истории: то, что нужно для трендов, без чтения записи
+struct HistoryEntry {
+    QDateTime finishedAt;
+    int cycleCounts = 0;
+    int maxCapacity = 0;
+    bool diskCheckPassed = false;
+    bool findMyMacEnabled = false;
+    bool complete = false;
+    // Охват запуска: без него значения батареи и диска — нули по умолчанию,
+    // а не измерения, и в тренды не попадают
+    bool batteryChecked = false;
+    bool diskChecked = false;
+    // Положение полной записи в файле данных
+    qint64 offset = 0;
+    qint64 length = 0;
+};
+
+// История запусков на этой машине: append-only файл записей
+// ResultSerializer (runs.mdr) и индекс записей фиксированного размера
+// (runs.idx) с хэшем серийного номера, временем и значениями для трендов.
+// Запрос по машине читает индекс и сверяет серийный номер в начале записи;
+// полная запись читается по смещению. Индекс можно восстановить из файла
+// данных, если запись в него прервалась. Файл данных меняет только append():
+// недописанную последнюю запись он отрезает под блокировкой, а чтение и
+// пересборка индекса на повреждённой записи останавливаются с ошибкой.
+class RunHistory
+{
+public:
+    // Пустой путь — каталог данных приложения
+    explicit RunHistory(const QString &directory = QString());
+
+    QString directory() const { return historyDirectory; }
+
+    bool append(const DiagnosticResults &results, QString *error = nullptr);
+    // Доиндексирует записи, дописанные другими процессами, и пересобирает
+    // индекс старого формата. append() делает это сам
+    bool updateIndex(QString *error = nullptr);
+
+    // Запуски машины в порядке времени; since — не раньше этого момента
+    QList<HistoryEntry> entries(const QString &machineSerial, const QDateTime &since = QDateTime()) const;
+    bool readRecord(const HistoryEntry &entry, DiagnosticResults *results, QString *error = nullptr) const;
+
+    // Пересобирает индекс по файлу данных; сам файл данных не меняется
+    bool rebuildIndex(QString *error = nullptr);
+
+    // Таблица трендов для отчёта
+    static QString trendText(const QString &machineSerial, const QList<HistoryEntry> &entries);
+    static QByteArray trendJson(const QString &machineSerial, const QList<HistoryEntry> &entries);
+
+private:
+    QString dataPath() const;
+    QString indexPath() const;
+    // dropIncompleteTail — отрезать недописанную последнюю запись
+    // (только для append под блокировкой)
+    bool syncIndex(bool dropIncompleteTail, QString *error);
+    bool rebuild(bool dropIncompleteTail, QString *error);
+
+    QString historyDirectory;
+};
+
+#endif // RUNHISTORY_H
@@ -0,0 +1,10 @@
+# DiagnosticResults и их сериализация (JSON, двоичные записи) без остального
+# ядра: нужны и ядру, и сборщику отчётов парка
+INCLUDEPATH += $$PWD
+
+SOURCES += \
+    $$PWD/resultserializer.cpp
+
+HEADERS += \
+    $$PWD/diagnosticresults.h \
+    $$PWD/resultserializer.h
@@ -0,0 +1,428 @@
+#include "spawnrunner.h"
+
+#ifdef Q_OS_UNIX
+#include <QDebug>
+#include <QFile>
+#include <QMutex>
+#include <QSharedPointer>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <thread>
+#include <vector>
+
+extern char **environ;
+
+namespace {
+
+// Один буфер чтения на все каналы
+const int ReadBufferSize = 64 * 1024;
+// Канал закрыт, процесс ещё не завершился: обычно это доли миллисекунды.
+// Первые ExitFastPolls опросов идут часто, дальше — раз в ReapPollMs, чтобы
+// команда, закрывшая вывод задолго до выхода, не крутила поток впустую
+const int ExitPollMs = 1;
+const int ExitFastPolls = 10;
+// Процесс мог завершиться, оставив канал открытым у своих потомков
+const int ReapPollMs = 100;
+
+class SpawnProbeProcess;
+
+// Общее состояние запуска: поток чтения дописывает вывод и итог, объект
+// процесса в своём потоке забирает их в deliver()
+struct SpawnChannel {
+    QMutex mutex;
+    // nullptr — объект процесса удалён, вывод больше некому отдавать
+    SpawnProbeProcess *receiver = nullptr;
+    QByteArray pending;
+    bool notifyPosted = false;
+    bool spawned = false;
+    bool exited = false;
+    int exitCode = 0;
+    bool normalExit = false;
+
+    // Вызывается под mutex
+    void post();
+};
+
+class SpawnReactor
+{
+public:
+    SpawnReactor();
+    ~SpawnReactor();
+
+    void add(pid_t pid, int fd, const QSharedPointer<SpawnChannel> &channel);
+    void kill(const QSharedPointer<SpawnChannel> &channel);
+
+private:
+    struct Child {
+        pid_t pid;
+        // -1 — канал закрыт
+        int fd;
+        QSharedPointer<SpawnChannel> channel;
+        // Частых опросов после закрытия канала
+        int exitPolls = 0;
+    };
+
+    void run();
+    void wake();
+    // false — канал закрыт
+    bool drain(Child &child);
+    void closeChild(Child &child);
+
+    QMutex mutex;
+    QList<Child> incoming;
+    QList<QSharedPointer<SpawnChannel>> killRequests;
+    bool stopping;
+
+    int wakePipe[2];
+    std::vector<Child> children;
+    QByteArray buffer;
+    std::thread thread;
+};
+
+Q_GLOBAL_STATIC(SpawnReactor, spawnReactor)
+
+class SpawnProbeProcess : public ProbeProcess
+{
+public:
+    explicit SpawnProbeProcess(QObject *parent)
+        : ProbeProcess(parent), channel(new SpawnChannel), finishedEmitted(false)
+    {
+        channel->receiver = this;
+    }
+
+    ~SpawnProbeProcess() override
+    {
+        bool running = false;
+        {
+            QMutexLocker locker(&channel->mutex);
+            channel->receiver = nullptr;
+            running = channel->spawned && !channel->exited;
+        }
+        // Как QProcess: удаление объекта не оставляет команду работать
+        SpawnReactor *reactor = spawnReactor();
+        if (running && reactor) {
+            reactor->kill(channel);
+        }
+    }
+
+    void start(const QString &probeId, const QString &program, const QStringList &arguments) override
+    {
+        Q_UNUSED(probeId);
+
+        QByteArrayList encoded;
+        encoded << QFile::encodeName(program);
+        for (const QString &argument : arguments) {
+            encoded << argument.toLocal8Bit();
+        }
+        std::vector<char *> argv;
+        for (QByteArray &argument : encoded) {
+            argv.push_back(argument.data());
+        }
+        argv.push_back(nullptr);
+
+        int pipeFds[2];
+#ifdef Q_OS_LINUX
+        const int piped = ::pipe2(pipeFds, O_CLOEXEC);
+#else
+        const int piped = ::pipe(pipeFds);
+        if (piped == 0) {
+            ::fcntl(pipeFds[0], F_SETFD, FD_CLOEXEC);
+            ::fcntl(pipeFds[1], F_SETFD, FD_CLOEXEC);
+        }
+#endif
+        if (piped != 0) {
+            fail(QString::fromLocal8Bit(::strerror(errno)));
+            return;
+        }
+
+        posix_spawn_file_actions_t actions;
+        posix_spawn_file_actions_init(&actions);
+        posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+        posix_spawn_file_actions_adddup2(&actions, pipeFds[1], STDOUT_FILENO);
+        posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, "/dev/null", O_WRONLY, 0);
+
+        // Своя группа процессов, чтобы kill() завершал и потомков команды;
+        // маска и обработчики сигналов родителя не наследуются
+        posix_spawnattr_t attributes;
+        posix_spawnattr_init(&attributes);
+        sigset_t signals;
+        sigemptyset(&signals);
+        posix_spawnattr_setsigmask(&attributes, &signals);
+        sigaddset(&signals, SIGPIPE);
+        posix_spawnattr_setsigdefault(&attributes, &signals);
+        posix_spawnattr_setpgroup(&attributes, 0);
+        short flags = POSIX_SPAWN_SETPGROUP | POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF;
+#ifdef POSIX_SPAWN_CLOEXEC_DEFAULT
+        // macOS: остальные дескрипторы родителя в команду не попадают
+        flags |= POSIX_SPAWN_CLOEXEC_DEFAULT;
+#endif
+        posix_spawnattr_setflags(&attributes, flags);
+
+        pid_t pid = 0;
+        const int error = ::posix_spawnp(&pid, argv.front(), &actions, &attributes, argv.data(), environ);
+        posix_spawn_file_actions_destroy(&actions);
+        posix_spawnattr_destroy(&attributes);
+        ::close(pipeFds[1]);
+
+        if (error != 0) {
+            ::close(pipeFds[0]);
+            fail(QString::fromLocal8Bit(::strerror(error)));
+            return;
+        }
+
+        ::fcntl(pipeFds[0], F_SETFL, ::fcntl(pipeFds[0], F_GETFL) | O_NONBLOCK);
+        {
+            QMutexLocker locker(&channel->mutex);
+            channel->spawned = true;
+        }
+        // started ставится в очередь раньше первого deliver()
+        QMetaObject::invokeMethod(this, [this]() { emit started(); }, Qt::QueuedConnection);
+        spawnReactor()->add(pid, pipeFds[0], channel);
+    }
+
+    void kill() override
+    {
+        if (SpawnReactor *reactor = spawnReactor()) {
+            reactor->kill(channel);
+        }
+    }
+
+    // В потоке объекта: отдаёт накопленный вывод и, после него, итог
+    void deliver()
+    {
+        bool exited = false;
+        int exitCode = 0;
+        bool normalExit = false;
+        {
+            QMutexLocker locker(&channel->mutex);
+            channel->notifyPosted = false;
+            // Буферы меняются местами и сохраняют выделенную память
+            delivered.swap(channel->pending);
+            exited = channel->exited;
+            exitCode = channel->exitCode;
+            normalExit = channel->normalExit;
+        }
+
+        if (!delivered.isEmpty()) {
+            emit outputReady(delivered);
+            delivered.resize(0);
+        }
+        if (exited && !finishedEmitted) {
+            finishedEmitted = true;
+            emit finished(exitCode, normalExit);
+        }
+    }
+
+private:
+    void fail(const QString &error)
+    {
+        QMetaObject::invokeMethod(this, [this, error]() { emit failedToStart(error); }, Qt::QueuedConnection);
+    }
+
+    QSharedPointer<SpawnChannel> channel;
+    QByteArray delivered;
+    bool finishedEmitted;
+};
+
+void SpawnChannel::post()
+{
+    if (receiver && !notifyPosted) {
+        notifyPosted = true;
+        // Если объект удалят раньше, Qt отбросит вызов вместе с ним
+        SpawnProbeProcess *target = receiver;
+        QMetaObject::invokeMethod(target, [target]() { target->deliver(); }, Qt::QueuedConnection);
+    }
+}
+
+SpawnReactor::SpawnReactor()
+    : stopping(false), buffer(ReadBufferSize, Qt::Uninitialized)
+{
+    if (::pipe(wakePipe) != 0) {
+        qFatal("SpawnReactor: pipe() failed: %s", ::strerror(errno));
+    }
+    for (const int fd : wakePipe) {
+        ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+        ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+    }
+    thread = std::thread([this]() { run(); });
+}
+
+SpawnReactor::~SpawnReactor()
+{
+    {
+        QMutexLocker locker(&mutex);
+        stopping = true;
+    }
+    wake();
+    thread.join();
+
+    // При выходе из программы незавершённые команды не остаются работать
+    for (const Child &child : incoming) {
+        children.push_back(child);
+    }
+    for (Child &child : children) {
+        ::kill(-child.pid, SIGKILL);
+        ::waitpid(child.pid, nullptr, 0);
+        if (child.fd >= 0) {
+            ::close(child.fd);
+        }
+    }
+    ::close(wakePipe[0]);
+    ::close(wakePipe[1]);
+}
+
+void SpawnReactor::add(pid_t pid, int fd, const QSharedPointer<SpawnChannel> &channel)
+{
+    {
+        QMutexLocker locker(&mutex);
+        incoming.append(Child{pid, fd, channel});
+    }
+    wake();
+}
+
+void SpawnReactor::kill(const QSharedPointer<SpawnChannel> &channel)
+{
+    // Сигнал посылает поток чтения: только он знает, что pid ещё не собран
+    // waitpid и не достался другому процессу
+    {
+        QMutexLocker locker(&mutex);
+        killRequests.append(channel);
+    }
+    wake();
+}
+
+void SpawnReactor::wake()
+{
+    const char byte = 0;
+    // Полный канал уже разбудит поток
+    while (::write(wakePipe[1], &byte, 1) < 0 && errno == EINTR) {
+    }
+}
+
+bool SpawnReactor::drain(Child &child)
+{
+    for (;;) {
+        const ssize_t size = ::read(child.fd, buffer.data(), buffer.size());
+        if (size > 0) {
+            QMutexLocker locker(&child.channel->mutex);
+            child.channel->pending.append(buffer.constData(), size);
+            child.channel->post();
+            continue;
+        }
+        if (size < 0 && errno == EINTR) {
+            continue;
+        }
+        if (size < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return true;
+        }
+        // Конец вывода или ошибка канала
+        closeChild(child);
+        return false;
+    }
+}
+
+void SpawnReactor::closeChild(Child &child)
+{
+    if (child.fd >= 0) {
+        ::close(child.fd);
+        child.fd = -1;
+    }
+}
+
+void SpawnReactor::run()
+{
+    std::vector<pollfd> pollFds;
+    std::vector<Child *> polled;
+
+    for (;;) {
+        QList<QSharedPointer<SpawnChannel>> kills;
+        {
+            QMutexLocker locker(&mutex);
+            if (stopping) {
+                return;
+            }
+            for (const Child &child : incoming) {
+                children.push_back(child);
+            }
+            incoming.clear();
+            kills.swap(killRequests);
+        }
+        for (const QSharedPointer<SpawnChannel> &channel : kills) {
+            for (const Child &child : children) {
+                if (child.channel == channel) {
+                    ::kill(-child.pid, SIGKILL);
+                }
+            }
+        }
+
+        pollFds.clear();
+        polled.clear();
+        pollFds.push_back(pollfd{wakePipe[0], POLLIN, 0});
+        bool awaitingExit = false;
+        for (Child &child : children) {
+            if (child.fd >= 0) {
+                pollFds.push_back(pollfd{child.fd, POLLIN, 0});
+                polled.push_back(&child);
+            } else if (child.exitPolls < ExitFastPolls) {
+                ++child.exitPolls;
+                awaitingExit = true;
+            }
+        }
+
+        const int timeout = awaitingExit ? ExitPollMs : children.empty() ? -1 : ReapPollMs;
+        if (::poll(pollFds.data(), nfds_t(pollFds.size()), timeout) < 0 && errno != EINTR) {
+            qWarning() << "SpawnReactor: poll() failed:" << ::strerror(errno);
+        }
+
+        if (pollFds.front().revents & POLLIN) {
+            char discard[64];
+            while (::read(wakePipe[0], discard, sizeof(discard)) > 0) {
+            }
+        }
+        for (size_t i = 1; i < pollFds.size(); ++i) {
+            if (pollFds[i].revents & (POLLIN | POLLHUP | POLLERR)) {
+                drain(*polled[i - 1]);
+            }
+        }
+
+        // Завершившиеся процессы: остаток канала, затем итог
+        for (auto it = children.begin(); it != children.end();) {
+            int status = 0;
+            const pid_t reaped = ::waitpid(it->pid, &status, WNOHANG);
+            if (reaped == 0 || (reaped < 0 && errno == EINTR)) {
+                ++it;
+                continue;
+            }
+            if (it->fd >= 0) {
+                drain(*it);
+                closeChild(*it);
+            }
+
+            QMutexLocker locker(&it->channel->mutex);
+            it->channel->exited = true;
+            it->channel->normalExit = reaped > 0 && WIFEXITED(status);
+            it->channel->exitCode = it->channel->normalExit ? WEXITSTATUS(status) : -1;
+            it->channel->post();
+            locker.unlock();
+            it = children.erase(it);
+        }
+    }
+}
+
+} // namespace
+#endif
+
+ProbeProcess *SpawnCommandRunner::createProcess(QObject *parent) const
+{
+#ifdef Q_OS_UNIX
+    return new SpawnProbeProcess(parent);
+#else
+    return SystemCommandRunner::createProcess(parent);
+#endif
+}
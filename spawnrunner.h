@@ -0,0 +1,20 @@
+#ifndef SPAWNRUNNER_H
+#define SPAWNRUNNER_H
+
+#include "commandrunner.h"
+
+// Запуск команд проверок без QProcess: posix_spawn с готовым вектором
+// аргументов, stdin и stderr — /dev/null, своя группа процессов. Каналы
+// всех дочерних процессов обслуживает один поток с poll(): он читает их в
+// общий буфер и складывает вывод в двойной буфер каждого процесса, а тот
+// забирает накопленное одним сигналом outputReady. Рассчитан на десятки
+// одновременных проверок в режиме агента и парка.
+//
+// Вне Unix работает как SystemCommandRunner.
+class SpawnCommandRunner : public SystemCommandRunner
+{
+public:
+    ProbeProcess *createProcess(QObject *parent) const override;
+};
+
+#endif // SPAWNRUNNER_H
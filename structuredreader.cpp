@@ -0,0 +1,57 @@
+#include "structuredreader.h"
+
+void PlistStreamReader::addData(const QByteArray &chunk)
+{
+    xml.addData(chunk);
+    readAvailable();
+}
+
+bool PlistStreamReader::finishData()
+{
+    readAvailable();
+    return !xml.hasError() && xml.atEnd();
+}
+
+void PlistStreamReader::readAvailable()
+{
+    while (!xml.atEnd()) {
+        const QXmlStreamReader::TokenType token = xml.readNext();
+
+        if (token == QXmlStreamReader::Invalid) {
+            // Документ ещё не пришёл целиком: ждём следующую порцию
+            return;
+        }
+
+        // resize(0) вместо clear(): буферы сохраняют память между элементами
+        if (token == QXmlStreamReader::StartElement) {
+            const QStringView name = xml.name();
+            text.resize(0);
+            if (name == u"dict") {
+                dictStarted(currentKey);
+                clearKey();
+            } else if (name == u"array") {
+                clearKey();
+            }
+        } else if (token == QXmlStreamReader::Characters) {
+            text.append(xml.text());
+        } else if (token == QXmlStreamReader::EndElement) {
+            const QStringView name = xml.name();
+            if (name == u"dict" || name == u"array") {
+                if (name == u"dict") {
+                    dictFinished();
+                }
+                clearKey();
+            } else if (name == u"key") {
+                currentKey.resize(0);
+                currentKey.append(text);
+            } else if (name == u"true" || name == u"false") {
+                scalarValue(currentKey, name);
+                clearKey();
+            } else if (name != u"plist") {
+                scalarValue(currentKey, text);
+                clearKey();
+            }
+            text.resize(0);
+        }
+    }
+}
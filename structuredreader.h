@@ -0,0 +1,41 @@
+#ifndef STRUCTUREDREADER_H
+#define STRUCTUREDREADER_H
+
+#include <QByteArray>
+#include <QString>
+#include <QStringView>
+#include <QXmlStreamReader>
+
+// Потоковый разбор XML plist: данные можно добавлять по частям, события
+// приходят по мере готовности. Наследник получает только словари и
+// скалярные значения с ключом, под которым они лежат. Ключи и значения
+// передаются представлениями внутренних буферов, которые переиспользуются
+// между элементами: они действительны только до возврата из обработчика,
+// копировать нужно лишь то, что сохраняется.
+class PlistStreamReader
+{
+public:
+    virtual ~PlistStreamReader() = default;
+
+    void addData(const QByteArray &chunk);
+    // Данные закончились; false, если документ повреждён или обрезан
+    bool finishData();
+    QString errorString() const { return xml.errorString(); }
+
+protected:
+    // key — ключ, под которым лежит словарь (пустой для элементов массива)
+    virtual void dictStarted(QStringView key) { Q_UNUSED(key); }
+    virtual void dictFinished() {}
+    // Значения <true/> и <false/> приходят как "true" и "false"
+    virtual void scalarValue(QStringView key, QStringView value) = 0;
+
+private:
+    void readAvailable();
+    void clearKey() { currentKey.resize(0); }
+
+    QXmlStreamReader xml;
+    QString currentKey;
+    QString text;
+};
+
+#endif // STRUCTUREDREADER_H
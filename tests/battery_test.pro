@@ -0,0 +1,14 @@
+# Разбор свойств батареи, прочитанных из поддельного реестра
+QT       = core testlib
+
+CONFIG += c++17 console testcase
+CONFIG -= app_bundle
+
+TARGET = battery_test
+
+include(../diagnostic_core.pri)
+
+DEFINES += FIXTURES_DIR=\\\"$$PWD/../fixtures\\\"
+
+SOURCES += \
+    batterytest.cpp
@@ -0,0 +1,206 @@
+// BatteryProbe с поддельным реестром: свойства читаются из plist-файла
+// (FakeBatteryRegistry, MAC_DIAGNOSTIC_BATTERY_PLIST) и проходят тот же
+// путь, что при прямом чтении IORegistry, — readNative, разборщик по
+// частям, finish.
+
+#include "batteryregistry.h"
+#include "builtinprobes.h"
+#include <QTemporaryDir>
+#include <QtTest>
+
+namespace {
+
+// Фрагмент, которым вывод отдаётся разборщику: граница попадает внутрь тегов
+const int ChunkSize = 37;
+
+QString fixturePath(const QString &name)
+{
+    return QStringLiteral(FIXTURES_DIR) + "/" + name;
+}
+
+// Свойства AppleSmartBattery в том виде, как их отдаёт IORegistry:
+// словарь без обёртки-массива ioreg
+QByteArray batteryPlist(int rawMaxCapacity, int designCapacity, int permanentFailure)
+{
+    return QByteArray(
+               "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+               "<!DOCTYPE plist PUBLIC \"-//Apple//DTD PLIST 1.0//EN\" "
+               "\"http://www.apple.com/DTDs/PropertyList-1.0.dtd\">\n"
+               "<plist version=\"1.0\">\n<dict>\n"
+               "\t<key>AppleRawMaxCapacity</key>\n\t<integer>")
+        + QByteArray::number(rawMaxCapacity)
+        + "</integer>\n"
+          "\t<key>BatteryData</key>\n\t<dict>\n"
+          "\t\t<key>CycleCount</key>\n\t\t<integer>9999</integer>\n"
+          "\t\t<key>PermanentFailureStatus</key>\n\t\t<integer>0</integer>\n"
+          "\t</dict>\n"
+          "\t<key>CycleCount</key>\n\t<integer>512</integer>\n"
+          "\t<key>DesignCapacity</key>\n\t<integer>"
+        + QByteArray::number(designCapacity)
+        + "</integer>\n"
+          "\t<key>MaxCapacity</key>\n\t<integer>100</integer>\n"
+          "\t<key>PermanentFailureStatus</key>\n\t<integer>"
+        + QByteArray::number(permanentFailure)
+        + "</integer>\n"
+          "</dict>\n</plist>\n";
+}
+
+// readNative, разбор и finish, как их выполняет DiagnosticManager
+bool runProbe(const BatteryProbe &probe, DiagnosticResults *results)
+{
+    QByteArray output;
+    if (!probe.readNative(&output)) {
+        return false;
+    }
+    const QSharedPointer<ProbeParser> parser = probe.createParser();
+    for (int offset = 0; offset < output.size(); offset += ChunkSize) {
+        parser->consume(output.mid(offset, ChunkSize), *results);
+    }
+    parser->finish(*results);
+    probe.finish(true, *results);
+    return true;
+}
+
+} // namespace
+
+class BatteryTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void readNative_data();
+    void readNative();
+    void systemRegistryFromEnvironment();
+    void noBattery();
+    void missingFile();
+
+private:
+    QString writePlist(const QString &name, const QByteArray &plist);
+
+    QTemporaryDir directory;
+};
+
+void BatteryTest::initTestCase()
+{
+    QVERIFY(directory.isValid());
+}
+
+QString BatteryTest::writePlist(const QString &name, const QByteArray &plist)
+{
+    const QString path = directory.filePath(name + ".plist");
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly) || file.write(plist) != plist.size()) {
+        return QString();
+    }
+    return path;
+}
+
+void BatteryTest::readNative_data()
+{
+    QTest::addColumn<QByteArray>("plist");
+    QTest::addColumn<int>("minCapacity");
+    QTest::addColumn<int>("cycleCounts");
+    QTest::addColumn<int>("maxCapacity");
+    QTest::addColumn<QString>("condition");
+    QTest::addColumn<bool>("replaceRecommended");
+
+    QFile sample(fixturePath("sample/battery.stdout"));
+    QVERIFY(sample.open(QIODevice::ReadOnly));
+    const QByteArray ioregOutput = sample.readAll();
+
+    // Вывод ioreg из записи: 4427 из 5088 мА·ч — 87%
+    QTest::newRow("ioreg/normal") << ioregOutput << 80 << 412 << 87 << "Normal" << false;
+    QTest::newRow("ioreg/below-threshold") << ioregOutput << 90 << 412 << 87
+                                           << "Service Recommended" << true;
+
+    // 4070 из 5088 — ровно 80%: порог не нарушен
+    QTest::newRow("threshold/equal") << batteryPlist(4070, 5088, 0) << 80 << 512 << 80 << "Normal" << false;
+    // 4020 из 5088 — 79%
+    QTest::newRow("threshold/worn") << batteryPlist(4020, 5088, 0) << 80 << 512 << 79
+                                    << "Service Recommended" << true;
+
+    // Ёмкость в норме, но контроллер сообщил о неисправности: замена по
+    // ёмкости не рекомендуется, состояние — по PermanentFailureStatus
+    QTest::newRow("permanent-failure") << batteryPlist(4900, 5088, 1) << 80 << 512 << 96
+                                       << "Service Recommended" << false;
+    // Любой ненулевой код — неисправность
+    QTest::newRow("permanent-failure/code") << batteryPlist(4900, 5088, 0x20) << 80 << 512 << 96
+                                            << "Service Recommended" << false;
+    QTest::newRow("permanent-failure/worn") << batteryPlist(3000, 5088, 1) << 80 << 512 << 59
+                                            << "Service Recommended" << true;
+
+    // Ёмкость выше проектной (новая батарея) ограничена 100%
+    QTest::newRow("above-design") << batteryPlist(5200, 5088, 0) << 80 << 512 << 100 << "Normal" << false;
+}
+
+void BatteryTest::readNative()
+{
+    QFETCH(QByteArray, plist);
+    QFETCH(int, minCapacity);
+    QFETCH(int, cycleCounts);
+    QFETCH(int, maxCapacity);
+    QFETCH(QString, condition);
+    QFETCH(bool, replaceRecommended);
+
+    const QString path = writePlist(QTest::currentDataTag(), plist);
+    QVERIFY(!path.isEmpty());
+
+    const BatteryProbe probe(QSharedPointer<BatteryRegistry>(new FakeBatteryRegistry(path)), minCapacity);
+    DiagnosticResults results;
+    QVERIFY(runProbe(probe, &results));
+
+    // CycleCount и PermanentFailureStatus из вложенного BatteryData не читаются
+    QCOMPARE(results.cycleCounts, cycleCounts);
+    QCOMPARE(results.maxCapacity, maxCapacity);
+    QCOMPARE(results.batteryCondition, condition);
+
+    const QString recommendation = QString("Рекомендуется заменить батарею (ёмкость менее %1%)")
+                                       .arg(minCapacity);
+    QCOMPARE(results.recommendations.contains(recommendation), replaceRecommended);
+    QCOMPARE(results.recommendations.size(), replaceRecommended ? 1 : 0);
+}
+
+void BatteryTest::systemRegistryFromEnvironment()
+{
+    const QString path = writePlist("environment", batteryPlist(4900, 5088, 1));
+    QVERIFY(!path.isEmpty());
+
+    qputenv("MAC_DIAGNOSTIC_BATTERY_PLIST", QFile::encodeName(path));
+    const QSharedPointer<BatteryRegistry> registry = BatteryRegistry::system();
+    qunsetenv("MAC_DIAGNOSTIC_BATTERY_PLIST");
+
+    // Реестр по умолчанию читает файл из переменной окружения и на Linux
+    DiagnosticResults results;
+    QVERIFY(runProbe(BatteryProbe(registry), &results));
+    QCOMPARE(results.maxCapacity, 96);
+    QCOMPARE(results.batteryCondition, QString("Service Recommended"));
+}
+
+void BatteryTest::noBattery()
+{
+    // Настольный Mac: реестр доступен, свойств нет
+    const QString path = writePlist("empty", QByteArray());
+    QVERIFY(!path.isEmpty());
+
+    const BatteryProbe probe(QSharedPointer<BatteryRegistry>(new FakeBatteryRegistry(path)));
+    DiagnosticResults results;
+    QVERIFY(runProbe(probe, &results));
+    QCOMPARE(results.maxCapacity, 0);
+    QVERIFY(results.batteryCondition.isEmpty());
+    QVERIFY(results.recommendations.isEmpty());
+}
+
+void BatteryTest::missingFile()
+{
+    // Файла нет — читать нечем, проверка запустит ioreg
+    const BatteryProbe probe(QSharedPointer<BatteryRegistry>(
+        new FakeBatteryRegistry(directory.filePath("missing.plist"))));
+    QByteArray output;
+    QTest::ignoreMessage(QtWarningMsg, QRegularExpression("Cannot read battery registry file"));
+    QVERIFY(!probe.readNative(&output));
+}
+
+QTEST_GUILESS_MAIN(BatteryTest)
+
+#include "batterytest.moc"
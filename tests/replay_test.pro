@@ -0,0 +1,14 @@
+# Воспроизведение записей из fixtures/ и сравнение итогов с expected.json
+QT       = core testlib
+
+CONFIG += c++17 console testcase
+CONFIG -= app_bundle
+
+TARGET = replay_test
+
+include(../diagnostic_core.pri)
+
+DEFINES += FIXTURES_DIR=\\\"$$PWD/../fixtures\\\"
+
+SOURCES += \
+    replaytest.cpp
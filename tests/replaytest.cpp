@@ -0,0 +1,259 @@
+// Воспроизведение записанного вывода проверок из fixtures/ без задержек и
+// сравнение итогового отчёта с expected.json рядом с записью. Время
+// завершения и время проверок меняются от запуска к запуску и не
+// сравниваются. Отдельно проверяется, что stderr команды записывается и
+// воспроизводится. Режим парка проверяется через собранную консольную утилиту
+// (--fleet-replay): её путь задаёт MAC_DIAGNOSTIC_CLI, по умолчанию —
+// mac_diagnostic_cli в каталоге над тестом.
+
+#include "builtinprobes.h"
+#include "commandrunner.h"
+#include "diagnosticmanager.h"
+#include "fleetcontroller.h"
+#include "probeprofile.h"
+#include "resultserializer.h"
+#include <QCoreApplication>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSignalSpy>
+#include <QStandardPaths>
+#include <QTemporaryDir>
+#include <QtTest>
+
+namespace {
+
+const int ReplayTimeoutMs = 10 * 1000;
+// Каждая машина — отдельный процесс утилиты
+const int FleetTimeoutMs = 60 * 1000;
+
+QString fixturePath(const QString &name)
+{
+    return QStringLiteral(FIXTURES_DIR) + "/" + name;
+}
+
+// Отчёт без полей, зависящих от момента и скорости запуска, в виде текста:
+// при расхождении QCOMPARE покажет оба отчёта
+QByteArray stableJson(QJsonObject json)
+{
+    json.remove("finishedAt");
+    json.remove("timings");
+
+    // Проверки завершаются почти одновременно, порядок рекомендаций не задан
+    QStringList recommendations;
+    for (const QJsonValue &recommendation : json.value("recommendations").toArray()) {
+        recommendations << recommendation.toString();
+    }
+    recommendations.sort();
+    json["recommendations"] = QJsonArray::fromStringList(recommendations);
+
+    return QJsonDocument(json).toJson(QJsonDocument::Indented);
+}
+
+bool readExpected(const QString &directory, QJsonObject *expected)
+{
+    QFile file(directory + "/expected.json");
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    const QJsonDocument document = QJsonDocument::fromJson(file.readAll());
+    *expected = document.object();
+    return document.isObject();
+}
+
+QString cliPath()
+{
+    const QString configured = qEnvironmentVariable("MAC_DIAGNOSTIC_CLI");
+    if (!configured.isEmpty()) {
+        return configured;
+    }
+    return QCoreApplication::applicationDirPath() + "/../mac_diagnostic_cli";
+}
+
+bool writeFile(const QString &path, const QByteArray &data)
+{
+    QFile file(path);
+    return file.open(QIODevice::WriteOnly) && file.write(data) == data.size();
+}
+
+QByteArray readFile(const QString &path)
+{
+    QFile file(path);
+    return file.open(QIODevice::ReadOnly) ? file.readAll() : QByteArray();
+}
+
+// Прогон одной быстрой проверки диска; false — прогон не завершился
+bool runDiskScreen(const QSharedPointer<CommandRunner> &runner, bool *success, QStringList *messages)
+{
+    ProbeRegistry registry;
+    registry.registerProbe(QSharedPointer<Probe>(new DiskScreenProbe));
+
+    DiagnosticManager manager;
+    manager.setCommandRunner(runner);
+    manager.setProbeRegistry(registry);
+
+    QSignalSpy progress(&manager, &DiagnosticManager::progressUpdated);
+    QSignalSpy finished(&manager, &DiagnosticManager::diagnosticsFinished);
+    manager.runDiagnostics();
+    if (!finished.wait(ReplayTimeoutMs)) {
+        return false;
+    }
+    for (const QList<QVariant> &arguments : progress) {
+        messages->append(arguments.at(1).toString());
+    }
+    *success = finished.at(0).at(0).toBool();
+    return true;
+}
+
+} // namespace
+
+class ReplayTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void replayFixture_data();
+    void replayFixture();
+    void recordErrorOutput();
+    void fleetReplay();
+};
+
+void ReplayTest::initTestCase()
+{
+    // Кэш проверок — в тестовом каталоге, а не в данных приложения
+    QStandardPaths::setTestModeEnabled(true);
+}
+
+void ReplayTest::replayFixture_data()
+{
+    QTest::addColumn<QString>("directory");
+
+    QTest::newRow("sample") << fixturePath("sample");
+    QTest::newRow("fleet/mac-01") << fixturePath("fleet/mac-01");
+    QTest::newRow("fleet/mac-02") << fixturePath("fleet/mac-02");
+}
+
+void ReplayTest::replayFixture()
+{
+    QFETCH(QString, directory);
+
+    QJsonObject expected;
+    QVERIFY2(readExpected(directory, &expected), qPrintable("Нет expected.json в " + directory));
+
+    QSharedPointer<ReplayCommandRunner> runner(new ReplayCommandRunner(directory));
+    runner->setDelayScale(0);
+
+    DiagnosticManager manager;
+    manager.setCommandRunner(runner);
+    manager.setProbeRegistry(ProfileSet::builtin().profile("standard").createRegistry());
+
+    QSignalSpy finished(&manager, &DiagnosticManager::diagnosticsFinished);
+    manager.runDiagnostics();
+    QVERIFY(finished.wait(ReplayTimeoutMs));
+    QCOMPARE(finished.count(), 1);
+
+    const bool success = finished.at(0).at(0).toBool();
+    const DiagnosticResults results = finished.at(0).at(1).value<DiagnosticResults>();
+    QVERIFY(success);
+    QVERIFY(results.isComplete());
+    QVERIFY(results.finishedAt.isValid());
+
+    QCOMPARE(stableJson(ResultSerializer::toJson(results)), stableJson(expected));
+
+    // Отчёт, прочитанный обратно, совпадает с исходным
+    DiagnosticResults parsed;
+    QString error;
+    QVERIFY2(ResultSerializer::fromJsonBytes(ResultSerializer::toJsonBytes(results), &parsed, &error),
+             qPrintable(error));
+    QCOMPARE(stableJson(ResultSerializer::toJson(parsed)), stableJson(expected));
+}
+
+void ReplayTest::recordErrorOutput()
+{
+    // Команда без вывода, с ошибкой в stderr и ненулевым кодом
+    QTemporaryDir source;
+    QVERIFY(source.isValid());
+    const QByteArray errorOutput = "diskutil: starting\nCould not find disk: /\n";
+    QVERIFY(writeFile(source.filePath("disk-screen.stdout"), QByteArray()));
+    QVERIFY(writeFile(source.filePath("disk-screen.stderr"), errorOutput));
+    QVERIFY(writeFile(source.filePath("disk-screen.json"), "{ \"exitCode\": 1 }"));
+
+    const QString errorMessage = " Ошибка команды diskutil: Could not find disk: /";
+
+    // Воспроизведение, записанное заново: stderr переходит в новую запись
+    QTemporaryDir recorded;
+    QVERIFY(recorded.isValid());
+    QSharedPointer<ReplayCommandRunner> replay(new ReplayCommandRunner(source.path()));
+    replay->setDelayScale(0);
+    bool success = true;
+    QStringList messages;
+    QVERIFY(runDiskScreen(QSharedPointer<CommandRunner>(new RecordingCommandRunner(replay, recorded.path())),
+                          &success, &messages));
+    QVERIFY(!success);
+    QVERIFY2(messages.contains(errorMessage), qPrintable(messages.join("\n")));
+    QCOMPARE(readFile(recorded.filePath("disk-screen.stderr")), errorOutput);
+
+    // Новая запись воспроизводится с тем же сообщением об ошибке
+    QSharedPointer<ReplayCommandRunner> rerun(new ReplayCommandRunner(recorded.path()));
+    rerun->setDelayScale(0);
+    success = true;
+    messages.clear();
+    QVERIFY(runDiskScreen(rerun, &success, &messages));
+    QVERIFY(!success);
+    QVERIFY2(messages.contains(errorMessage), qPrintable(messages.join("\n")));
+}
+
+void ReplayTest::fleetReplay()
+{
+    const QFileInfo cli(cliPath());
+    if (!cli.isExecutable()) {
+        QSKIP(qPrintable("Не собрана консольная утилита: " + cli.filePath()));
+    }
+
+    QStringList hosts;
+    QString error;
+    QVERIFY2(FleetController::readHostList(fixturePath("fleet/hosts.txt"), &hosts, &error), qPrintable(error));
+    QCOMPARE(hosts, QStringList() << "mac-01" << "mac-02" << "mac-03");
+
+    QSharedPointer<ReplayFleetTransport> transport(
+        new ReplayFleetTransport(fixturePath("fleet"), cli.absoluteFilePath()));
+    transport->setDelayScale(0);
+
+    FleetController fleet;
+    fleet.setTransport(transport);
+    // Профиль явно: profiles.json из настроек не должен менять результат
+    fleet.setExtraArguments(QStringList() << "--profile" << "standard");
+
+    QSignalSpy finished(&fleet, &FleetController::finished);
+    fleet.run(hosts);
+    QVERIFY(finished.wait(FleetTimeoutMs));
+
+    const QList<FleetHostResult> results = fleet.results();
+    QCOMPARE(results.size(), 3);
+
+    // mac-01 и mac-02: отчёт разобран, рекомендации есть (код 1)
+    for (int i = 0; i < 2; ++i) {
+        const FleetHostResult &result = results.at(i);
+        QCOMPARE(result.host, hosts.at(i));
+        QVERIFY2(result.reported, qPrintable(result.host + ": " + result.error));
+        QCOMPARE(result.exitCode, 1);
+
+        QJsonObject expected;
+        const QString directory = fixturePath("fleet/" + result.host);
+        QVERIFY2(readExpected(directory, &expected), qPrintable("Нет expected.json в " + directory));
+        QCOMPARE(stableJson(ResultSerializer::toJson(result.results)), stableJson(expected));
+    }
+
+    // Для mac-03 записи нет: проверки не запускаются, машина без результата
+    const FleetHostResult &missing = results.at(2);
+    QCOMPARE(missing.host, QString("mac-03"));
+    QCOMPARE(missing.exitCode, 2);
+    QVERIFY(FleetController::reportText(results).contains("❌ Без результата: 1"));
+}
+
+QTEST_GUILESS_MAIN(ReplayTest)
+
+#include "replaytest.moc"